@@ -0,0 +1,155 @@
+//-----------------------------------------------------------------------------
+// File: bench.cpp
+//
+// Benchmark driver. Runs the generator pipeline on one or more inputs at
+// different thread counts and reports per phase throughput and memory usage
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include "benchmark.h"
+#include "parser.h"
+using namespace std;
+
+static int getDefaultThreadCounts(vector<unsigned int>& threadCounts);
+
+int main(int argc, char *argv[])
+{
+    boost::program_options::options_description desc{"Ghidra Processor Module Generator Benchmark"};
+    boost::program_options::positional_options_description positional;
+    boost::program_options::variables_map args;
+    vector<string> additionalRegisters;
+    vector<string> inputFilenames;
+    vector<unsigned int> threadCounts;
+    PARSED_DATA options;
+    string outputDirectory;
+    unsigned int runs = 0;
+    bool verbose = false;
+    int result = 0;
+
+    try
+    {
+        desc.add_options()
+            ("input,i", boost::program_options::value<vector<string>>(&inputFilenames)->multitoken(), "Disassembly text files or .sla files to benchmark. Can also be passed as positional arguments.")
+            ("threads,t", boost::program_options::value<vector<unsigned int>>(&threadCounts)->multitoken(), "List of thread counts to run at. Defaults to 1, 2, 4, ... up to the number of physical CPUs")
+            ("runs,r", boost::program_options::value<unsigned int>(&runs)->default_value(3), "Number of times to run the pipeline per input and thread count. The fastest run is reported. Defaults to 3")
+            ("output-dir,o", boost::program_options::value<string>(&outputDirectory)->default_value("generator-bench-output"), "Scratch directory for the generated processor module. Removed when the benchmark finishes")
+            ("additional-registers,ar", boost::program_options::value<vector<string>>(&additionalRegisters)->multitoken(), "List of additional registers")
+            ("verbose,v", boost::program_options::bool_switch(&verbose), "Don't suppress the output of the pipeline. False by default")
+            ("help,h", "Help screen");
+
+        positional.add("input", -1);
+
+        store(boost::program_options::command_line_parser(argc, argv).options(desc).positional(positional).run(), args);
+        notify(args);
+
+        if(args.count("help") || argc == 1)
+        {
+            cout << desc << endl;
+            return 0;
+        }
+
+        if(inputFilenames.size() == 0)
+        {
+            cout << "At least one input file is required!!" << endl;
+            return -1;
+        }
+
+        if(threadCounts.size() == 0)
+        {
+            result = getDefaultThreadCounts(threadCounts);
+            if(result != 0)
+            {
+                return result;
+            }
+        }
+
+        for(auto threadCount: threadCounts)
+        {
+            if(threadCount == 0)
+            {
+                cout << "Invalid number of threads specified" << endl;
+                return -1;
+            }
+        }
+
+        if(runs == 0)
+        {
+            cout << "Invalid number of runs specified" << endl;
+            return -1;
+        }
+    }
+    catch (const boost::program_options::error &ex)
+    {
+        cout << "[-] Error parsing command line: " << ex.what() << endl;
+        return -1;
+    }
+
+    // the pipeline writes the processor module into <processorFamily>/
+    options.endianness = "big";
+    options.processorName = "BenchProc";
+    options.processorFamily = outputDirectory;
+    options.alignment = 1;
+    options.bitness = 32;
+    options.omitOpcodes = false;
+    options.omitExampleInstructions = false;
+    options.factorSubtables = false;
+    options.useSlaCache = false;
+    options.treeMerge = false;
+
+    initRegisters();
+    addRegisters(additionalRegisters);
+
+    printBenchmarkHeader();
+
+    for(auto& inputFilename: inputFilenames)
+    {
+        for(auto threadCount: threadCounts)
+        {
+            BENCH_RESULT benchResult;
+
+            result = runBenchmark(options,
+                                  inputFilename,
+                                  threadCount,
+                                  runs,
+                                  verbose,
+                                  benchResult);
+            if(result != 0)
+            {
+                goto ERROR_CLEANUP;
+            }
+
+            printBenchmarkResult(benchResult);
+        }
+    }
+
+ERROR_CLEANUP:
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(outputDirectory, ec);
+    return result;
+}
+
+// powers of two up to the number of physical CPUs. The CPU count itself is
+// always included even if it is not a power of two
+static int getDefaultThreadCounts(vector<unsigned int>& threadCounts)
+{
+    unsigned int numCpus = boost::thread::physical_concurrency();
+
+    if(numCpus == 0)
+    {
+        cout << "Unable to determine number of CPUs. Please specify thread counts with --threads at the command line." << endl;
+        return -1;
+    }
+
+    for(unsigned int i = 1; i < numCpus; i *= 2)
+    {
+        threadCounts.push_back(i);
+    }
+    threadCounts.push_back(numCpus);
+
+    return 0;
+}
@@ -0,0 +1,420 @@
+//-----------------------------------------------------------------------------
+// File: benchmark.cpp
+//
+// Timing the individual phases of the generator pipeline
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iomanip>
+#include <sys/resource.h>
+#include <boost/timer/timer.hpp>
+#include <boost/filesystem.hpp>
+#include "benchmark.h"
+#include "combine.h"
+#include "output.h"
+#include "parser_sla.h"
+
+static void copyBenchmarkOptions(const PARSED_DATA& options,
+                                 PARSED_DATA& parsedData);
+static int runBenchmarkPhase(PARSED_DATA& parsedData,
+                             unsigned int phase,
+                             bool isSla,
+                             unsigned long long& items);
+
+// names of the phases as they appear in the benchmark output
+static const char* g_benchPhaseNames[PHASE_MAX] = {"parse",
+                                                   "combine",
+                                                   "attach-variables",
+                                                   "tokens",
+                                                   "output"};
+
+// returns the name of a phase for the benchmark output
+const char* getBenchPhaseName(unsigned int phase)
+{
+    if(phase >= PHASE_MAX)
+    {
+        return "total";
+    }
+
+    return g_benchPhaseNames[phase];
+}
+
+// returns what a phase counts as its items. Parsing text counts lines, every
+// other phase counts instructions
+const char* getBenchPhaseUnit(unsigned int phase, bool isSla)
+{
+    if(phase == PHASE_PARSE && isSla == false)
+    {
+        return "lines";
+    }
+
+    return "instructions";
+}
+
+// resets the peak resident set size of the process so the next call to
+// getPeakRss() only covers what happened in between
+// Linux only, silently does nothing if /proc/self/clear_refs is unavailable
+void resetPeakRss(void)
+{
+    ofstream ofs("/proc/self/clear_refs");
+    if(!ofs)
+    {
+        return;
+    }
+
+    ofs << "5";
+    ofs.close();
+}
+
+// returns the peak resident set size of the process in KB
+unsigned long long getPeakRss(void)
+{
+    ifstream ifs("/proc/self/status");
+    struct rusage usage = {};
+    string line;
+
+    // VmHWM honors resetPeakRss(), prefer it over getrusage
+    while(std::getline(ifs, line))
+    {
+        if(line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::stoull(line.substr(6));
+        }
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// copies the command line options we need for output into a fresh
+// PARSED_DATA. PARSED_DATA can't be copied as a whole because of its mutexes
+static void copyBenchmarkOptions(const PARSED_DATA& options,
+                                 PARSED_DATA& parsedData)
+{
+    parsedData.maxOpcodeBits = 0;
+    parsedData.variableLengthISA = false;
+    parsedData.endianness = options.endianness;
+    parsedData.processorName = options.processorName;
+    parsedData.processorFamily = options.processorFamily;
+    parsedData.alignment = options.alignment;
+    parsedData.bitness = options.bitness;
+    parsedData.omitOpcodes = options.omitOpcodes;
+    parsedData.omitExampleInstructions = options.omitExampleInstructions;
+    parsedData.factorSubtables = options.factorSubtables;
+    parsedData.useSlaCache = options.useSlaCache;
+    parsedData.treeMerge = options.treeMerge;
+}
+
+// runs a single phase of the pipeline. items is set to the number of lines or
+// instructions the phase worked on
+static int runBenchmarkPhase(PARSED_DATA& parsedData,
+                             unsigned int phase,
+                             bool isSla,
+                             unsigned long long& items)
+{
+    int result = 0;
+
+    switch(phase)
+    {
+        case PHASE_PARSE:
+            if(isSla)
+            {
+                result = parseInstructionsSla(parsedData, 0);
+                items = parsedData.combinedInstructions.size();
+            }
+            else
+            {
+                result = parseInstructions(parsedData, 0);
+                items = parsedData.allInstructions.size();
+            }
+            return result;
+        case PHASE_COMBINE:
+            items = parsedData.combinedInstructions.size();
+            combineInstructions(parsedData);
+            return 0;
+        case PHASE_ATTACH_VARIABLES:
+            items = parsedData.combinedInstructions.size();
+            computeAttachVariables(parsedData);
+            return 0;
+        case PHASE_TOKENS:
+            items = parsedData.combinedInstructions.size();
+            computeTokenInstructions(parsedData);
+            return 0;
+        case PHASE_OUTPUT:
+            items = parsedData.combinedInstructions.size();
+            result = createProcessorModule(parsedData, 0);
+            if(result != 0)
+            {
+                return result;
+            }
+            return createLdefs(parsedData);
+        default:
+            cout << "[-] Invalid benchmark phase specified!!" << endl;
+            return -1;
+    }
+
+    return -1;
+}
+
+// Runs the full pipeline on inputFilename runs times at numThreads threads,
+// timing each phase separately. The fastest wall time of each phase is kept.
+// Inputs ending in .sla are parsed with parseInstructionsSla. The regular
+// pipeline output is suppressed unless verbose is set
+int runBenchmark(const PARSED_DATA& options,
+                 const string& inputFilename,
+                 unsigned int numThreads,
+                 unsigned int runs,
+                 bool verbose,
+                 BENCH_RESULT& benchResult)
+{
+    std::streambuf* coutBuffer = NULL;
+    unsigned int failedPhase = 0;
+    int result = 0;
+
+    if(numThreads == 0 || runs == 0)
+    {
+        cout << "[-] Thread count and run count must be non-zero" << endl;
+        return -1;
+    }
+
+    benchResult.inputFilename = inputFilename;
+    benchResult.isSla = (boost::filesystem::path(inputFilename).extension() == ".sla");
+    benchResult.numThreads = numThreads;
+    benchResult.runs = runs;
+
+    for(unsigned int i = 0; i < PHASE_MAX; i++)
+    {
+        benchResult.phases[i].wallSeconds = -1;
+        benchResult.phases[i].items = 0;
+        benchResult.phases[i].peakRssKb = 0;
+    }
+
+    for(unsigned int run = 0; run < runs; run++)
+    {
+        PARSED_DATA parsedData;
+
+        copyBenchmarkOptions(options, parsedData);
+        parsedData.numThreads = numThreads;
+        parsedData.inputFilenames.push_back(inputFilename);
+
+        // silence the pipeline, the phases print progress and timers
+        if(verbose == false)
+        {
+            coutBuffer = cout.rdbuf(NULL);
+        }
+
+        for(unsigned int phase = 0; phase < PHASE_MAX; phase++)
+        {
+            PPHASE_RESULT phaseResult = &benchResult.phases[phase];
+            boost::timer::cpu_timer timer;
+            unsigned long long items = 0;
+            unsigned long long peakRss = 0;
+            double wallSeconds = 0;
+
+            // clearParserData() can lower the thread count on small inputs
+            parsedData.numThreads = numThreads;
+
+            resetPeakRss();
+            timer.start();
+            result = runBenchmarkPhase(parsedData, phase, benchResult.isSla, items);
+            timer.stop();
+            peakRss = getPeakRss();
+
+            if(result != 0)
+            {
+                failedPhase = phase;
+                break;
+            }
+
+            wallSeconds = timer.elapsed().wall / 1e9;
+            if(phaseResult->wallSeconds < 0 || wallSeconds < phaseResult->wallSeconds)
+            {
+                phaseResult->wallSeconds = wallSeconds;
+            }
+
+            if(peakRss > phaseResult->peakRssKb)
+            {
+                phaseResult->peakRssKb = peakRss;
+            }
+
+            phaseResult->items = items;
+        }
+
+        clearParserData(parsedData, false);
+        parsedData.slas.clear();
+        parsedData.slaIndex.clear();
+
+        if(verbose == false)
+        {
+            cout.rdbuf(coutBuffer);
+        }
+
+        if(result != 0)
+        {
+            cout << "[-] Benchmark failed on " << inputFilename << " (phase: " << getBenchPhaseName(failedPhase) << ")" << endl;
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+// Runs the full pipeline on inputFilename at 1, 2, 4, ... threads up to
+// maxThreads and prints the speedup and parallel efficiency of every phase
+// compared to the single threaded run. maxThreads is always included even if
+// it is not a power of two
+int runScalingReport(const PARSED_DATA& options,
+                     const string& inputFilename,
+                     unsigned int maxThreads,
+                     unsigned int runs)
+{
+    vector<BENCH_RESULT> benchResults;
+    vector<unsigned int> threadCounts;
+    int result = 0;
+
+    if(maxThreads == 0)
+    {
+        cout << "[-] Thread count must be non-zero" << endl;
+        return -1;
+    }
+
+    for(unsigned int i = 1; i < maxThreads; i *= 2)
+    {
+        threadCounts.push_back(i);
+    }
+    threadCounts.push_back(maxThreads);
+
+    for(auto threadCount: threadCounts)
+    {
+        BENCH_RESULT benchResult;
+
+        cout << "[*] Running pipeline with " << threadCount << " thread(s)" << endl;
+
+        result = runBenchmark(options,
+                              inputFilename,
+                              threadCount,
+                              runs,
+                              false,
+                              benchResult);
+        if(result != 0)
+        {
+            return result;
+        }
+
+        benchResults.push_back(benchResult);
+    }
+
+    printScalingReport(benchResults);
+    return 0;
+}
+
+// Prints speedup and parallel efficiency per phase. The first result is the
+// baseline, normally the single threaded run
+// ex:
+// phase              threads     wall_s  speedup  efficiency
+// parse                    1   0.104211     1.00      100.0%
+// parse                    2   0.061920     1.68       84.2%
+void printScalingReport(const vector<BENCH_RESULT>& benchResults)
+{
+    if(benchResults.size() == 0)
+    {
+        return;
+    }
+
+    cout << "[*] Scaling report for " << benchResults[0].inputFilename;
+    cout << " (fastest of " << benchResults[0].runs << " run(s))" << endl;
+    cout << std::left << std::setw(18) << "phase";
+    cout << std::right << std::setw(9) << "threads";
+    cout << std::setw(11) << "wall_s";
+    cout << std::setw(9) << "speedup";
+    cout << std::setw(12) << "efficiency" << endl;
+
+    for(unsigned int phase = 0; phase <= PHASE_MAX; phase++)
+    {
+        double baseSeconds = 0;
+
+        for(auto& benchResult: benchResults)
+        {
+            double wallSeconds = 0;
+            double speedup = 0;
+            double efficiency = 0;
+
+            // the total row sums every phase
+            for(unsigned int i = 0; i < PHASE_MAX; i++)
+            {
+                if(phase == PHASE_MAX || phase == i)
+                {
+                    wallSeconds += benchResult.phases[i].wallSeconds;
+                }
+            }
+
+            if(baseSeconds == 0)
+            {
+                baseSeconds = wallSeconds;
+            }
+
+            if(wallSeconds > 0)
+            {
+                speedup = baseSeconds / wallSeconds;
+                efficiency = speedup * benchResults[0].numThreads / benchResult.numThreads;
+            }
+
+            cout << std::left << std::setw(18) << getBenchPhaseName(phase);
+            cout << std::right << std::setw(9) << benchResult.numThreads;
+            cout << std::fixed << std::setprecision(6) << std::setw(11) << wallSeconds;
+            cout << std::setprecision(2) << std::setw(9) << speedup;
+            cout << std::setprecision(1) << std::setw(11) << efficiency * 100 << "%" << endl;
+        }
+    }
+}
+
+// Prints the column names of the benchmark output. The output is tab
+// delimited and meant to be diffed between releases
+void printBenchmarkHeader(void)
+{
+    cout << "# generator-bench format " << BENCH_FORMAT_VERSION << endl;
+    cout << "# input\tphase\tthreads\truns\twall_s\titems\tunit\titems_per_s\tpeak_rss_kb" << endl;
+}
+
+// Prints one row per phase plus a total row
+// ex:
+// examples/sh2.txt	parse	4	3	0.104211	53752	lines	515803	30212
+void printBenchmarkResult(const BENCH_RESULT& benchResult)
+{
+    PHASE_RESULT total = {0, 0, 0};
+
+    total.items = benchResult.phases[PHASE_PARSE].items;
+
+    for(unsigned int phase = 0; phase <= PHASE_MAX; phase++)
+    {
+        const PHASE_RESULT* phaseResult = &total;
+        unsigned long long itemsPerSecond = 0;
+
+        if(phase < PHASE_MAX)
+        {
+            phaseResult = &benchResult.phases[phase];
+
+            total.wallSeconds += phaseResult->wallSeconds;
+            if(phaseResult->peakRssKb > total.peakRssKb)
+            {
+                total.peakRssKb = phaseResult->peakRssKb;
+            }
+        }
+
+        if(phaseResult->wallSeconds > 0)
+        {
+            itemsPerSecond = phaseResult->items / phaseResult->wallSeconds;
+        }
+
+        cout << benchResult.inputFilename << "\t";
+        cout << getBenchPhaseName(phase) << "\t";
+        cout << benchResult.numThreads << "\t";
+        cout << benchResult.runs << "\t";
+        cout << std::fixed << std::setprecision(6) << phaseResult->wallSeconds << "\t";
+        cout << phaseResult->items << "\t";
+        cout << getBenchPhaseUnit((phase == PHASE_MAX) ? (unsigned int)PHASE_PARSE : phase, benchResult.isSla) << "\t";
+        cout << itemsPerSecond << "\t";
+        cout << phaseResult->peakRssKb << endl;
+    }
+}
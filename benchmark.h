@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// File: benchmark.h
+//
+// Timing the individual phases of the generator pipeline
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "parser.h"
+using namespace std;
+
+// version of the benchmark output format. Bump this whenever the columns
+// change so results from different releases aren't diffed blindly
+#define BENCH_FORMAT_VERSION 1
+
+// number of times --scaling-report runs the pipeline per thread count
+#define SCALING_REPORT_RUNS 3
+
+// phases of the pipeline that are timed separately
+enum BENCH_PHASE
+{
+    PHASE_PARSE = 0,            // parseInstructions or parseInstructionsSla
+    PHASE_COMBINE = 1,          // combineInstructions
+    PHASE_ATTACH_VARIABLES = 2, // computeAttachVariables
+    PHASE_TOKENS = 3,           // computeTokenInstructions
+    PHASE_OUTPUT = 4,           // createProcessorModule and createLdefs
+    PHASE_MAX = 5,
+};
+
+// timing of a single phase
+typedef struct _PHASE_RESULT
+{
+    // fastest wall time across all runs, in seconds
+    double wallSeconds;
+
+    // number of lines or instructions the phase worked on
+    unsigned long long items;
+
+    // highest peak resident set size seen while the phase ran, in KB
+    unsigned long long peakRssKb;
+} PHASE_RESULT, *PPHASE_RESULT;
+
+// timing of the whole pipeline on one input at one thread count
+typedef struct _BENCH_RESULT
+{
+    string inputFilename;
+    bool isSla; // input is a .sla file instead of disassembly text
+    unsigned int numThreads;
+    unsigned int runs;
+    PHASE_RESULT phases[PHASE_MAX];
+} BENCH_RESULT, *PBENCH_RESULT;
+
+int runBenchmark(const PARSED_DATA& options,
+                 const string& inputFilename,
+                 unsigned int numThreads,
+                 unsigned int runs,
+                 bool verbose,
+                 BENCH_RESULT& benchResult);
+int runScalingReport(const PARSED_DATA& options,
+                     const string& inputFilename,
+                     unsigned int maxThreads,
+                     unsigned int runs);
+void printScalingReport(const vector<BENCH_RESULT>& benchResults);
+void printBenchmarkHeader(void);
+void printBenchmarkResult(const BENCH_RESULT& benchResult);
+const char* getBenchPhaseName(unsigned int phase);
+const char* getBenchPhaseUnit(unsigned int phase, bool isSla);
+void resetPeakRss(void);
+unsigned long long getPeakRss(void);
@@ -14,31 +14,15 @@
 #include "bitspan.h"
 #include "thread_pool.h"
 
-static bool compareInstructionCombine(const INSTRUCTION_COMBINE& a,
-                                      const INSTRUCTION_COMBINE& b);
-static bool areInstructionsCombinable(Instruction& a, Instruction& b,
-                                      char& replacementChar,
-                                      int& differencePosition);
-static void combineInstructionsWorker(PARSED_DATA& parsedData,
-                                      const string& curBitString,
-                                      Instruction* instruction,
-                                      set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*>& combinedInstructions,
-                                      unordered_map<string, unsigned int>& visitedInstructions);
-
-// Set of instructions to combine. It is populated by the workers but only
-// inserted into the parserData.combinedInstructions by the parent thread
-static set<INSTRUCTION_COMBINE,  decltype(compareInstructionCombine)*> g_TempCombinedInstructions(compareInstructionCombine);
-
-// synchronize access to g_TempCombinedInstructions set
-static boost::mutex g_TempCombinedInstructionsMutex;
-
-// Custom comparator for inserting INSTRUCTION_COMBINEs into the 
-// g_TempCombinedInstructions set. 
+static COMBINE_TYPE getCombineTypeFromReplacementChar(char replacementChar);
+
+// Custom comparator for inserting INSTRUCTION_COMBINEs into the set of
+// combine candidates of a pass. 
 // We want:
 // - higher counts (meaning more bits in the bit span)
 // - otherwise sort by lower opcode string
-static bool compareInstructionCombine(const INSTRUCTION_COMBINE& a,
-                                      const INSTRUCTION_COMBINE& b)
+bool compareInstructionCombine(const INSTRUCTION_COMBINE& a,
+                               const INSTRUCTION_COMBINE& b)
 {
     if(a.length != b.length)
     {
@@ -61,10 +45,10 @@ static bool compareInstructionCombine(const INSTRUCTION_COMBINE& a,
 }
 
 // Returns true if instruction a and b are combinable
-static bool areInstructionsCombinable(Instruction& a,
-                                      Instruction& b,
-                                      char& replacementChar,
-                                      int& differencePosition)
+bool areInstructionsCombinable(Instruction& a,
+                               Instruction& b,
+                               char& replacementChar,
+                               int& differencePosition)
 {
     bool isEqual = false;
 
@@ -120,15 +104,35 @@ static bool areInstructionsCombinable(Instruction& a,
     return false;
 }
 
+// Maps the replacement char of a combined bit span back to the type of
+// combine that produced it
+// - '*' for duplicates
+// - lowercase letter for immediates
+// - uppercase letter for registers
+static COMBINE_TYPE getCombineTypeFromReplacementChar(char replacementChar)
+{
+    if(replacementChar >= 'a' && replacementChar <= 'z')
+    {
+        return COMBINE_IMMEDIATES;
+    }
+
+    if(replacementChar >= 'A' && replacementChar <= 'Z')
+    {
+        return COMBINE_REGISTERS;
+    }
+
+    return COMBINE_DUPLICATES;
+}
+
 // Iterates over all bits of the curBitString and attempts to see if
 // instruction can be merged with any other instruction one bit away. If a 
-// match candidate is found, inserts it into g_TempCombinedInstructions.
+// match candidate is found, inserts it into combinedInstructions.
 // Attempts to find the longest bit span of combinable instructions
-static void combineInstructionsWorker(PARSED_DATA& parsedData,
-                                      const string& curBitString,
-                                      Instruction* instruction,
-                                      set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*>& combinedInstructions,
-                                      unordered_map<string, unsigned int>& visitedInstructions)
+void combineInstructionsWorker(PARSED_DATA& parsedData,
+                               const string& curBitString,
+                               Instruction* instruction,
+                               set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*>& combinedInstructions,
+                               unordered_map<string, unsigned int>& visitedInstructions)
 {
     BITSPAN longestBitSpan = {0, 0, 0, 0, 0};
     BITSPAN curBitSpan = {0, 0, 0, 0, 0};
@@ -307,6 +311,7 @@ static void combineInstructionsWorker(PARSED_DATA& parsedData,
 
         // instructions are equal, combine them
         newCombine.length = longestBitSpan.length;
+        newCombine.combineType = getCombineTypeFromReplacementChar(longestBitSpan.replacementChar);
         newCombine.instruction = new Instruction();
         *newCombine.instruction = *instruction;
 
@@ -336,6 +341,8 @@ static void combineInstructionsWorker(PARSED_DATA& parsedData,
 }
 
 static int combineInstructionsThread(PARSED_DATA& parsedData,
+                                     set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*>& candidates,
+                                     boost::mutex& candidatesMutex,
                                      unsigned long long start,
                                      unsigned long long end)
 {
@@ -372,22 +379,28 @@ static int combineInstructionsThread(PARSED_DATA& parsedData,
                                   visitedInstructions);
     }
 
-    g_TempCombinedInstructionsMutex.lock();
-    g_TempCombinedInstructions.merge(combinedInstructions);
-    g_TempCombinedInstructionsMutex.unlock();
+    candidatesMutex.lock();
+    candidates.merge(combinedInstructions);
+    candidatesMutex.unlock();
 
     incrementWorkerCompletions();
     return 0;
 }
 
 // Queue each instruction to the thread pool to be combined by worker threads
-static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData)
+// Fills out stats for the pass. Returns 0 if no instructions were combined
+static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData,
+                                                 COMBINE_STATS& stats)
 {
+    // Set of instructions to combine. It is populated by the workers but only
+    // inserted into the parserData.combinedInstructions by this thread. Owned
+    // by the pass so separate instruction sets can be combined concurrently
+    set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*> candidates(compareInstructionCombine);
+    boost::mutex candidatesMutex;
     boost::asio::thread_pool threadPool(parsedData.numThreads);
     unsigned long long numInstructions = 0;
     unsigned long long portionSize = 0;
     unsigned long long start = 0;
-    unsigned int submissions = 0;
 
     resetThreadPool();
 
@@ -428,45 +441,30 @@ static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData)
         boost::asio::post(threadPool, 
                           boost::bind(combineInstructionsThread,
                                       boost::ref(parsedData),
+                                      boost::ref(candidates),
+                                      boost::ref(candidatesMutex),
                                       start,
                                       end));
-        submissions++;
     }
 
     // wait for threads
-    // TODO: improve poll logic
-    while(1)
-    {
-        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-        unsigned int completedCount = getWorkerCompletions();
-
-        // check if we finished our submitted jobs
-        if(completedCount >= submissions)
-        {
-            // finished
-            break;
-        }
-    }
-
     threadPool.join();
 
     // short-circuit exit if we didn't combine any instructions during this
     // loop
-    if(g_TempCombinedInstructions.size() == 0)
+    if(candidates.size() == 0)
     {
         //cout << "  [*] No instructions combined during pass. Short-circuiting" << endl;
         return 0;
     }
 
-    //cout << "g_TempCombinedInstructions: " << g_TempCombinedInstructions.size() << endl;
-
-    g_TempCombinedInstructionsMutex.lock();
+    stats.candidates = candidates.size();
 
     // Update parsedData.combinedInstructions with the newly created combined
     // instructions. Remove two instructions for every onec combined
     // instruction we add back in.
-    for(set<INSTRUCTION_COMBINE>:: iterator currItr = g_TempCombinedInstructions.begin();
-        currItr != g_TempCombinedInstructions.end();
+    for(set<INSTRUCTION_COMBINE>:: iterator currItr = candidates.begin();
+        currItr != candidates.end();
         currItr++)
     {
         // Verify both opcodeA and opcodeB are present. It's possible we remove
@@ -475,6 +473,7 @@ static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData)
         if(tempItr == parsedData.combinedInstructions.end())
         {
             delete currItr->instruction;
+            stats.discarded++;
             continue;
         }
 
@@ -482,6 +481,7 @@ static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData)
         if(tempItr2 == parsedData.combinedInstructions.end())
         {
             delete currItr->instruction;
+            stats.discarded++;
             continue;
         }
 
@@ -502,14 +502,76 @@ static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData)
         // insert the new combined instruction
         parsedData.combinedInstructions.insert({{std::move(currItr->instruction->getOpcode()),
                                                            currItr->instruction}});
+
+        stats.merged[currItr->combineType]++;
+        stats.spanLengths[currItr->length]++;
     }
 
-    g_TempCombinedInstructions.clear();
-    g_TempCombinedInstructionsMutex.unlock();
+    if(getCombineStatsMerged(stats) == 0)
+    {
+        // every candidate was discarded, another pass would see the exact same
+        // set of instructions
+        return 0;
+    }
 
     return 1;
 }
 
+// zero out the combine statistics before a pass
+void initCombineStats(COMBINE_STATS& stats)
+{
+    stats.candidates = 0;
+    stats.discarded = 0;
+
+    for(unsigned int i = 0; i < COMBINE_MAX; i++)
+    {
+        stats.merged[i] = 0;
+    }
+
+    stats.spanLengths.clear();
+}
+
+// total number of merges across all combine types
+unsigned long long getCombineStatsMerged(const COMBINE_STATS& stats)
+{
+    unsigned long long total = 0;
+
+    for(unsigned int i = 0; i < COMBINE_MAX; i++)
+    {
+        total += stats.merged[i];
+    }
+
+    return total;
+}
+
+// prints the statistics of a single combine pass
+// ex:
+//     [*] Candidates: 2648 Discarded: 1204 Merged: 1444 (duplicates: 12 immediates: 1320 registers: 112)
+//     [*] Span lengths: 1:1309 2:101 3:34
+void printCombineStats(const COMBINE_STATS& stats)
+{
+    cout << "    [*] Candidates: " << stats.candidates;
+    cout << " Discarded: " << stats.discarded;
+    cout << " Merged: " << getCombineStatsMerged(stats);
+    cout << " (duplicates: " << stats.merged[COMBINE_DUPLICATES];
+    cout << " immediates: " << stats.merged[COMBINE_IMMEDIATES];
+    cout << " registers: " << stats.merged[COMBINE_REGISTERS] << ")" << endl;
+
+    if(stats.spanLengths.size() == 0)
+    {
+        return;
+    }
+
+    cout << "    [*] Span lengths:";
+    for(auto& x: stats.spanLengths)
+    {
+        // x.first = bit span length
+        // x.second = number of merges with that length
+        cout << " " << x.first << ":" << x.second;
+    }
+    cout << endl;
+}
+
 // Attempts to combine instructions into one. To combine two instructions into
 // one:
 // -- the opcodes must bit one bit apart
@@ -536,17 +598,37 @@ static unsigned int combineInstructionsScheduler(PARSED_DATA& parsedData)
 void combineInstructions(PARSED_DATA& parsedData)
 {
     boost::timer::auto_cpu_timer t;
+
+    combineInstructionPasses(parsedData, true);
+}
+
+// Runs combine passes over parsedData.combinedInstructions until a pass no
+// longer combines anything. Progress is only printed if verbose is set, so
+// separate instruction sets can be combined concurrently without
+// interleaving their output
+void combineInstructionPasses(PARSED_DATA& parsedData, bool verbose)
+{
+    COMBINE_STATS stats;
     unsigned int result = 0;
 
     // worst case we must run this algorithm once for every bit in the opcode
-    // we have a short-circuit exit if execute a loop without combining any 
-    // instructions
-    // TODO: is this still true with failures in combining??
+    // we have a short-circuit exit if a pass doesn't merge any instructions.
+    // A pass where every candidate is discarded leaves combinedInstructions
+    // untouched, so the next pass would produce the same candidates again
     for(unsigned int k = 0; k < parsedData.maxOpcodeBits; k++)
     {
-        cout << "  [*] Pass: " << k << " Instructions: " << parsedData.combinedInstructions.size() << endl;
+        if(verbose)
+        {
+            cout << "  [*] Pass: " << k << " Instructions: " << parsedData.combinedInstructions.size() << endl;
+        }
+
+        initCombineStats(stats);
+        result = combineInstructionsScheduler(parsedData, stats);
+        if(verbose)
+        {
+            printCombineStats(stats);
+        }
 
-        result = combineInstructionsScheduler(parsedData);
         if(result == 0)
         {
             // no more to combine, return early
@@ -14,9 +14,44 @@
 typedef struct _INSTRUCTION_COMBINE
 {
     unsigned int length; // count of bits being combined
+    COMBINE_TYPE combineType; // how the two instructions were combined
     Instruction* instruction;
     string opcodeA;
     string opcodeB;
 } INSTRUCTION_COMBINE, *PINSTRUCTION_COMBINE;
 
+// per-pass statistics of the combining stage. Used to tell whether later
+// passes are still doing useful work
+typedef struct _COMBINE_STATS
+{
+    // number of unique combine candidates generated by the workers
+    unsigned long long candidates;
+
+    // candidates thrown away because opcodeA or opcodeB was already consumed
+    // by a better candidate earlier in the same pass
+    unsigned long long discarded;
+
+    // candidates actually merged, indexed by COMBINE_TYPE
+    unsigned long long merged[COMBINE_MAX];
+
+    // histogram of merged bit span lengths
+    // key = bit span length, value = number of merges
+    map<unsigned int, unsigned long long> spanLengths;
+} COMBINE_STATS, *PCOMBINE_STATS;
+
 void combineInstructions(PARSED_DATA& parsedData);
+void combineInstructionPasses(PARSED_DATA& parsedData, bool verbose);
+bool compareInstructionCombine(const INSTRUCTION_COMBINE& a,
+                               const INSTRUCTION_COMBINE& b);
+bool areInstructionsCombinable(Instruction& a,
+                               Instruction& b,
+                               char& replacementChar,
+                               int& differencePosition);
+void combineInstructionsWorker(PARSED_DATA& parsedData,
+                               const string& curBitString,
+                               Instruction* instruction,
+                               set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*>& combinedInstructions,
+                               unordered_map<string, unsigned int>& visitedInstructions);
+void initCombineStats(COMBINE_STATS& stats);
+unsigned long long getCombineStatsMerged(const COMBINE_STATS& stats);
+void printCombineStats(const COMBINE_STATS& stats);
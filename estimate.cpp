@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// File: estimate.cpp
+//
+// Estimating the mismatch rate of the validator's stratified sample
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <cmath>
+#include <algorithm>
+#include "estimate.h"
+using namespace std;
+
+// Stratified estimate of the mismatch rate of a group of strata with a 95%
+// confidence interval from the normal approximation. Strata without sampled
+// lines don't count towards the rate. The variance of each stratum uses the
+// Agresti-Coull rate (mismatches + 2) / (sampled + 4), a stratum sampled at 0%
+// or 100% is still uncertain unless all its lines were sampled. If no
+// mismatches were sampled the upper bound is the exact one sided bound for 0
+// mismatches
+void estimateMismatchRate(vector<PVALIDATOR_STRATUM>& strata, VALIDATOR_ESTIMATE& estimate)
+{
+    unsigned long long sampledLines = 0;
+    double variance = 0;
+    double halfWidth = 0;
+
+    estimate.lines = 0;
+    estimate.sampled = 0;
+    estimate.mismatches = 0;
+    estimate.rate = 0;
+
+    for(auto stratum: strata)
+    {
+        estimate.lines += stratum->lines;
+        estimate.sampled += stratum->sampled;
+        estimate.mismatches += stratum->mismatches;
+
+        if(stratum->sampled > 0)
+        {
+            sampledLines += stratum->lines;
+        }
+    }
+
+    if(sampledLines == 0)
+    {
+        estimate.low = 0;
+        estimate.high = 1;
+        return;
+    }
+
+    for(auto stratum: strata)
+    {
+        double weight = 0;
+        double rate = 0;
+        double adjustedRate = 0;
+        double fpc = 0;
+
+        if(stratum->sampled == 0)
+        {
+            continue;
+        }
+
+        weight = (double)stratum->lines / sampledLines;
+        rate = (double)stratum->mismatches / stratum->sampled;
+        fpc = 1.0 - (double)stratum->sampled / stratum->lines; // finite population correction
+
+        adjustedRate = (stratum->mismatches + 2.0) / (stratum->sampled + 4.0);
+
+        estimate.rate += weight * rate;
+        variance += weight * weight * fpc * adjustedRate * (1.0 - adjustedRate) / (stratum->sampled + 4.0);
+    }
+
+    halfWidth = VALIDATOR_SAMPLE_Z * sqrt(variance);
+    estimate.low = max(0.0, estimate.rate - halfWidth);
+    estimate.high = min(1.0, estimate.rate + halfWidth);
+
+    if(estimate.mismatches == 0 && estimate.sampled < estimate.lines)
+    {
+        estimate.high = max(estimate.high, 1.0 - pow(0.05, 1.0 / estimate.sampled));
+    }
+}
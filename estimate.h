@@ -0,0 +1,44 @@
+//-----------------------------------------------------------------------------
+// File: estimate.h
+//
+// Estimating the mismatch rate of the validator's stratified sample
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <string>
+#include <vector>
+#include <boost/unordered_map.hpp>
+using namespace std;
+
+// z score of the 95% confidence intervals
+#define VALIDATOR_SAMPLE_Z 1.96
+
+// input lines with the same top opcode bits and mnemonic
+typedef pair<unsigned int, string> VALIDATOR_STRATUM_KEY;
+
+typedef struct _VALIDATOR_STRATUM
+{
+    unsigned long long lines;
+    unsigned long long sampled;
+    unsigned long long mismatches;
+    double probability; // chance of each line being sampled
+} VALIDATOR_STRATUM, *PVALIDATOR_STRATUM;
+
+typedef boost::unordered_map<VALIDATOR_STRATUM_KEY, VALIDATOR_STRATUM> VALIDATOR_STRATA;
+
+// estimated mismatch rate of a group of strata
+typedef struct _VALIDATOR_ESTIMATE
+{
+    string name;
+    unsigned long long lines;
+    unsigned long long sampled;
+    unsigned long long mismatches;
+    double rate;
+    double low; // 95% confidence interval
+    double high;
+} VALIDATOR_ESTIMATE, *PVALIDATOR_ESTIMATE;
+
+void estimateMismatchRate(vector<PVALIDATOR_STRATUM>& strata, VALIDATOR_ESTIMATE& estimate);
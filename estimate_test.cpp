@@ -0,0 +1,85 @@
+//-----------------------------------------------------------------------------
+// File: estimate_test.cpp
+//
+// Tests the mismatch rate estimate of the validator's stratified sample.
+// Strata sampled at 0% or 100% must only get a zero width interval if all
+// of their lines were sampled
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <iomanip>
+#include "estimate.h"
+using namespace std;
+
+// strata of a group and the expected shape of its interval
+typedef struct _ESTIMATE_TEST
+{
+    const char* name;
+    vector<VALIDATOR_STRATUM> strata;
+    bool exact; // every line was sampled, the interval is the rate itself
+} ESTIMATE_TEST, *PESTIMATE_TEST;
+
+static int runTest(ESTIMATE_TEST& test);
+
+int main(void)
+{
+    vector<ESTIMATE_TEST> tests =
+    {
+        {"partly sampled 0% stratum", {{18883, 1313, 0, 0}}, false},
+        {"partly sampled 100% stratum", {{200, 20, 20, 0}}, false},
+        {"partly sampled 0% and 100% strata", {{17570, 1200, 0, 0}, {1313, 113, 113, 0}}, false},
+        {"fully sampled 0% and 100% strata", {{40, 40, 0, 0}, {10, 10, 10, 0}}, true},
+    };
+    unsigned int failures = 0;
+
+    for(auto& test: tests)
+    {
+        if(runTest(test) != 0)
+        {
+            failures++;
+        }
+    }
+
+    if(failures != 0)
+    {
+        cout << "[-] " << failures << " estimate tests failed" << endl;
+        return -1;
+    }
+
+    cout << "[+] All estimate tests passed" << endl;
+    return 0;
+}
+
+// estimates the group and checks its interval contains the rate and only
+// has a zero width when the test expects it
+static int runTest(ESTIMATE_TEST& test)
+{
+    vector<PVALIDATOR_STRATUM> strata;
+    VALIDATOR_ESTIMATE estimate;
+    bool valid = false;
+
+    for(auto& stratum: test.strata)
+    {
+        strata.push_back(&stratum);
+    }
+
+    estimateMismatchRate(strata, estimate);
+
+    valid = (estimate.low <= estimate.rate && estimate.rate <= estimate.high);
+    if(test.exact)
+    {
+        valid = valid && (estimate.low == estimate.high);
+    }
+    else
+    {
+        valid = valid && (estimate.low < estimate.high);
+    }
+
+    cout << (valid ? "[+] " : "[-] ") << test.name << ": ";
+    cout << fixed << setprecision(4) << estimate.rate * 100 << "% ";
+    cout << "(95% CI " << estimate.low * 100 << "% - " << estimate.high * 100 << "%)" << endl;
+
+    return valid ? 0 : -1;
+}
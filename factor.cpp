@@ -0,0 +1,636 @@
+//-----------------------------------------------------------------------------
+// File: factor.cpp
+//
+// Factoring shared operands of the .slaspec instructions into subtables
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+
+#include <iostream>
+#include <boost/timer/timer.hpp>
+#include "factor.h"
+
+// true for characters that can be part of a SLEIGH identifier
+static bool isIdentifierChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// adds the identifiers of a display section piece. Ex: "@(imm_00_03_16b,r0)"
+// has "imm_00_03_16b" and "r0"
+static void getIdentifiers(const string& text, set<string>& identifiers)
+{
+    size_t i = 0;
+
+    while(i < text.length())
+    {
+        size_t start = i;
+
+        while(i < text.length() && isIdentifierChar(text[i]))
+        {
+            i++;
+        }
+
+        if(i > start)
+        {
+            identifiers.insert(text.substr(start, i - start));
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+// highest bit of a mask, -1 for an empty mask
+static int getTopBit(unsigned long long mask)
+{
+    int bit = -1;
+
+    while(mask)
+    {
+        bit++;
+        mask >>= 1;
+    }
+
+    return bit;
+}
+
+// key of the atoms for grouping instructions, names and bits of the atoms
+static string getAtomsKey(const vector<FACTOR_ATOM>& atoms)
+{
+    string key;
+
+    for(auto& atom: atoms)
+    {
+        key += atom.name + "/" + to_string(atom.mask) + " ";
+    }
+
+    return key;
+}
+
+// Finds instructions that only differ in the form of one operand and the
+// opcode bits of that form, ex. the addressing modes of the loads and stores
+// of an instruction set. When every instruction of a group has every form,
+// the forms are moved to a subtable and each instruction of the group only
+// needs a single constructor referencing it:
+//
+//   subtable_16b_0: @regA_04_07_16b is opcode_00_01_16b=0b00 & regA_04_07_16b {}
+//   subtable_16b_0: @regA_04_07_16b+ is opcode_00_01_16b=0b01 & regA_04_07_16b {}
+//   :mov.b subtable_16b_0,regB_08_11_16b is opcode_12_15_16b=0b0110 & opcode_02_03_16b=0b00 & regB_08_11_16b & subtable_16b_0 {}
+//
+// SLEIGH matches a constructor referencing a subtable by the patterns of all
+// of the subtable's constructors, so the root constructors match exactly the
+// opcodes the replaced instructions did. Must run after
+// renderOutputInstructions(), instructions stays sorted. The opcode fields of
+// the new patterns are added to parsedData.tokenFields, so this must run
+// before the "define token" sections are output
+int factorSubtables(PARSED_DATA& parsedData,
+                    vector<OUTPUT_INSTRUCTION>& instructions,
+                    string& subtables)
+{
+    boost::timer::auto_cpu_timer t;
+    vector<FACTOR_CONSTRUCTOR> constructors;
+    vector<FACTOR_SUBTABLE> factoredSubtables;
+    map<string, unsigned int> subtableIds;
+    vector<OUTPUT_INSTRUCTION> roots;
+    FACTOR_RESULTS results = {};
+    TOKEN_FIELD_KEYS tokenFields;
+    size_t maxOperands = 0;
+
+    results.constructors = instructions.size();
+
+    // split the rendered instructions back into their display and pattern
+    // pieces, instructions that can't be split are left as they are
+    for(unsigned int i = 0; i < instructions.size(); i++)
+    {
+        FACTOR_CONSTRUCTOR constructor;
+
+        if(splitFactorConstructor(instructions[i], i, constructor) != 0)
+        {
+            continue;
+        }
+
+        maxOperands = max(maxOperands, constructor.operands.size());
+        constructors.push_back(std::move(constructor));
+    }
+
+    for(unsigned int operand = 0; operand < maxOperands; operand++)
+    {
+        factorOperand(instructions,
+                      constructors,
+                      operand,
+                      factoredSubtables,
+                      subtableIds,
+                      roots,
+                      tokenFields,
+                      results);
+    }
+
+    if(roots.size() > 0)
+    {
+        // replace the factored instructions with the root constructors
+        for(auto& constructor: constructors)
+        {
+            if(constructor.factored)
+            {
+                instructions[constructor.instruction].instruction = NULL;
+            }
+        }
+
+        instructions.erase(remove_if(instructions.begin(),
+                                     instructions.end(),
+                                     [](const OUTPUT_INSTRUCTION& instruction)
+                                     {
+                                         return instruction.instruction == NULL;
+                                     }),
+                           instructions.end());
+
+        for(auto& root: roots)
+        {
+            instructions.push_back(std::move(root));
+        }
+
+        sortOutputInstructions(instructions, parsedData.numThreads);
+    }
+
+    for(auto& subtable: factoredSubtables)
+    {
+        for(auto& form: subtable.forms)
+        {
+            subtables += subtable.name + ": " + form.display + " is " +
+                         getFactorPattern(subtable.width,
+                                          subtable.mask,
+                                          form.value,
+                                          form.atoms,
+                                          tokenFields) + "\n";
+            subtables += "{}\n";
+        }
+        subtables += "\n";
+    }
+
+    parsedData.tokenFields.add(tokenFields);
+
+    printFactorResults(results);
+    return 0;
+}
+
+// Splits a rendered instruction, ":<display> is <pattern>", into the mnemonic
+// and operands of the display and the fixed bits and atoms of the pattern.
+// Returns -1 if the instruction can't be factored
+int splitFactorConstructor(OUTPUT_INSTRUCTION& instruction,
+                           unsigned int index,
+                           FACTOR_CONSTRUCTOR& constructor)
+{
+    Instruction* currInstruction = instruction.instruction;
+    string pattern = currInstruction->getOpcodeOutputString();
+    string suffix = " is " + pattern;
+    const string& text = instruction.text;
+    const string& opcode = currInstruction->getOpcode();
+    vector<string> atoms;
+    unsigned int atom = 0;
+    int bitStart = opcode.length();
+
+    if(pattern.length() == 0 ||
+       opcode.length() > 64 ||
+       text.length() <= suffix.length() + 1 ||
+       text[0] != ':' ||
+       text.compare(text.length() - suffix.length(), suffix.length(), suffix) != 0)
+    {
+        return -1;
+    }
+
+    constructor.instruction = index;
+    constructor.factored = false;
+    constructor.bits.length = opcode.length();
+    constructor.bits.mask = 0;
+    constructor.bits.value = 0;
+
+    //
+    // display, the mnemonic then the operands split at the commas outside of
+    // parentheses and quotes
+    //
+    string display = text.substr(1, text.length() - 1 - suffix.length());
+    size_t mnemonicEnd = display.find(' ');
+
+    constructor.mnemonic = display.substr(0, mnemonicEnd);
+    if(mnemonicEnd != string::npos)
+    {
+        string operand;
+        int depth = 0;
+        bool quoted = false;
+
+        for(auto c: display.substr(mnemonicEnd + 1))
+        {
+            if(c == '"')
+            {
+                quoted = !quoted;
+            }
+            else if(!quoted && c == '(')
+            {
+                depth++;
+            }
+            else if(!quoted && c == ')')
+            {
+                depth--;
+            }
+            else if(!quoted && depth == 0 && c == ',')
+            {
+                constructor.operands.push_back(operand);
+                operand = "";
+                continue;
+            }
+
+            operand.push_back(c);
+        }
+
+        constructor.operands.push_back(operand);
+    }
+
+    //
+    // pattern, one atom per opcode piece in the order of splitOpcode followed
+    // by the registers that aren't part of the opcode
+    //
+    boost::split(atoms, pattern, boost::is_any_of("&"));
+    for(auto& name: atoms)
+    {
+        boost::trim(name);
+    }
+
+    for(auto& opcodeString: currInstruction->splitOpcode)
+    {
+        unsigned long long mask = 0;
+
+        bitStart -= opcodeString.length();
+
+        if(opcodeString[0] == '*')
+        {
+            continue;
+        }
+
+        if(atom >= atoms.size())
+        {
+            return -1;
+        }
+
+        for(unsigned int i = 0; i < opcodeString.length(); i++)
+        {
+            mask |= 1ULL << (bitStart + opcodeString.length() - 1 - i);
+        }
+
+        if(opcodeString[0] == '0' || opcodeString[0] == '1')
+        {
+            constructor.bits.mask |= mask;
+            constructor.bits.value |= stoull(opcodeString, NULL, 2) << bitStart;
+        }
+        else
+        {
+            constructor.atoms.push_back({atoms[atom], mask});
+        }
+
+        atom++;
+    }
+
+    for(; atom < atoms.size(); atom++)
+    {
+        constructor.atoms.push_back({atoms[atom], 0});
+    }
+
+    // atoms are matched to the operands by name
+    for(auto& currAtom: constructor.atoms)
+    {
+        if(currAtom.name.length() == 0 ||
+           !all_of(currAtom.name.begin(), currAtom.name.end(), isIdentifierChar))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Factors one operand of the remaining instructions. Instructions are grouped
+// by the form of the operand, its display and atoms, and by everything else,
+// the root. A set of forms that appears with exactly the same set of roots is
+// the product of the two. It's factored if the fixed opcode bits split into
+// bits that only depend on the form and bits that only depend on the root
+void factorOperand(vector<OUTPUT_INSTRUCTION>& instructions,
+                   vector<FACTOR_CONSTRUCTOR>& constructors,
+                   unsigned int operand,
+                   vector<FACTOR_SUBTABLE>& subtables,
+                   map<string, unsigned int>& subtableIds,
+                   vector<OUTPUT_INSTRUCTION>& roots,
+                   TOKEN_FIELD_KEYS& tokenFields,
+                   FACTOR_RESULTS& results)
+{
+    // key = form, value = root to constructor id
+    map<string, map<string, unsigned int>> forms;
+
+    // forms that appear twice with the same root, they can't be told apart
+    set<string> conflictingForms;
+
+    // key = every root of a form, value = the forms
+    map<string, vector<string>> products;
+
+    // the atoms of the form and the root of each constructor
+    vector<vector<FACTOR_ATOM>> formAtoms(constructors.size());
+    vector<vector<FACTOR_ATOM>> rootAtoms(constructors.size());
+
+    for(unsigned int i = 0; i < constructors.size(); i++)
+    {
+        FACTOR_CONSTRUCTOR& constructor = constructors[i];
+        set<string> formIdentifiers;
+        set<string> rootIdentifiers;
+        string formKey;
+        string rootKey;
+        bool shared = false;
+
+        if(constructor.factored ||
+           constructor.operands.size() <= operand ||
+           constructor.operands[operand].length() == 0)
+        {
+            continue;
+        }
+
+        getIdentifiers(constructor.operands[operand], formIdentifiers);
+        getIdentifiers(constructor.mnemonic, rootIdentifiers);
+        for(unsigned int j = 0; j < constructor.operands.size(); j++)
+        {
+            if(j != operand)
+            {
+                getIdentifiers(constructor.operands[j], rootIdentifiers);
+            }
+        }
+
+        // the atoms the operand displays move to the subtable
+        for(auto& atom: constructor.atoms)
+        {
+            if(formIdentifiers.count(atom.name) > 0)
+            {
+                shared |= rootIdentifiers.count(atom.name) > 0;
+                formAtoms[i].push_back(atom);
+            }
+            else
+            {
+                rootAtoms[i].push_back(atom);
+            }
+        }
+
+        if(shared)
+        {
+            continue;
+        }
+
+        formKey = to_string(constructor.bits.length) + " " +
+                  to_string(constructor.bits.mask) + "\n" +
+                  constructor.operands[operand] + "\n" +
+                  getAtomsKey(formAtoms[i]);
+
+        // the forms of a product share the fixed opcode bits of the roots,
+        // so they must have the same mask as well
+        rootKey = to_string(constructor.bits.length) + " " +
+                  to_string(constructor.bits.mask) + "\n" +
+                  constructor.mnemonic + "\n";
+        for(unsigned int j = 0; j < constructor.operands.size(); j++)
+        {
+            rootKey += (j == operand ? string("\x01") : constructor.operands[j]) + ",";
+        }
+        rootKey += "\n" + getAtomsKey(rootAtoms[i]) + "\n";
+
+        auto& roots = forms[formKey];
+        if(roots.find(rootKey) != roots.end())
+        {
+            conflictingForms.insert(formKey);
+        }
+        roots[rootKey] = i;
+    }
+
+    for(auto& form: forms)
+    {
+        string product;
+
+        if(conflictingForms.count(form.first) > 0)
+        {
+            continue;
+        }
+
+        for(auto& root: form.second)
+        {
+            product += root.first;
+        }
+
+        products[product].push_back(form.first);
+    }
+
+    for(auto& product: products)
+    {
+        vector<string>& productForms = product.second;
+        map<string, unsigned int>& firstForm = forms[productForms[0]];
+        size_t numRoots = firstForm.size();
+        size_t numForms = productForms.size();
+        unsigned long long formMask = 0;
+        set<unsigned long long> formValues;
+        set<unsigned long long> rootValues;
+        vector<unsigned long long> values;
+
+        // only factor when it saves constructors
+        if(numRoots * numForms <= numRoots + numForms)
+        {
+            continue;
+        }
+
+        // bits that differ between the forms of a root
+        for(auto& root: firstForm)
+        {
+            unsigned long long firstValue = constructors[root.second].bits.value;
+
+            for(auto& form: productForms)
+            {
+                formMask |= constructors[forms[form][root.first]].bits.value ^ firstValue;
+            }
+        }
+
+        // the form bits must be the same for every root, and the forms and
+        // roots must be told apart by their bits
+        bool isProduct = true;
+        for(auto& form: productForms)
+        {
+            unsigned long long formValue = 0;
+
+            formValue = constructors[forms[form].begin()->second].bits.value & formMask;
+            for(auto& root: forms[form])
+            {
+                if((constructors[root.second].bits.value & formMask) != formValue)
+                {
+                    isProduct = false;
+                }
+            }
+
+            formValues.insert(formValue);
+            values.push_back(formValue);
+        }
+
+        for(auto& root: firstForm)
+        {
+            rootValues.insert(constructors[root.second].bits.value & ~formMask);
+        }
+
+        if(!isProduct ||
+           formValues.size() != numForms ||
+           rootValues.size() != numRoots)
+        {
+            continue;
+        }
+
+        //
+        // add the subtable, unless the same one was already added
+        //
+        FACTOR_CONSTRUCTOR& firstConstructor = constructors[firstForm.begin()->second];
+        FACTOR_SUBTABLE subtable;
+        string subtableKey;
+
+        subtable.width = firstConstructor.bits.length;
+        subtable.mask = formMask;
+
+        for(unsigned int i = 0; i < numForms; i++)
+        {
+            unsigned int id = forms[productForms[i]].begin()->second;
+            FACTOR_FORM form;
+
+            form.display = constructors[id].operands[operand];
+            form.atoms = formAtoms[id];
+            form.value = values[i];
+
+            subtableKey += to_string(form.value) + "\n" + form.display + "\n" + getAtomsKey(form.atoms) + "\n";
+            subtable.forms.push_back(std::move(form));
+        }
+        subtableKey = to_string(subtable.width) + " " + to_string(subtable.mask) + "\n" + subtableKey;
+
+        auto subtableItr = subtableIds.find(subtableKey);
+        if(subtableItr == subtableIds.end())
+        {
+            subtable.name = "subtable_" + to_string(subtable.width) + "b_" + to_string(subtables.size());
+            subtableItr = subtableIds.emplace(subtableKey, subtables.size()).first;
+            results.subtableConstructors += numForms;
+            subtables.push_back(std::move(subtable));
+        }
+
+        const string& subtableName = subtables[subtableItr->second].name;
+
+        //
+        // a root constructor per root, in place of the root's instructions
+        //
+        for(auto& root: firstForm)
+        {
+            FACTOR_CONSTRUCTOR& constructor = constructors[root.second];
+            OUTPUT_INSTRUCTION rootInstruction;
+            string pattern;
+
+            rootInstruction.text = ":" + constructor.mnemonic + " ";
+            for(unsigned int j = 0; j < constructor.operands.size(); j++)
+            {
+                rootInstruction.text += (j > 0 ? "," : "");
+                rootInstruction.text += (j == operand ? subtableName : constructor.operands[j]);
+            }
+
+            pattern = getFactorPattern(constructor.bits.length,
+                                       constructor.bits.mask & ~formMask,
+                                       constructor.bits.value & ~formMask,
+                                       rootAtoms[root.second],
+                                       tokenFields);
+            rootInstruction.text += " is " + (pattern.length() > 0 ? pattern + " & " : "") + subtableName;
+
+            rootInstruction.order = instructions[constructor.instruction].order;
+            rootInstruction.instruction = instructions[constructor.instruction].instruction;
+
+            for(auto& form: productForms)
+            {
+                FACTOR_CONSTRUCTOR& factoredConstructor = constructors[forms[form][root.first]];
+
+                factoredConstructor.factored = true;
+                rootInstruction.order = min(rootInstruction.order,
+                                            instructions[factoredConstructor.instruction].order);
+                rootInstruction.factoredInstructions.push_back(instructions[factoredConstructor.instruction].instruction);
+            }
+
+            roots.push_back(std::move(rootInstruction));
+        }
+
+        results.factored += numRoots * numForms;
+        results.roots += numRoots;
+    }
+}
+
+// Renders a pattern section with the fixed bits of mask as opcode fields and
+// the atoms, ordered by their highest bit like getOpcodeOutputString(). The
+// opcode fields are added to tokenFields
+string getFactorPattern(unsigned int width,
+                        unsigned long long mask,
+                        unsigned long long value,
+                        const vector<FACTOR_ATOM>& atoms,
+                        TOKEN_FIELD_KEYS& tokenFields)
+{
+    vector<pair<int, string>> pieces;
+    string output;
+    int bit = width - 1;
+
+    // a field per run of fixed bits
+    while(bit >= 0)
+    {
+        int end = bit;
+        string bits;
+
+        if(((mask >> bit) & 1) == 0)
+        {
+            bit--;
+            continue;
+        }
+
+        while(bit >= 0 && ((mask >> bit) & 1))
+        {
+            bits.push_back(((value >> bit) & 1) ? '1' : '0');
+            bit--;
+        }
+
+        tokenFields.insert(TokenFields::getKey(TOKEN_FIELD_OPCODE, bit + 1, end, width, 0));
+        pieces.push_back({end, getTokenFieldName(TOKEN_FIELD_OPCODE, bit + 1, end, width) + "=0b" + bits});
+    }
+
+    for(auto& atom: atoms)
+    {
+        pieces.push_back({getTopBit(atom.mask), atom.name});
+    }
+
+    stable_sort(pieces.begin(),
+                pieces.end(),
+                [](const pair<int, string>& left, const pair<int, string>& right)
+                {
+                    return left.first > right.first;
+                });
+
+    for(auto& piece: pieces)
+    {
+        output += (output.length() > 0 ? " & " : "") + piece.second;
+    }
+
+    return output;
+}
+
+void printFactorResults(FACTOR_RESULTS& results)
+{
+    unsigned long long constructors = results.constructors - results.factored +
+                                      results.roots + results.subtableConstructors;
+
+    cout << "[*] Subtable factoring: " << results.factored << " instructions replaced by "
+         << results.roots << " root constructors and " << results.subtableConstructors
+         << " subtable constructors" << endl;
+
+    cout << "[*] Constructors: " << results.constructors << " -> " << constructors;
+    if(results.constructors > 0)
+    {
+        cout << " (" << (long long)(results.constructors - constructors) * 100 / (long long)results.constructors
+             << "% fewer)";
+    }
+    cout << endl;
+}
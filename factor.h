@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------------
+// File: factor.h
+//
+// Factoring shared operands of the .slaspec instructions into subtables
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "output.h"
+
+// a pattern section element of an instruction other than its fixed opcode
+// bits. Ex: "regA_04_07_16b" or "r0"
+typedef struct _FACTOR_ATOM
+{
+    string name;
+    unsigned long long mask; // bits of the field, 0 for registers without bits
+} FACTOR_ATOM, *PFACTOR_ATOM;
+
+// a rendered instruction split into its display and pattern sections
+typedef struct _FACTOR_CONSTRUCTOR
+{
+    unsigned int instruction; // index into the OUTPUT_INSTRUCTIONs
+    CONSTRUCTOR_MASK bits; // fixed opcode bits
+    string mnemonic;
+    vector<string> operands; // display split at the top level commas
+    vector<FACTOR_ATOM> atoms;
+    bool factored;
+} FACTOR_CONSTRUCTOR, *PFACTOR_CONSTRUCTOR;
+
+// a subtable constructor, one form of the factored operand
+typedef struct _FACTOR_FORM
+{
+    string display;
+    vector<FACTOR_ATOM> atoms;
+    unsigned long long value; // fixed opcode bits of the form
+} FACTOR_FORM, *PFACTOR_FORM;
+
+// a subtable, shared by all instructions with the same operand forms
+typedef struct _FACTOR_SUBTABLE
+{
+    string name; // Ex: "subtable_16b_0"
+    unsigned int width;
+    unsigned long long mask; // opcode bits the forms are told apart by
+    vector<FACTOR_FORM> forms;
+} FACTOR_SUBTABLE, *PFACTOR_SUBTABLE;
+
+typedef struct _FACTOR_RESULTS
+{
+    unsigned long long constructors; // instructions before factoring
+    unsigned long long factored; // instructions replaced by root constructors
+    unsigned long long roots; // root constructors referencing a subtable
+    unsigned long long subtableConstructors;
+} FACTOR_RESULTS, *PFACTOR_RESULTS;
+
+int factorSubtables(PARSED_DATA& parsedData,
+                    vector<OUTPUT_INSTRUCTION>& instructions,
+                    string& subtables);
+int splitFactorConstructor(OUTPUT_INSTRUCTION& instruction,
+                           unsigned int index,
+                           FACTOR_CONSTRUCTOR& constructor);
+void factorOperand(vector<OUTPUT_INSTRUCTION>& instructions,
+                   vector<FACTOR_CONSTRUCTOR>& constructors,
+                   unsigned int operand,
+                   vector<FACTOR_SUBTABLE>& subtables,
+                   map<string, unsigned int>& subtableIds,
+                   vector<OUTPUT_INSTRUCTION>& roots,
+                   TOKEN_FIELD_KEYS& tokenFields,
+                   FACTOR_RESULTS& results);
+string getFactorPattern(unsigned int width,
+                        unsigned long long mask,
+                        unsigned long long value,
+                        const vector<FACTOR_ATOM>& atoms,
+                        TOKEN_FIELD_KEYS& tokenFields);
+void printFactorResults(FACTOR_RESULTS& results);
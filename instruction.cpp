@@ -364,9 +364,7 @@ int Instruction::getInstructionDuplicatedRegisters(bool getCombined,
 
 // loops through the instruction's components and generates the opcode string
 // example output: opcode_12_15=0b0110 & rn_08_11 & rm_04_07 & opcode_00_03=0b0011
-// while looping through all instructions, it appends the tokenInstructions set
-// the tokens it comes across
-string Instruction::getOpcodeOutputString(set<string>& tokenInstruction)
+string Instruction::getOpcodeOutputString(void)
 {
     // so we only print each register once
     map<string, unsigned int> outputtedRegisters;
@@ -379,7 +377,6 @@ string Instruction::getOpcodeOutputString(set<string>& tokenInstruction)
     {
         string temp = "";
         string opcodeName = "";
-        char opcodeNameBuf[32] = {0};
 
         if(isFirst != true)
         {
@@ -388,29 +385,19 @@ string Instruction::getOpcodeOutputString(set<string>& tokenInstruction)
 
         if(opcodeString[0] == '0' || opcodeString[0] == '1')
         {
-            opcodeName = "opcode";
-            snprintf(opcodeNameBuf, 
-                     sizeof(opcodeNameBuf) - 1,
-                     "%s_%02u_%02u_%db",
-                     opcodeName.c_str(),
-                     (unsigned int)(bitStart - opcodeString.length()),
-                     bitStart - 1,
-                     (int)this->opcode.length()
-                     );
-            temp += string(opcodeNameBuf) + "=0b" + opcodeString + " ";
+            opcodeName = getTokenFieldName(TOKEN_FIELD_OPCODE,
+                                           bitStart - opcodeString.length(),
+                                           bitStart - 1,
+                                           this->opcode.length());
+            temp += opcodeName + "=0b" + opcodeString + " ";
         }
         else if(opcodeString[0] >= 'a' && opcodeString[0] <= 'z')
         {
-            opcodeName = "imm";
-            snprintf(opcodeNameBuf, 
-                     sizeof(opcodeNameBuf) - 1,
-                     "%s_%02u_%02u_%db",
-                     opcodeName.c_str(),
-                     (unsigned int)(bitStart - opcodeString.length()),
-                     bitStart - 1,
-                     (int)this->opcode.length()
-                     );
-            temp += string(opcodeNameBuf) + " ";
+            opcodeName = getTokenFieldName(TOKEN_FIELD_IMMEDIATE,
+                                           bitStart - opcodeString.length(),
+                                           bitStart - 1,
+                                           this->opcode.length());
+            temp += opcodeName + " ";
         }
         else if(opcodeString[0] >= 'A' && opcodeString[0] <= 'Z')
         {
@@ -424,13 +411,7 @@ string Instruction::getOpcodeOutputString(set<string>& tokenInstruction)
             {
                 opcodeName = this->components[regPos].component;
             }
-            snprintf(opcodeNameBuf,
-                     sizeof(opcodeNameBuf) - 1,
-                     "%s",
-                     opcodeName.c_str()
-                     //(int)this->opcode.length()
-                     );
-            temp += string(opcodeNameBuf) + " ";
+            temp += opcodeName + " ";
         }
         else if(opcodeString[0] == '*')
         {
@@ -446,7 +427,6 @@ string Instruction::getOpcodeOutputString(set<string>& tokenInstruction)
         }
 
         output += temp;
-        tokenInstruction.insert(opcodeNameBuf);
 
         bitStart -= opcodeString.length();
         isFirst = false;
@@ -499,6 +479,49 @@ string Instruction::getOpcodeOutputString(set<string>& tokenInstruction)
     return output;
 } // for(std::vector<InstructionComponent>::iterator it = this->components.begin(); it != this->components.end(); ++it)
 
+// Adds the keys of the opcode and immediate fields of the instruction to
+// tokenFields. Register fields are added when their attach variable is named.
+// Must be called after separateOpcode()
+int Instruction::getTokenFields(TOKEN_FIELD_KEYS& tokenFields)
+{
+    unsigned int bitStart = this->opcode.length();
+
+    for(auto& opcodeString: this->splitOpcode)
+    {
+        unsigned int start = bitStart - opcodeString.length();
+
+        bitStart -= opcodeString.length();
+
+        if(opcodeString[0] == '0' || opcodeString[0] == '1')
+        {
+            tokenFields.insert(TokenFields::getKey(TOKEN_FIELD_OPCODE,
+                                                   start,
+                                                   start + opcodeString.length() - 1,
+                                                   this->opcode.length(),
+                                                   0));
+        }
+        else if(opcodeString[0] >= 'a' && opcodeString[0] <= 'z')
+        {
+            tokenFields.insert(TokenFields::getKey(TOKEN_FIELD_IMMEDIATE,
+                                                   start,
+                                                   start + opcodeString.length() - 1,
+                                                   this->opcode.length(),
+                                                   0));
+        }
+        else if(opcodeString[0] == '*' || (opcodeString[0] >= 'A' && opcodeString[0] <= 'Z'))
+        {
+            continue;
+        }
+        else
+        {
+            cout << "[-] Unknown bit pattern!!" << endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 // helper function to seperate an opcode bitstring into multiple components
 // this is a precursor to be able to print the opcode in the .slaspec file
 void Instruction::separateOpcode(void)
@@ -850,9 +873,10 @@ bool Instruction::areInstructionComponentsEqualExceptRegister(Instruction* right
     return true;
 }
 
-int test_getdisassemblysla(string& opcode, vector<Slautil>& slas, unsigned int register_id, string& registerName)
+int test_getdisassemblysla(string& opcode, vector<Slautil>& slas, SlaIndex& slaIndex, unsigned int register_id, string& registerName)
 {
-    for(unsigned int i = 0; i < slas.size(); i++)
+    // only try the .sla files that have a constructor for this opcode
+    for(auto i: slaIndex.getCandidateSlas(opcode))
     {        
         int result = 0;
         unsigned int id = 0;
@@ -884,13 +908,15 @@ int test_getdisassemblysla(string& opcode, vector<Slautil>& slas, unsigned int r
 // This function takes an opcode string with variable register bits = 
 // ex "0100AAAA"
 // and attempts to figure out which registers are used required for the "attach
-// variables" directive in the .slaspec. Returns a string of registers in
-// foundRegister on success
+// variables" directive in the .slaspec. Returns the registers by field value
+// in foundRegisters on success
 int Instruction::generateAttachedRegisters(string opcode,
                                            unsigned int regStart,
                                            unsigned int regEnd,
                                            map<string, Instruction*>& allInstructions,
-                                           vector<Slautil>& slas, string& foundRegisters)
+                                           vector<Slautil>& slas,
+                                           SlaIndex& slaIndex,
+                                           vector<string>& foundRegisters)
 {
     map<string, Instruction*>::iterator itr;
     int registerPosition = 0;
@@ -942,9 +968,7 @@ int Instruction::generateAttachedRegisters(string opcode,
         itr = allInstructions.find(tempOpcode);
         if(itr != allInstructions.end())
         {
-
-            reg = itr->second->components[registerPosition].component;
-            foundRegisters += reg + " ";
+            foundRegisters.push_back(itr->second->components[registerPosition].component);
             continue; 
         }
 
@@ -957,31 +981,55 @@ int Instruction::generateAttachedRegisters(string opcode,
         registerPosition = registerLetter - 'A';
         int result = test_getdisassemblysla(tempOpcode,
                                             slas,
+                                            slaIndex,
                                             registerPosition,
                                             reg);
         if(result == 0)
         {
-            foundRegisters += reg + " ";
+            foundRegisters.push_back(reg);
             continue;
         }
 
         // TODO: handle this error
         throw 1;
+    }
+
+    return 0;
+}
+
+// Returns everything generateAttachedRegisters() depends on for the register
+// field [regStart, regEnd) of this instruction: the opcode with the other
+// fields zeroed, the field bits, the field letter and the position of the
+// register in the instructions it looks up. Fields with the same key have the
+// same list of attached registers
+string Instruction::getAttachedRegistersKey(unsigned int regStart, unsigned int regEnd)
+{
+    string key = this->opcode;
 
-        foundRegisters += "whoops ";
+    for(unsigned int i = 0; i < key.length(); i++)
+    {
+        if(key[i] != '0' && key[i] != '1')
+        {
+            key[i] = '0';
+        }
     }
 
-    boost::trim_right(foundRegisters);
+    key += ":" + to_string(regStart) +
+           ":" + to_string(regEnd) +
+           ":" + this->opcode[regStart] +
+           ":" + to_string(this->getComponentPositionFromLetter(this->opcode[regStart]));
 
-    return 0;
+    return key;
 }
 
 // Helper function for generating the "attach variable" directive for the 
 // .slaspec. This involves figuring out all of the registers needed in a 
 // register bitfield
 int Instruction::computeAttachVariables(map<string, Instruction*>& allInstructions,
-                                        map<string, string>& attachVariables,
-                                        vector<Slautil>& slas)
+                                        vector<Slautil>& slas,
+                                        SlaIndex& slaIndex,
+                                        RegisterLists& registerLists,
+                                        vector<ATTACH_REGISTER_FIELD>& registerFields)
 {
     // seperate the opcode into various components
     this->separateOpcode();
@@ -997,22 +1045,34 @@ int Instruction::computeAttachVariables(map<string, Instruction*>& allInstructio
         // only register components have attach variables
         if(opcodeComponent[0] >= 'A' && opcodeComponent[0] <= 'Z')
         {
-            string registerName;
-            string foundRegisters;
+            ATTACH_REGISTER_FIELD registerField;
+            unsigned int listId = 0;
 
             position = this->getComponentPositionFromLetter(opcodeComponent[0]);
 
-            // generate a list of all attached registers
-            int result = generateAttachedRegisters(this->opcode,
-                                                   bitStart,
-                                                   bitStart + opcodeComponent.length(),
-                                                   allInstructions,
-                                                   slas,
-                                                   foundRegisters);
-            if(result != 0)
+            // the same field is shared by many combined instructions, only
+            // generate its list of attached registers the first time
+            string fieldKey = this->getAttachedRegistersKey(bitStart,
+                                                            bitStart + opcodeComponent.length());
+            if(!registerLists.findField(fieldKey, listId))
             {
-                cout << "Failed to generate attached registers!!" << endl;
-                return -1;
+                vector<string> foundRegisters;
+
+                int result = generateAttachedRegisters(this->opcode,
+                                                       bitStart,
+                                                       bitStart + opcodeComponent.length(),
+                                                       allInstructions,
+                                                       slas,
+                                                       slaIndex,
+                                                       foundRegisters);
+                if(result != 0)
+                {
+                    cout << "Failed to generate attached registers!!" << endl;
+                    return -1;
+                }
+
+                listId = registerLists.intern(foundRegisters);
+                registerLists.addField(fieldKey, listId);
             }
 
             char regName[16];
@@ -1027,56 +1087,15 @@ int Instruction::computeAttachVariables(map<string, Instruction*>& allInstructio
                      regEnd,
                      (int)this->getOpcode().length()
                      );
-            registerName = regName;
-
-            //
-            // now that we have the list of registers, we need to name the attach variable itself
-            // this is tricky because we can't reuse the same name for different lists of registers
-            // To solve that we increment the number of the variable name on collisions
-            //
-
-            // TODO: move this to a function
-            bool inserted = false;
-            int counter = 2;
-            while(inserted == false)
-            {
-                auto itr = attachVariables.find(registerName);
-                if(itr == attachVariables.end())
-                {
-                    attachVariables.insert({{registerName, foundRegisters}});
-                    inserted = true;
-                }
-                else
-                {
-                    if(foundRegisters == itr->second)
-                    {
-                        inserted = true;
-                    }
-                    else
-                    {   
-                        if(counter > 2 && counter < 10)
-                        {
-                            // TODO: what if counter is bigger than 10?
-                            //cout << "problem here" << endl;
-                            registerName.resize(registerName.length() - 2);
-                        }
-                        else if(counter >= 10 && counter < 100)
-                        {
-                            registerName.resize(registerName.length() - 3);
-                        }
-                        else if(counter >= 100)
-                        {
-                            registerName.resize(registerName.length() - 4);
-                        }
-
-                        registerName = registerName + "_" + to_string(counter);
-                        //cout << registerName << endl;
-                        counter++;
-                    }
-                }
-            }
 
-            this->components[position].combinedComponent = registerName;
+            // the variable is named later by nameAttachVariables(), the name
+            // depends on the fields of the instructions before this one
+            registerField.position = position;
+            registerField.name = regName;
+            registerField.listId = listId;
+            registerField.start = regStart;
+            registerField.end = regEnd;
+            registerFields.push_back(registerField);
         }
         // replace immediate values as well
         else if(opcodeComponent[0] >= 'a' && opcodeComponent[0] <= 'z')
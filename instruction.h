@@ -12,6 +12,9 @@
 #include <boost/regex.hpp>
 #include <set>
 #include "slautil/slautil.h"
+#include "slautil/slaindex.h"
+#include "register_lists.h"
+#include "token_fields.h"
 using namespace std;
 
 enum InstructionComponentType
@@ -23,6 +26,17 @@ enum InstructionComponentType
     TYPE_MAX, // Not a valid type, must be the last one
 };
 
+// a register field of an instruction found by computeAttachVariables(), the
+// field is given its attach variable name once all instructions are computed
+typedef struct _ATTACH_REGISTER_FIELD
+{
+    unsigned int position; // index into the instruction's components
+    string name; // name before collisions are resolved. Ex: "regA_04_07_32b"
+    unsigned int listId; // id of the register list in RegisterLists
+    unsigned int start; // bits of the field, bit 0 is the last bit of the opcode
+    unsigned int end;
+} ATTACH_REGISTER_FIELD, *PATTACH_REGISTER_FIELD;
+
 class InstructionComponent
 {
     public:
@@ -66,7 +80,8 @@ class Instruction
         string printInstruction(set<string>& tokenInstructions);
         string getInstructionOutputString(bool getCombined, bool escapeDuplicateRegisters);
         int getInstructionDuplicatedRegisters(bool getCombined, map<string, unsigned int>& duplicatedRegisters);
-        string getOpcodeOutputString(set<string>& tokenInstructions);
+        string getOpcodeOutputString(void);
+        int getTokenFields(TOKEN_FIELD_KEYS& tokenFields);
 
         // basic checks that the instruction is sane
         bool validateInstruction(void);
@@ -79,8 +94,9 @@ class Instruction
 
         // for creating the .slaspec
         void separateOpcode();
-        int computeAttachVariables(map<string, Instruction*>& allInstructions, map<string, string>& attachVariables, vector<Slautil>& slas);
-        int generateAttachedRegisters(string opcode, unsigned int regStart, unsigned int regEnd, map<string, Instruction*>& allInstructions, vector<Slautil>& slas, string& foundRegisters);
+        int computeAttachVariables(map<string, Instruction*>& allInstructions, vector<Slautil>& slas, SlaIndex& slaIndex, RegisterLists& registerLists, vector<ATTACH_REGISTER_FIELD>& registerFields);
+        int generateAttachedRegisters(string opcode, unsigned int regStart, unsigned int regEnd, map<string, Instruction*>& allInstructions, vector<Slautil>& slas, SlaIndex& slaIndex, vector<string>& foundRegisters);
+        string getAttachedRegistersKey(unsigned int regStart, unsigned int regEnd);
 
     //private:
         string opcode; // entire opcode of instruction in binary
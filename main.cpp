@@ -13,10 +13,12 @@
 #include <boost/filesystem.hpp>
 #include <boost/range/iterator_range.hpp>
 #include <boost/thread.hpp>
+#include "benchmark.h"
 #include "combine.h"
 #include "parser.h"
 #include "parser_sla.h"
 #include "output.h"
+#include "selfcheck.h"
 using namespace std;
 
 using namespace boost::filesystem;
@@ -26,7 +28,8 @@ int generateFromSleigh(PARSED_DATA& parsedData,
                        bool skipInstructionCombining);
 int generateFromText(PARSED_DATA& parsedData,
                      bool printRegistersOnly,
-                     bool skipInstructionCombining);
+                     bool skipInstructionCombining,
+                     bool skipSelfCheck);
 int readFilenamesFromDirectory(PARSED_DATA& parsedData,
                                const string& dirPath,
                                const string& extension);
@@ -40,9 +43,13 @@ int main(int argc, char *argv[])
     PARSED_DATA parsedData;
     bool skipInstructionCombining; // if set, skip attempting to combine
                                    // instructions. Useful for debugging
+    bool skipSelfCheck; // if set, don't check the combined instructions
+                        // against the parsed ones
     bool printRegistersOnly; // if set parse the instruction set and only
                              // display the registers. Useful for debugging purposes.
     bool parseSleigh; // if set the input is .sla, not disassembly text
+    bool scalingReport; // if set time the pipeline at 1, 2, 4, ... threads
+                        // instead of a single run
     string inputFilename;
     string inputDirectory;
     boost::timer::auto_cpu_timer t;
@@ -50,8 +57,10 @@ int main(int argc, char *argv[])
 
     parsedData.maxOpcodeBits = 0;
     skipInstructionCombining = false;
+    skipSelfCheck = false;
     printRegistersOnly = false;
     parseSleigh = false;
+    scalingReport = false;
 
     cout << "Ghidra Processor Module Generator" << endl;
 
@@ -64,9 +73,11 @@ int main(int argc, char *argv[])
         desc.add_options()
             ("input-disassembly,i", boost::program_options::value<string>(&inputFilename), "Path to a newline delimited text file containing all opcodes and instructions for the processor module.")
             ("input-disassembly-dir", boost::program_options::value<string>(&inputDirectory), "Path to a directory with multiple newline delimited text files containing all opcodes and instructions for the processor module.")
-            ("input-sleigh,s", boost::program_options::value<string>(&inputFilename), "Path to a XML .sla file containing all opcodes and instructions for the processor module.")
-            ("input-sleigh-dir", boost::program_options::value<string>(&inputDirectory), "Path to a directory with multiple XML .sla files containing all opcodes and instructions for the processor module.")
+            ("input-sleigh,s", boost::program_options::value<string>(&inputFilename), "Path to a packed binary or XML .sla file containing all opcodes and instructions for the processor module.")
+            ("input-sleigh-dir", boost::program_options::value<string>(&inputDirectory), "Path to a directory with multiple packed binary or XML .sla files containing all opcodes and instructions for the processor module.")
             ("num-threads,t", boost::program_options::value<unsigned int>(&parsedData.numThreads), "Number of worker threads to use. Optional. Defaults to number of physical CPUs if not specified")
+            ("sla-cache", boost::program_options::bool_switch(&parsedData.useSlaCache)->default_value(false), "Cache parsed .sla files next to them as <file>.sla.cache and load the cache instead on later runs while the .sla is unchanged. False by default")
+            ("tree-merge", boost::program_options::bool_switch(&parsedData.treeMerge)->default_value(false), "Combine the --input-sleigh-dir .sla files pairwise by opcode prefix, level by level, instead of combining all of their instructions at once. Uses less memory for many shards. The .sla files must not share opcodes. False by default")
             ("processor-name,n",boost::program_options::value<string>(&parsedData.processorName)->default_value("MyProc"), "Name of the target processor. Defaults to \"MyProc\" if not specified")
             ("processor-family,f",boost::program_options::value<string>(&parsedData.processorFamily)->default_value("MyProcFamily"), "Name of the target processor's family. Defaults to \"MyProcFamily\" if not specified")
             ("endian,e", boost::program_options::value<string>(&parsedData.endianness)->default_value("big"), "Endianness of the processor. Must be either \"little\" or \"big\". Defaults to big if not specified")
@@ -75,7 +86,10 @@ int main(int argc, char *argv[])
             ("print-registers-only", boost::program_options::bool_switch(&printRegistersOnly), "Only print parsed registers. Useful for debugging purposes. False by default")
             ("omit-opcodes", boost::program_options::bool_switch(&parsedData.omitOpcodes)->default_value(false), "Don't print opcodes in the outputted .sla file. False by default")
             ("omit-example-instructions", boost::program_options::bool_switch(&parsedData.omitExampleInstructions)->default_value(false), "Don't print example combined instructions in the outputted .sla file. False by default")
+            ("factor-subtables", boost::program_options::bool_switch(&parsedData.factorSubtables)->default_value(false), "Factor operand forms shared by many instructions, ex. addressing modes, into SLEIGH subtables to output fewer constructors. Prints how many constructors were saved. False by default")
             ("skip-instruction-combining", boost::program_options::bool_switch(&skipInstructionCombining), "Don't combine instructions. Useful for debugging purposes. False by default")
+            ("skip-self-check", boost::program_options::bool_switch(&skipSelfCheck), "Don't decode the parsed instructions with the combined instructions before generating the .slaspec. Text input only. False by default")
+            ("scaling-report", boost::program_options::bool_switch(&scalingReport), "Run the full pipeline at 1, 2, 4, ... up to --num-threads threads and print the speedup and parallel efficiency of each phase. Requires a single input file. False by default")
             ("additional-registers,ar", boost::program_options::value<vector<string>>(&additionalRegisters)->multitoken(), "List of additional registers. Use this option if --print-registers-only is missing registers for your instruction set")
             ("help,h", "Help screen");
 
@@ -112,6 +126,18 @@ int main(int argc, char *argv[])
             return -1;
         }
 
+        if(parsedData.treeMerge && args.count("input-sleigh-dir") == 0)
+        {
+            cout << "--tree-merge requires --input-sleigh-dir" << endl;
+            return -1;
+        }
+
+        if(parsedData.treeMerge && skipInstructionCombining)
+        {
+            cout << "--tree-merge combines the instructions, it can't be used with --skip-instruction-combining" << endl;
+            return -1;
+        }
+
         if(args.count("input-disassembly") != 0)
         {
             parsedData.inputFilenames.push_back(inputFilename);
@@ -170,6 +196,12 @@ int main(int argc, char *argv[])
             cout << "Invalid number of threads specified" << endl;
             return -1;    
         }
+
+        if(scalingReport && parsedData.inputFilenames.size() != 1)
+        {
+            cout << "--scaling-report requires a single input file" << endl;
+            return -1;
+        }
     }
     catch (const boost::program_options::error &ex)
     {
@@ -197,12 +229,22 @@ int main(int argc, char *argv[])
         goto ERROR_CLEANUP;
     }
 
+    if(scalingReport)
+    {
+        result = runScalingReport(parsedData,
+                                  parsedData.inputFilenames[0],
+                                  parsedData.numThreads,
+                                  SCALING_REPORT_RUNS);
+        goto ERROR_CLEANUP;
+    }
+
     if(parseSleigh == false)
     {
         // user supplied one or more text files of disassembly
         result = generateFromText(parsedData,
                                   printRegistersOnly,
-                                  skipInstructionCombining);
+                                  skipInstructionCombining,
+                                  skipSelfCheck);
         if(!result)
         {
             return result;
@@ -260,7 +302,8 @@ int readFilenamesFromDirectory(PARSED_DATA& parsedData,
 // Generate one or more .sla files from the supplied text disassembly files
 int generateFromText(PARSED_DATA& parsedData,
                      bool printRegistersOnly,
-                     bool skipInstructionCombining)
+                     bool skipInstructionCombining,
+                     bool skipSelfCheck)
 {
     int result = 0;
 
@@ -299,6 +342,13 @@ int generateFromText(PARSED_DATA& parsedData,
         cout << "[*] Computing attach registers" << endl;
         computeAttachVariables(parsedData);
 
+        // only reports problems, the .slaspec is generated either way
+        if(skipSelfCheck == false)
+        {
+            cout << "[*] Self checking combined instructions" << endl;
+            selfCheckInstructions(parsedData, i);
+        }
+
         cout << "[*] Computing token instructions" << endl;
         computeTokenInstructions(parsedData);
 
@@ -344,27 +394,21 @@ int generateFromSleigh(PARSED_DATA& parsedData,
 {
     int result = 0;
 
-    for(unsigned int i = 0; i < parsedData.inputFilenames.size(); i++)
+    //
+    // read the input files and parse the instructions into parsedData
+    //
+    for(auto& inputFilename: parsedData.inputFilenames)
     {
-        //
-        // read the input file and parse the instructions into parsedData
-        //
-        cout << "[*] Parsing instructions: " << parsedData.inputFilenames[i] << endl;
-
-        result = parseInstructionsSla(parsedData, i);
-        if(result != 0)
-        {
-            cout << "[-] Failed to parse instructions" << endl;
-            goto ERROR_CLEANUP;
-        }
-        cout << "[*] Parsed " << parsedData.combinedInstructions.size() << " instructions" << endl;
+        cout << "[*] Parsing instructions: " << inputFilename << endl;
+    }
 
-        // only print registers and exit if option is set
-        if(printRegistersOnly)
-        {
-            continue;
-        }
+    result = parseInstructionsSlaFiles(parsedData);
+    if(result != 0)
+    {
+        cout << "[-] Failed to parse instructions" << endl;
+        goto ERROR_CLEANUP;
     }
+    cout << "[*] Parsed " << parsedData.combinedInstructions.size() << " instructions" << endl;
 
     // only print registers and exit if option is set
     if(printRegistersOnly)
@@ -379,8 +423,9 @@ int generateFromSleigh(PARSED_DATA& parsedData,
     // combine the instructions and process data for output
     //
 
-    // skip combining if option is set
-    if(skipInstructionCombining == false)
+    // skip combining if option is set. The tree merge already combined the
+    // instructions while parsing
+    if(skipInstructionCombining == false && parsedData.treeMerge == false)
     {
         cout << "[*] Combining instructions" << endl;
         combineInstructions(parsedData);
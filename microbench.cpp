@@ -0,0 +1,591 @@
+//-----------------------------------------------------------------------------
+// File: microbench.cpp
+//
+// Microbenchmarks for the hot kernels of the generator. Each kernel runs on
+// fixed inputs and reports ns/op and allocations/op so changes to a single
+// function can be measured without running the whole pipeline
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#include <boost/timer/timer.hpp>
+#include "combine.h"
+#include "output.h"
+#include "parser.h"
+using namespace std;
+
+// version of the microbenchmark output format. Bump this whenever the columns
+// change so results from different releases aren't diffed blindly
+#define MICROBENCH_FORMAT_VERSION 1
+
+// counts every call to operator new made by the process
+static boost::atomic<unsigned long long> g_allocations(0);
+static boost::atomic<unsigned long long> g_allocatedBytes(0);
+
+// results of the kernels are summed into here so the compiler can't throw
+// the work away
+static volatile unsigned long long g_sink = 0;
+
+// fixed inputs shared by all kernels. Built once before any kernel runs
+typedef struct _MICROBENCH_CONTEXT
+{
+    // SH-2 style disassembly lines
+    vector<string> lines;
+
+    // hex opcodes of 8, 16, 24 and 32 bits
+    vector<string> hexOpcodes;
+
+    // mix of registers, immediates and mnemonics
+    vector<string> tokens;
+
+    // pairs of instructions one bit apart
+    vector<pair<Instruction*, Instruction*>> combinePairs;
+
+    // "mov rM,rN" and "add #imm,rN" before combining
+    PARSED_DATA neighborhood;
+    string neighborhoodBitString;
+    Instruction* neighborhoodInstruction;
+
+    // the same neighborhood after combining, attach variables and tokens
+    PARSED_DATA combined;
+
+    // zeroized constructor bit patterns taken from the .sla file
+    PARSED_DATA sla;
+    vector<string> slaBitPatterns;
+} MICROBENCH_CONTEXT, *PMICROBENCH_CONTEXT;
+
+// a single kernel. run() does iterations operations
+typedef struct _MICROBENCH
+{
+    const char* name;
+    void (*run)(MICROBENCH_CONTEXT& context, unsigned long long iterations);
+} MICROBENCH, *PMICROBENCH;
+
+static Instruction* createInstruction(const string& line);
+static int createNeighborhood(PARSED_DATA& parsedData);
+static int initMicrobenchContext(MICROBENCH_CONTEXT& context,
+                                 const string& slaFilename);
+static void freeMicrobenchContext(MICROBENCH_CONTEXT& context);
+static void benchSplitDisassemblyLine(MICROBENCH_CONTEXT& context,
+                                      unsigned long long iterations);
+static void benchSetOpcode(MICROBENCH_CONTEXT& context,
+                           unsigned long long iterations);
+static void benchIsRegister(MICROBENCH_CONTEXT& context,
+                            unsigned long long iterations);
+static void benchAreInstructionsCombinable(MICROBENCH_CONTEXT& context,
+                                           unsigned long long iterations);
+static void benchCombineInstructionsWorker(MICROBENCH_CONTEXT& context,
+                                           unsigned long long iterations);
+static void benchGetConstructorIdByBitPattern(MICROBENCH_CONTEXT& context,
+                                              unsigned long long iterations);
+static void benchGetConstructorTextByBitPattern(MICROBENCH_CONTEXT& context,
+                                                unsigned long long iterations);
+static void benchGetOutputInstruction(MICROBENCH_CONTEXT& context,
+                                      unsigned long long iterations);
+
+static MICROBENCH g_microbenchmarks[] = {
+    {"splitDisassemblyLine", benchSplitDisassemblyLine},
+    {"setOpcode", benchSetOpcode},
+    {"isRegister", benchIsRegister},
+    {"areInstructionsCombinable", benchAreInstructionsCombinable},
+    {"combineInstructionsWorker", benchCombineInstructionsWorker},
+    {"getConstructorIdByBitPattern", benchGetConstructorIdByBitPattern},
+    {"getConstructorTextByBitPattern", benchGetConstructorTextByBitPattern},
+    {"getOutputInstruction", benchGetOutputInstruction},
+};
+
+//
+// allocation counting. Replaces the global operator new/delete for this
+// binary only
+//
+void* operator new(size_t size)
+{
+    void* p = NULL;
+
+    g_allocations.fetch_add(1, boost::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, boost::memory_order_relaxed);
+
+    p = malloc(size ? size : 1);
+    if(p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char *argv[])
+{
+    boost::program_options::options_description desc{"Ghidra Processor Module Generator Microbenchmarks"};
+    boost::program_options::variables_map args;
+    MICROBENCH_CONTEXT context;
+    std::streambuf* coutBuffer = NULL;
+    vector<string> kernels;
+    string slaFilename;
+    double minSeconds = 0;
+    int result = 0;
+
+    try
+    {
+        desc.add_options()
+            ("kernel,k", boost::program_options::value<vector<string>>(&kernels)->multitoken(), "Kernels to run. Defaults to all of them")
+            ("sla,s", boost::program_options::value<string>(&slaFilename)->default_value("examples/sh2.sla"), "The .sla file used by the getConstructor* kernels. Defaults to examples/sh2.sla")
+            ("min-time,m", boost::program_options::value<double>(&minSeconds)->default_value(0.5), "Minimum number of seconds to run each kernel for. Defaults to 0.5")
+            ("list,l", "List the available kernels")
+            ("help,h", "Help screen");
+
+        store(boost::program_options::parse_command_line(argc, argv, desc), args);
+        notify(args);
+
+        if(args.count("help"))
+        {
+            cout << desc << endl;
+            return 0;
+        }
+
+        if(args.count("list"))
+        {
+            for(auto& microbench: g_microbenchmarks)
+            {
+                cout << microbench.name << endl;
+            }
+            return 0;
+        }
+
+        if(minSeconds <= 0)
+        {
+            cout << "Invalid minimum time specified" << endl;
+            return -1;
+        }
+    }
+    catch (const boost::program_options::error &ex)
+    {
+        cout << "[-] Error parsing command line: " << ex.what() << endl;
+        return -1;
+    }
+
+    for(auto& kernel: kernels)
+    {
+        bool found = false;
+
+        for(auto& microbench: g_microbenchmarks)
+        {
+            if(kernel == microbench.name)
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if(found == false)
+        {
+            cout << "[-] Unknown kernel " << kernel << endl;
+            return -1;
+        }
+    }
+
+    initRegisters();
+
+    // the pipeline functions used to build the inputs print progress and
+    // timers, silence them
+    coutBuffer = cout.rdbuf(NULL);
+    result = initMicrobenchContext(context, slaFilename);
+    cout.rdbuf(coutBuffer);
+
+    if(result != 0)
+    {
+        cout << "[-] Failed to create the microbenchmark inputs" << endl;
+        freeMicrobenchContext(context);
+        return result;
+    }
+
+    cout << "# generator-microbench format " << MICROBENCH_FORMAT_VERSION << endl;
+    cout << "# kernel\titerations\tns_per_op\tallocs_per_op\tbytes_per_op" << endl;
+
+    for(auto& microbench: g_microbenchmarks)
+    {
+        unsigned long long iterations = 1;
+        unsigned long long allocations = 0;
+        unsigned long long allocatedBytes = 0;
+        double wallNs = 0;
+
+        if(kernels.size() > 0 &&
+           std::find(kernels.begin(), kernels.end(), microbench.name) == kernels.end())
+        {
+            continue;
+        }
+
+        // warm up caches and any lazily built state
+        microbench.run(context, 1);
+
+        // double the iteration count until the kernel runs long enough to
+        // give a stable ns/op
+        while(true)
+        {
+            boost::timer::cpu_timer timer;
+            unsigned long long startAllocations = g_allocations.load();
+            unsigned long long startAllocatedBytes = g_allocatedBytes.load();
+
+            timer.start();
+            microbench.run(context, iterations);
+            timer.stop();
+
+            allocations = g_allocations.load() - startAllocations;
+            allocatedBytes = g_allocatedBytes.load() - startAllocatedBytes;
+            wallNs = timer.elapsed().wall;
+
+            if(wallNs >= minSeconds * 1e9)
+            {
+                break;
+            }
+
+            iterations *= 2;
+        }
+
+        cout << microbench.name << "\t";
+        cout << iterations << "\t";
+        cout << std::fixed << std::setprecision(1) << wallNs / iterations << "\t";
+        cout << std::setprecision(2) << (double)allocations / iterations << "\t";
+        cout << std::setprecision(1) << (double)allocatedBytes / iterations << endl;
+    }
+
+    coutBuffer = cout.rdbuf(NULL);
+    freeMicrobenchContext(context);
+    cout.rdbuf(coutBuffer);
+
+    return 0;
+}
+
+// Parses a single line of disassembly into a new Instruction the same way
+// parseInstructionsParser() does. Returns NULL on failure
+static Instruction* createInstruction(const string& line)
+{
+    Instruction* instruction = NULL;
+    vector<string> lineSplit;
+
+    splitDisassemblyLine(lineSplit, line);
+    if(lineSplit.size() < 2 || !isOpcode(lineSplit[0]))
+    {
+        return NULL;
+    }
+
+    instruction = new Instruction();
+    instruction->setOpcode(lineSplit[0]);
+
+    for(unsigned int i = 1; i < lineSplit.size(); i++)
+    {
+        InstructionComponentType currType;
+
+        if(isRegister(lineSplit[i]))
+        {
+            currType = TYPE_REGISTER;
+        }
+        else if(isImmediate(lineSplit[i]))
+        {
+            currType = TYPE_IMMEDIATE;
+        }
+        else
+        {
+            currType = TYPE_INSTRUCTION;
+        }
+
+        instruction->addComponent(currType, lineSplit[i]);
+    }
+
+    return instruction;
+}
+
+// Fills parsedData with a small fixed 16-bit neighborhood:
+// 0x6NM3 mov rM,rN
+// 0x7NII add #0xII,rN
+static int createNeighborhood(PARSED_DATA& parsedData)
+{
+    parsedData.maxOpcodeBits = 16;
+    parsedData.variableLengthISA = false;
+    parsedData.numThreads = 1;
+
+    for(unsigned int n = 0; n < 16; n++)
+    {
+        for(unsigned int m = 0; m < 16; m++)
+        {
+            string line = str(boost::format("0x6%x%x3 mov r%u,r%u") % n % m % m % n);
+            Instruction* instruction = createInstruction(line);
+
+            if(instruction == NULL)
+            {
+                return -1;
+            }
+
+            parsedData.allInstructions[instruction->getOpcode()] = instruction;
+        }
+
+        for(unsigned int imm = 0; imm < 256; imm++)
+        {
+            string line = str(boost::format("0x7%x%02x add #0x%x,r%u") % n % imm % imm % n);
+            Instruction* instruction = createInstruction(line);
+
+            if(instruction == NULL)
+            {
+                return -1;
+            }
+
+            parsedData.allInstructions[instruction->getOpcode()] = instruction;
+        }
+    }
+
+    parsedData.combinedInstructions = parsedData.allInstructions;
+    return 0;
+}
+
+// builds the fixed inputs for all kernels
+static int initMicrobenchContext(MICROBENCH_CONTEXT& context,
+                                 const string& slaFilename)
+{
+    unsigned int count = 0;
+    int result = 0;
+
+    context.lines = {"0x6103 mov r0,r1",
+                     "0x6f52 mov.l @r5,r15",
+                     "0x0e1c mov.b @(r0,r1),r14",
+                     "0x85f3 mov.w @(0x6,r15),r0",
+                     "0xc4f0 mov.b @(0xf0,gbr),r0",
+                     "0x73ff add #-0x1,r3",
+                     "0x4f22 sts.l pr,@-r15",
+                     "0x000b rts"};
+
+    context.hexOpcodes = {"0x6f", "0x6103", "0x1a2b3c", "0xdeadbeef"};
+
+    context.tokens = {"r0", "r15", "mov.l", "#", "0x10", "gbr", "@", "sts.l", "pr", "add"};
+
+    //
+    // instructions for the combining kernels
+    //
+    result = createNeighborhood(context.neighborhood);
+    if(result != 0)
+    {
+        return result;
+    }
+
+    // register difference, immediate difference, duplicate
+    for(auto& opcodes: vector<pair<string, string>>{{"0110000000000011", "0110000000010011"},
+                                                     {"0111000000000000", "0111000000000001"},
+                                                     {"0110000100000011", "0110000100000011"}})
+    {
+        context.combinePairs.push_back({context.neighborhood.allInstructions[opcodes.first],
+                                        context.neighborhood.allInstructions[opcodes.second]});
+    }
+
+    context.neighborhoodBitString = "0110000000000011";
+    context.neighborhoodInstruction = context.neighborhood.combinedInstructions[context.neighborhoodBitString];
+
+    //
+    // instructions for the output kernel
+    //
+    result = createNeighborhood(context.combined);
+    if(result != 0)
+    {
+        return result;
+    }
+
+    combineInstructions(context.combined);
+    computeAttachVariables(context.combined);
+    computeTokenInstructions(context.combined);
+
+    //
+    // bit patterns for the .sla lookup kernel. Take a spread of constructors
+    // from the start, middle and end of the constructor list
+    //
+    context.sla.slas.emplace_back();
+    result = context.sla.slas[0].loadSla(slaFilename);
+    if(result != 0)
+    {
+        return result;
+    }
+
+    result = context.sla.slas[0].getConstructorCount(count);
+    if(result != 0 || count == 0)
+    {
+        return -1;
+    }
+
+    for(unsigned int i = 0; i < 8; i++)
+    {
+        string bitPattern;
+
+        result = context.sla.slas[0].getConstructorBitPattern((count - 1) * i / 7, bitPattern);
+        if(result != 0)
+        {
+            return result;
+        }
+
+        for(auto& ch: bitPattern)
+        {
+            if(ch != '0' && ch != '1')
+            {
+                ch = '0';
+            }
+        }
+
+        context.slaBitPatterns.push_back(bitPattern);
+    }
+
+    return 0;
+}
+
+static void freeMicrobenchContext(MICROBENCH_CONTEXT& context)
+{
+    clearParserData(context.neighborhood, false);
+    clearParserData(context.combined, false);
+}
+
+static void benchSplitDisassemblyLine(MICROBENCH_CONTEXT& context,
+                                      unsigned long long iterations)
+{
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        // a new vector per line, the same as parseInstructionsParser()
+        vector<string> lineSplit;
+
+        splitDisassemblyLine(lineSplit, context.lines[i % context.lines.size()]);
+        g_sink += lineSplit.size();
+    }
+}
+
+// setOpcode() appends to the opcode, so every op uses a fresh Instruction the
+// same as parseInstructionsParser()
+static void benchSetOpcode(MICROBENCH_CONTEXT& context,
+                           unsigned long long iterations)
+{
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        Instruction instruction;
+
+        instruction.setOpcode(context.hexOpcodes[i % context.hexOpcodes.size()]);
+        g_sink += instruction.getOpcode().length();
+    }
+}
+
+static void benchIsRegister(MICROBENCH_CONTEXT& context,
+                            unsigned long long iterations)
+{
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        g_sink += isRegister(context.tokens[i % context.tokens.size()]);
+    }
+}
+
+static void benchAreInstructionsCombinable(MICROBENCH_CONTEXT& context,
+                                           unsigned long long iterations)
+{
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        pair<Instruction*, Instruction*>& combinePair = context.combinePairs[i % context.combinePairs.size()];
+        char replacementChar = '\0';
+        int differencePosition = -1;
+
+        g_sink += areInstructionsCombinable(*combinePair.first,
+                                            *combinePair.second,
+                                            replacementChar,
+                                            differencePosition);
+    }
+}
+
+// one op is a single worker call plus freeing the candidate it created
+static void benchCombineInstructionsWorker(MICROBENCH_CONTEXT& context,
+                                           unsigned long long iterations)
+{
+    set<INSTRUCTION_COMBINE, decltype(compareInstructionCombine)*> combinedInstructions(compareInstructionCombine);
+    unordered_map<string, unsigned int> visitedInstructions;
+
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        combineInstructionsWorker(context.neighborhood,
+                                  context.neighborhoodBitString,
+                                  context.neighborhoodInstruction,
+                                  combinedInstructions,
+                                  visitedInstructions);
+
+        g_sink += combinedInstructions.size();
+
+        for(auto& combine: combinedInstructions)
+        {
+            delete combine.instruction;
+        }
+        combinedInstructions.clear();
+        visitedInstructions.clear();
+    }
+}
+
+static void benchGetConstructorIdByBitPattern(MICROBENCH_CONTEXT& context,
+                                              unsigned long long iterations)
+{
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        unsigned int id = 0;
+
+        context.sla.slas[0].getConstructorIdByBitPattern(context.slaBitPatterns[i % context.slaBitPatterns.size()], id);
+        g_sink += id;
+    }
+}
+
+static void benchGetConstructorTextByBitPattern(MICROBENCH_CONTEXT& context,
+                                                unsigned long long iterations)
+{
+    string constructorText;
+
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        context.sla.slas[0].getConstructorTextByBitPattern(context.slaBitPatterns[i % context.slaBitPatterns.size()], constructorText);
+        g_sink += constructorText.length();
+    }
+}
+
+static void benchGetOutputInstruction(MICROBENCH_CONTEXT& context,
+                                      unsigned long long iterations)
+{
+    map<string, Instruction*>::iterator itr = context.combined.combinedInstructions.begin();
+
+    for(unsigned long long i = 0; i < iterations; i++)
+    {
+        if(itr == context.combined.combinedInstructions.end())
+        {
+            itr = context.combined.combinedInstructions.begin();
+        }
+
+        g_sink += getOutputInstruction(itr->second).length();
+        itr++;
+    }
+}
@@ -8,7 +8,12 @@
 //-----------------------------------------------------------------------------
 
 #include <boost/timer/timer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/bind/bind.hpp>
+#include "factor.h"
 #include "output.h"
+#include "thread_pool.h"
 
 #include <boost/filesystem.hpp>
 
@@ -238,15 +243,36 @@ int createSlaspec(PARSED_DATA& parsedData, unsigned int fileId)
     ofs << "# ex. @define MY_FLAG\t\"my_reg[0,1]\"\n";
     ofs << "\n";
 
-    // define token registers
-    for(unsigned int i = 0; i < sizeof(parsedData.tokenInstructions)/sizeof(parsedData.tokenInstructions[0]); i++)
+    // instructions sorted by the text of the instruction itself not the opcode.
+    // Rendered before the token sections, factoring them adds opcode fields
+    vector<OUTPUT_INSTRUCTION> sortedCombinedInstructions;
+    string subtables;
+    int result = 0;
+
+    result = renderOutputInstructions(parsedData, sortedCombinedInstructions);
+    if(result != 0)
     {
-        unsigned int opcodeBitSize = 0;
+        ofs.close();
+        return result;
+    }
 
-        if(parsedData.tokenInstructions[i].size() > 0)
+    if(parsedData.factorSubtables)
+    {
+        result = factorSubtables(parsedData, sortedCombinedInstructions, subtables);
+        if(result != 0)
         {
-            opcodeBitSize = (i + 1) * 8;
+            ofs.close();
+            return result;
+        }
+    }
+
+    // define token registers
+    for(unsigned int i = 0; i < 4; i++)
+    {
+        unsigned int opcodeBitSize = (i + 1) * 8;
 
+        if(parsedData.tokenFields.hasWidth(opcodeBitSize))
+        {
             ofs << "# TODO: Simplify these where possible\n";
             ofs << "# TODO: Combine signed immediates where it makes sense\n";
             ofs << "define token instr" << opcodeBitSize;
@@ -254,7 +280,7 @@ int createSlaspec(PARSED_DATA& parsedData, unsigned int fileId)
             // TODO: make if statement here for VLA
 
             ofs << "(" << opcodeBitSize << ")\n";
-            ofs << getOutputTokenInstructions(parsedData.tokenInstructions[i]);
+            ofs << parsedData.tokenFields.render(opcodeBitSize);
             ofs << ";\n";
             ofs << "\n";
         }
@@ -289,6 +315,20 @@ int createSlaspec(PARSED_DATA& parsedData, unsigned int fileId)
         ofs << "\n";
     }   
 
+    // subtables of the factored operands, defined before the instructions
+    // referencing them
+    if(subtables.length() > 0)
+    {
+        boost::replace_all(subtables, "/", "_");
+
+        ofs << "#\n";
+        ofs << "# Subtables\n";
+        ofs << "#\n";
+        ofs << "# Operand forms shared by several instructions, see --factor-subtables\n";
+        ofs << "#\n\n";
+        ofs << subtables;
+    }
+
     //
     // Instructions
     //
@@ -313,49 +353,255 @@ int createSlaspec(PARSED_DATA& parsedData, unsigned int fileId)
     ofs << "# Line four is the empty p-code implementation which must be completed for decompiler support\n";
     ofs << "#\n\n";
 
-    // sorted instructions
-    // string = the text of the instruction itself not the opcode
-    map<string, Instruction*> sortedCombinedInstructions;
+    //
+    // render the instruction blocks in parallel, a buffer per portion of the
+    // sorted instructions, and write the buffers out in order
+    //
+    {
+        size_t numInstructions = sortedCombinedInstructions.size();
+        size_t portionSize = numInstructions / parsedData.numThreads + 1;
+        vector<string> outputs(parsedData.numThreads);
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
+
+        for(unsigned int i = 0; i < parsedData.numThreads; i++)
+        {
+            size_t start = min(i * portionSize, numInstructions);
+            size_t end = min(start + portionSize, numInstructions);
+
+            boost::asio::post(threadPool,
+                              boost::bind(renderInstructionBlocksWorker,
+                                          boost::ref(parsedData),
+                                          boost::ref(sortedCombinedInstructions),
+                                          start,
+                                          end,
+                                          boost::ref(outputs[i])));
+        }
+
+        threadPool.join();
+
+        for(auto& output: outputs)
+        {
+            ofs.write(output.data(), output.size());
+        }
+    }
+
+    ofs.close();
+    return 0;
+}
+
+// Renders every combined instruction with getOutputInstruction() on
+// parsedData.numThreads threads and sorts them by the rendered text.
+// Instructions that render the same are only emitted once, the first one in
+// combinedInstructions is kept
+int renderOutputInstructions(PARSED_DATA& parsedData, vector<OUTPUT_INSTRUCTION>& instructions)
+{
+    size_t numInstructions = parsedData.combinedInstructions.size();
+    size_t portionSize = numInstructions / parsedData.numThreads + 1;
+    unsigned int order = 0;
+
+    instructions.resize(numInstructions);
+    for(auto& combinedInstruction: parsedData.combinedInstructions)
+    {
+        instructions[order].order = order;
+        instructions[order].instruction = combinedInstruction.second;
+        order++;
+    }
 
-    // sort the instructions
-    for(auto combinedInstruction: parsedData.combinedInstructions )
+    resetThreadPool();
     {
-        string instructionString;
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
 
-        // combinedInstruction.first = the opcode
-        // combinedInstruction.second = pointer to the Instruction
-        instructionString = getOutputInstruction(combinedInstruction.second,
-                                                 parsedData);
-        sortedCombinedInstructions.insert({{instructionString,
-                                            combinedInstruction.second}});
+        for(unsigned int i = 0; i < parsedData.numThreads; i++)
+        {
+            size_t start = min(i * portionSize, numInstructions);
+            size_t end = min(start + portionSize, numInstructions);
+
+            boost::asio::post(threadPool,
+                              boost::bind(renderOutputInstructionsWorker,
+                                          boost::ref(instructions),
+                                          start,
+                                          end));
+        }
+
+        threadPool.join();
     }
 
-    for(auto sortedCombinedInstruction: sortedCombinedInstructions)
+    if(getWorkerFailures() > 0)
     {
-        string instruction = sortedCombinedInstruction.first;
+        cout << "  [-] Failed to render instructions!!" << endl;
+        return -1;
+    }
 
-        // escape forward slash
-        boost::replace_all(instruction, "/", "_");
+    sortOutputInstructions(instructions, parsedData.numThreads);
+
+    // duplicates are next to each other, the first in combinedInstructions
+    // sorts first
+    instructions.erase(std::unique(instructions.begin(),
+                                   instructions.end(),
+                                   [](const OUTPUT_INSTRUCTION& left, const OUTPUT_INSTRUCTION& right)
+                                   {
+                                       return left.text == right.text;
+                                   }),
+                       instructions.end());
 
-        if(parsedData.omitOpcodes == false)
+    return 0;
+}
+
+// thread pool worker, renders instructions [start, end)
+void renderOutputInstructionsWorker(vector<OUTPUT_INSTRUCTION>& instructions,
+                                    size_t start,
+                                    size_t end)
+{
+    try
+    {
+        for(size_t i = start; i < end; i++)
         {
-            ofs << "# " << sortedCombinedInstruction.second->getOpcode() << "\n";
+            instructions[i].text = getOutputInstruction(instructions[i].instruction);
         }
-        
-        if((parsedData.omitExampleInstructions == false) &&
-           (sortedCombinedInstruction.second->getCombined() == true))
+    }
+    catch(...)
+    {
+        incrementWorkerFailures();
+    }
+
+    incrementWorkerCompletions();
+}
+
+// orders instructions by text, then by position in combinedInstructions
+static bool compareOutputInstructions(const OUTPUT_INSTRUCTION& left, const OUTPUT_INSTRUCTION& right)
+{
+    int result = left.text.compare(right.text);
+
+    if(result != 0)
+    {
+        return result < 0;
+    }
+
+    return left.order < right.order;
+}
+
+// Sorts a portion of the instructions per thread, then merges neighboring
+// portions in parallel until a single sorted run is left
+void sortOutputInstructions(vector<OUTPUT_INSTRUCTION>& instructions, unsigned int numThreads)
+{
+    size_t numInstructions = instructions.size();
+    size_t portionSize = numInstructions / numThreads + 1;
+    vector<size_t> runs; // start of each sorted run, the last entry is the end
+
+    for(unsigned int i = 0; i < numThreads && i * portionSize < numInstructions; i++)
+    {
+        runs.push_back(i * portionSize);
+    }
+    runs.push_back(numInstructions);
+
+    // sort each portion, a middle equal to the end means sort instead of merge
+    {
+        boost::asio::thread_pool threadPool(numThreads);
+
+        for(size_t i = 0; i + 1 < runs.size(); i++)
         {
-            ofs << "# " << getOriginalOutputString(sortedCombinedInstruction.second, parsedData) << "\n";
-        }        
-        
-        ofs << instruction << "\n";
-        ofs << "{}\n";
-        ofs << "\n";
+            boost::asio::post(threadPool,
+                              boost::bind(sortOutputInstructionsWorker,
+                                          boost::ref(instructions),
+                                          runs[i],
+                                          runs[i + 1],
+                                          runs[i + 1]));
+        }
+
+        threadPool.join();
     }
-    sortedCombinedInstructions.clear();
 
-    ofs.close();
-    return 0;
+    // merge pairs of runs, level by level
+    while(runs.size() > 2)
+    {
+        boost::asio::thread_pool threadPool(numThreads);
+        vector<size_t> mergedRuns;
+
+        for(size_t i = 0; i + 1 < runs.size(); i += 2)
+        {
+            mergedRuns.push_back(runs[i]);
+
+            if(i + 2 < runs.size())
+            {
+                boost::asio::post(threadPool,
+                                  boost::bind(sortOutputInstructionsWorker,
+                                              boost::ref(instructions),
+                                              runs[i],
+                                              runs[i + 1],
+                                              runs[i + 2]));
+            }
+        }
+        mergedRuns.push_back(numInstructions);
+
+        threadPool.join();
+        runs = mergedRuns;
+    }
+}
+
+// thread pool worker, sorts [start, end) if middle is end, otherwise merges
+// the sorted runs [start, middle) and [middle, end)
+void sortOutputInstructionsWorker(vector<OUTPUT_INSTRUCTION>& instructions,
+                                  size_t start,
+                                  size_t middle,
+                                  size_t end)
+{
+    if(middle == end)
+    {
+        std::sort(instructions.begin() + start,
+                  instructions.begin() + end,
+                  compareOutputInstructions);
+        return;
+    }
+
+    std::inplace_merge(instructions.begin() + start,
+                       instructions.begin() + middle,
+                       instructions.begin() + end,
+                       compareOutputInstructions);
+}
+
+// thread pool worker, renders the .slaspec text of the sorted instructions
+// [start, end) into output
+void renderInstructionBlocksWorker(PARSED_DATA& parsedData,
+                                   vector<OUTPUT_INSTRUCTION>& instructions,
+                                   size_t start,
+                                   size_t end,
+                                   string& output)
+{
+    for(size_t i = start; i < end; i++)
+    {
+        string instruction = instructions[i].text;
+
+        // escape forward slash
+        boost::replace_all(instruction, "/", "_");
+
+        // a factored root constructor lists each instruction it replaces
+        vector<Instruction*>& factoredInstructions = instructions[i].factoredInstructions;
+        size_t numComments = max(factoredInstructions.size(), (size_t)1);
+
+        for(size_t j = 0; j < numComments; j++)
+        {
+            Instruction* commentInstruction = instructions[i].instruction;
+
+            if(factoredInstructions.size() > 0)
+            {
+                commentInstruction = factoredInstructions[j];
+            }
+            if(parsedData.omitOpcodes == false)
+            {
+                output += "# " + commentInstruction->getOpcode() + "\n";
+            }
+
+            if((parsedData.omitExampleInstructions == false) &&
+               (commentInstruction->getCombined() == true))
+            {
+                output += "# " + getOriginalOutputString(commentInstruction, parsedData) + "\n";
+            }
+        }
+
+        output += instruction + "\n";
+        output += "{}\n";
+        output += "\n";
+    }
 }
 
 // Gets a list of all registers define register section of the processor module
@@ -403,52 +649,6 @@ string getOutputMnemonics(PARSED_DATA& parsedData)
     return output;
 }
 
-// Outputs a list of the define token instructions for the processor module
-// ex:
-//	imm_00_00 = (0, 0)
-//	simm_00_00 = (0, 0) signed
-//	imm_00_03 = (0, 3)
-//	opcode_00_03 = (0, 3)
-//  opcode_00_04 = (0, 4)
-//  regA_04_07 = (4, 7)
-//	regA_05_05 = (5, 5)
-//	regA_05_05_2 = (5, 5)
-string getOutputTokenInstructions(set<string>& tokenInstructions)
-{
-    string output = "";
-    std::set<Instruction*>::iterator it;
-
-    for (auto& token: tokenInstructions)
-    {
-        int start, end;
-        vector<string> result;
-
-        //cout << "token: " << token << endl;
-
-        boost::split(result, token, boost::is_any_of("_"));
-        if(result.size() < 3)
-        {
-            cout << "Failed to split token!!\n";
-            return "";
-        }
-
-        start = std::stoi(result[1]);
-        end = std::stoi(result[2]);
-
-        output += "\t" + token + " = (" + to_string(start) + ", " + to_string(end) + ")\n";
-
-        // if this was an immediate value, create a signed immediate as well
-        // we do this because we can't tell the difference between an unsigned
-        // immediate and a postive signed immediate
-        if(token.find("imm_") != string::npos)
-        {
-            output += "\ts" + token + " = (" + to_string(start) + ", " + to_string(end) + ") signed\n";
-        }
-    }
-
-    return output;
-}
-
 // Outputs the processor module's attached variables field
 // There can be multiple attach variables for a single processor module
 // ex: attach variables [ regA_05_05 regC_05_05_2 regE_05_05_2 ] [
@@ -508,7 +708,7 @@ string getOutputDuplicateRegisters(PARSED_DATA& parsedData)
 
 // Takes an instruction and converts into SLEIGH format
 // example: ":mov rm_04_07, rn_08_11 is opcode_12_15=0b0110 & rn_08_11 & rm_04_07 & opcode_00_03=0b0011"
-string getOutputInstruction(Instruction* instruction, PARSED_DATA& parsedData)
+string getOutputInstruction(Instruction* instruction)
 {
     string output;
     int index = 0;
@@ -527,7 +727,7 @@ string getOutputInstruction(Instruction* instruction, PARSED_DATA& parsedData)
         throw 1;
     }
 
-    output += instruction->getOpcodeOutputString(parsedData.tokenInstructions[index]);
+    output += instruction->getOpcodeOutputString();
 
     return output;
 }
@@ -568,10 +768,9 @@ int getOriginalOutputStringFromSla(PARSED_DATA& parsedData,
 {
     int result = 0;
 
-    // loop through all of the loaded .sla files attempting to disassemble
-    // zeroizedOpcode
-    // TODO: improve speed?
-    for(unsigned int i = 0; i < parsedData.slas.size(); i++)
+    // loop through the loaded .sla files that can match zeroizedOpcode
+    // attempting to disassemble it
+    for(auto i: parsedData.slaIndex.getCandidateSlas(zeroizedOpcode))
     {
         result = parsedData.slas[i].getConstructorTextByBitPattern(zeroizedOpcode,
                                                                    disassembledString);
@@ -11,6 +11,15 @@
 #include "parser.h"
 using namespace std;
 
+// a combined instruction rendered for the .slaspec
+typedef struct _OUTPUT_INSTRUCTION
+{
+    string text; // from getOutputInstruction(), the instructions are sorted by it
+    unsigned int order; // position in combinedInstructions, the first of duplicates is kept
+    Instruction* instruction;
+    vector<Instruction*> factoredInstructions; // instructions a factored root constructor replaces, see factorSubtables()
+} OUTPUT_INSTRUCTION, *POUTPUT_INSTRUCTION;
+
 int createProcessorModule(PARSED_DATA& parsedData, unsigned int fileId);
 int createDirectoryStructure(PARSED_DATA& parsedData);
 int createModuleManifest(PARSED_DATA& parsedData);
@@ -21,10 +30,23 @@ int createSlaspec(PARSED_DATA& parsedData, unsigned int fileId);
 
 string getOutputRegisters(PARSED_DATA& parsedData);
 string getOutputMnemonics(PARSED_DATA& parsedData);
-string getOutputTokenInstructions(set<string>& tokenInstructions);
 string getOutputAttachVariables(PARSED_DATA& parsedData);
 string getOutputDuplicateRegisters(PARSED_DATA& parsedData);
-string getOutputInstruction(Instruction* instruction, PARSED_DATA& parserData);
+string getOutputInstruction(Instruction* instruction);
+int renderOutputInstructions(PARSED_DATA& parsedData, vector<OUTPUT_INSTRUCTION>& instructions);
+void renderOutputInstructionsWorker(vector<OUTPUT_INSTRUCTION>& instructions,
+                                    size_t start,
+                                    size_t end);
+void sortOutputInstructions(vector<OUTPUT_INSTRUCTION>& instructions, unsigned int numThreads);
+void sortOutputInstructionsWorker(vector<OUTPUT_INSTRUCTION>& instructions,
+                                  size_t start,
+                                  size_t middle,
+                                  size_t end);
+void renderInstructionBlocksWorker(PARSED_DATA& parsedData,
+                                   vector<OUTPUT_INSTRUCTION>& instructions,
+                                   size_t start,
+                                   size_t end,
+                                   string& output);
 string getOriginalOutputString(Instruction* instruction,
                                PARSED_DATA& parsedData);
 int getOriginalOutputStringFromSla(PARSED_DATA& parsedData,
@@ -10,7 +10,6 @@
 #include <boost/asio/post.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/thread/thread.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
 #include "parser.h"
 #include "registers.h"
 #include "thread_pool.h"
@@ -26,7 +25,6 @@ extern const char* ALL_REGISTERS[];
 
 static bool splitChar(char ch);
 static bool isCharWhiteSpace(char ch);
-static int splitDisassemblyLine(vector<string>& lineSplit, const string& line);
 static void updateOpcodeSize(unsigned int opcodeSize);
 static bool hasVariableLengthOpcodes(void);
 
@@ -41,7 +39,7 @@ static int parseInstructionsParser(PARSED_DATA& parsedData,
                                    set<string>& mnemonics,
                                    map<string, Instruction*>& allInstructions);
 
-// helper to convert number of opcode bits to to index into tokenInstructions array
+// helper to convert number of opcode bits to an index, ex. 8 bits is 0 and 32 bits is 3
 int convertOpcodeSizeToIndex(unsigned int opcodeSizeInBits)
 {
     switch(opcodeSizeInBits)
@@ -320,7 +318,7 @@ static bool isCharWhiteSpace(char ch)
 }
 
 // splits a line of disassembly into a vector of strings
-static int splitDisassemblyLine(vector<string>& lineSplit, const string& line)
+int splitDisassemblyLine(vector<string>& lineSplit, const string& line)
 {
     string currSplit = "";
 
@@ -491,7 +489,6 @@ int parseInstructions(PARSED_DATA& parsedData, unsigned int fileId)
 {
     boost::timer::auto_cpu_timer t;
     boost::asio::thread_pool threadPool(parsedData.numThreads);
-    unsigned int portion = 0;
     unsigned long long fileSize = 0;
     char* fileBuffer = NULL;
     unsigned long long portionSize = 0;
@@ -577,32 +574,7 @@ int parseInstructions(PARSED_DATA& parsedData, unsigned int fileId)
         start = end + 1;
     }   
 
-    // TODO: improve poll logic
-    while(1)
-    {
-        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-
-        unsigned int completedCount = getWorkerCompletions();
-        unsigned int failCount = getWorkerFailures();
-
-        //cout << "Test cases: " << completed_count << "/" << lineNum  << " Fail cases: " << fail_count << endl;
-        
-        // check if we exceeded our max number of failures
-        if(failCount > 0)
-        {
-            // abort the rest of the threads         
-            threadPool.stop();
-            break;
-        }
-
-        // check if we finished our submitted jobs
-        if(completedCount >= portion)
-        {
-            // finished
-            break;
-        }
-    }
-
+    // wait for all workers to finish, failures are checked below
     threadPool.join();
 
     delete [] fileBuffer;
@@ -625,20 +597,57 @@ int parseInstructions(PARSED_DATA& parsedData, unsigned int fileId)
 // Walks through all instructions that have combined registers and figures out
 // the register list and register variable name and appends them to 
 // registerVariables. Once registerVariables is filled out attachVariables is 
-// filled out
-void  computeAttachVariables(PARSED_DATA& parsedData)
+// filled out. The register lists are generated on parsedData.numThreads
+// threads, the variables are named afterwards in combinedInstructions order
+void computeAttachVariables(PARSED_DATA& parsedData)
 {    
     boost::timer::auto_cpu_timer t;
-    std::set<Instruction*>::iterator it;
+    vector<Instruction*> instructions;
+    vector<vector<ATTACH_REGISTER_FIELD>> registerFields;
+    size_t numInstructions = parsedData.combinedInstructions.size();
+    size_t portionSize = numInstructions / parsedData.numThreads + 1;
 
-    // iterate through all combined instructions and update registerVariables
+    instructions.reserve(numInstructions);
     for(auto& x: parsedData.combinedInstructions)
     {
-        x.second->computeAttachVariables(parsedData.allInstructions,
-                                         parsedData.registerVariables,
-                                         parsedData.slas);
+        instructions.push_back(x.second);
+    }
+    registerFields.resize(numInstructions);
+
+    resetThreadPool();
+    {
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
+
+        for(unsigned int i = 0; i < parsedData.numThreads; i++)
+        {
+            size_t start = min(i * portionSize, numInstructions);
+            size_t end = min(start + portionSize, numInstructions);
+
+            boost::asio::post(threadPool,
+                              boost::bind(computeAttachVariablesWorker,
+                                          boost::ref(parsedData),
+                                          boost::ref(instructions),
+                                          boost::ref(registerFields),
+                                          start,
+                                          end));
+        }
+
+        threadPool.join();
+    }
+
+    if(getWorkerFailures() > 0)
+    {
+        cout << "[-] Failed to compute the attach variables!!" << endl;
+        throw 1;
     }
 
+    cout << "[*] Attach variables: " << parsedData.registerLists.getFieldLookups()
+         << " register fields, "
+         << parsedData.registerLists.getFieldLookups() - parsedData.registerLists.getFieldHits()
+         << " enumerated" << endl;
+
+    nameAttachVariables(parsedData, instructions, registerFields);
+
     for(auto& y: parsedData.registerVariables)
     {
         // y.second = string consisting all delimited by space
@@ -648,33 +657,188 @@ void  computeAttachVariables(PARSED_DATA& parsedData)
     return;
 }
 
-// TODO: wrong comment
-// Walks through all instructions that have combined registers and figures out
-// the register list and register variable name and appends them to 
-// registerVariables. Once registerVariables is filled out attachVariables is 
-// filled out.
+// worker that generates the register lists of instructions [start, end)
+void computeAttachVariablesWorker(PARSED_DATA& parsedData,
+                                  vector<Instruction*>& instructions,
+                                  vector<vector<ATTACH_REGISTER_FIELD>>& registerFields,
+                                  size_t start,
+                                  size_t end)
+{
+    try
+    {
+        for(size_t i = start; i < end; i++)
+        {
+            instructions[i]->computeAttachVariables(parsedData.allInstructions,
+                                                    parsedData.slas,
+                                                    parsedData.slaIndex,
+                                                    parsedData.registerLists,
+                                                    registerFields[i]);
+        }
+    }
+    catch(...)
+    {
+        incrementWorkerFailures();
+    }
+
+    incrementWorkerCompletions();
+}
+
+// Names the attach variable of each register field and fills out
+// registerVariables. We can't reuse the same name for different lists of
+// registers, so the number of the variable name is incremented on collisions.
+// The names depend on the fields named before, so this runs serially in
+// combinedInstructions order
+void nameAttachVariables(PARSED_DATA& parsedData,
+                         vector<Instruction*>& instructions,
+                         vector<vector<ATTACH_REGISTER_FIELD>>& registerFields)
+{
+    // key = register variable name, value = register list id
+    boost::unordered_map<string, unsigned int> names;
+
+    for(size_t i = 0; i < instructions.size(); i++)
+    {
+        for(auto& registerField: registerFields[i])
+        {
+            string registerName = registerField.name;
+
+            // TODO: move this to a function
+            bool inserted = false;
+            bool added = false;
+            int counter = 2;
+            while(inserted == false)
+            {
+                auto itr = names.find(registerName);
+                if(itr == names.end())
+                {
+                    names.insert({{registerName, registerField.listId}});
+                    inserted = true;
+                    added = true;
+                }
+                else
+                {
+                    if(registerField.listId == itr->second)
+                    {
+                        inserted = true;
+                    }
+                    else
+                    {   
+                        if(counter > 2 && counter < 10)
+                        {
+                            // TODO: what if counter is bigger than 10?
+                            registerName.resize(registerName.length() - 2);
+                        }
+                        else if(counter >= 10 && counter < 100)
+                        {
+                            registerName.resize(registerName.length() - 3);
+                        }
+                        else if(counter >= 100)
+                        {
+                            registerName.resize(registerName.length() - 4);
+                        }
+
+                        registerName = registerName + "_" + to_string(counter);
+                        counter++;
+                    }
+                }
+            }
+
+            instructions[i]->components[registerField.position].combinedComponent = registerName;
+
+            // each new variable is a register field of the "define token" section
+            if(added)
+            {
+                parsedData.tokenFields.addRegister(registerName,
+                                                   registerField.start,
+                                                   registerField.end,
+                                                   instructions[i]->getOpcode().length());
+            }
+        }
+    }
+
+    for(auto& name: names)
+    {
+        parsedData.registerVariables[name.first] = parsedData.registerLists.getText(name.second);
+    }
+}
+
+// Collects the opcode and immediate fields of all combined instructions for
+// the "define token" sections on parsedData.numThreads threads. The register
+// fields were added by computeAttachVariables() when their variables were
+// named
 void computeTokenInstructions(PARSED_DATA& parsedData)
 {    
     boost::timer::auto_cpu_timer t;
-    std::set<Instruction*>::iterator it;
+    vector<Instruction*> instructions;
+    vector<TOKEN_FIELD_KEYS> tokenFields(parsedData.numThreads);
+    size_t numInstructions = parsedData.combinedInstructions.size();
+    size_t portionSize = numInstructions / parsedData.numThreads + 1;
 
-    // iterate through all combined instructions. getOpcodeOutputString() will
-    // append new tokens to the tokenInstructions set
+    instructions.reserve(numInstructions);
     for(auto& x: parsedData.combinedInstructions)
     {
-        int index = convertOpcodeSizeToIndex(x.first.length());
-        if(index < 0)
+        instructions.push_back(x.second);
+    }
+
+    resetThreadPool();
+    {
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
+
+        for(unsigned int i = 0; i < parsedData.numThreads; i++)
         {
-            cout << "Invalid opcode size!!" << endl;
-            throw 1;
+            size_t start = min(i * portionSize, numInstructions);
+            size_t end = min(start + portionSize, numInstructions);
+
+            boost::asio::post(threadPool,
+                              boost::bind(computeTokenInstructionsWorker,
+                                          boost::ref(instructions),
+                                          start,
+                                          end,
+                                          boost::ref(tokenFields[i])));
         }
 
-        x.second->getOpcodeOutputString(parsedData.tokenInstructions[index]);
+        threadPool.join();
+    }
+
+    if(getWorkerFailures() > 0)
+    {
+        cout << "[-] Failed to compute the token fields!!" << endl;
+        throw 1;
+    }
+
+    for(auto& workerTokenFields: tokenFields)
+    {
+        parsedData.tokenFields.add(workerTokenFields);
     }
 
     return;
 }
 
+// worker that collects the token fields of instructions [start, end)
+void computeTokenInstructionsWorker(vector<Instruction*>& instructions,
+                                    size_t start,
+                                    size_t end,
+                                    TOKEN_FIELD_KEYS& tokenFields)
+{
+    try
+    {
+        for(size_t i = start; i < end; i++)
+        {
+            if(convertOpcodeSizeToIndex(instructions[i]->getOpcode().length()) < 0 ||
+               instructions[i]->getTokenFields(tokenFields) != 0)
+            {
+                incrementWorkerFailures();
+                break;
+            }
+        }
+    }
+    catch(...)
+    {
+        incrementWorkerFailures();
+    }
+
+    incrementWorkerCompletions();
+}
+
 // worker that deletes the instruction from parsedData.allinstructions
 int clearParserWorker(PARSED_DATA& parsedData, 
                       unsigned long long start,
@@ -702,7 +866,6 @@ int clearParserWorker(PARSED_DATA& parsedData,
 int clearParserScheduler(PARSED_DATA& parsedData)
 {
     boost::asio::thread_pool threadPool(parsedData.numThreads);
-    unsigned int portion = 0;
     unsigned long long numInstructions = 0;
     unsigned long long portionSize = 0;
     unsigned long long start = 0;
@@ -751,23 +914,9 @@ int clearParserScheduler(PARSED_DATA& parsedData)
                                       start,
                                       end));
         start = end + 1;
-        portion++;
-    }
-
-    // TODO: improve poll logic
-    while(1)
-    {
-        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-        unsigned int completedCount = getWorkerCompletions();
-
-        // check if we finished our submitted jobs
-        if(completedCount >= portion)
-        {
-            // finished
-            break;
-        }
     }
 
+    // wait for threads
     threadPool.join();
     return 0;
 }
@@ -799,11 +948,8 @@ void clearParserData(PARSED_DATA& parsedData, bool save_registers)
     parsedData.combinedInstructions.clear();
     parsedData.registerVariables.clear();
     parsedData.attachVariables.clear();
-
-    for(unsigned int i = 0; i < sizeof(parsedData.tokenInstructions)/sizeof(parsedData.tokenInstructions[0]); i++)
-    {
-        parsedData.tokenInstructions[i].clear();
-    }
+    parsedData.registerLists.clear();
+    parsedData.tokenFields.clear();
 
     if(!save_registers)
     {
@@ -91,13 +91,13 @@ typedef struct _PARSED_DATA
     // value = set of all register variable names that have the same list of registers. Ex "regA_10_10", "regC_10_10", "regE_10_10"
     map<string, set<string>> attachVariables;
 
-    // used for outputting the "define token instr pieces"
-    // to support variable length architectectures:
-    // - [0] - 1 byte instructions
-    // - [0] - 2 byte instructions
-    // - [0] - 3 byte instructions
-    // - [0] - 4 byte instructions
-    set<string> tokenInstructions[4];
+    // register lists of the register fields found by computeAttachVariables()
+    // registerVariables and attachVariables are built from
+    RegisterLists registerLists;
+
+    // used for outputting the "define token instr pieces", the fields of
+    // every opcode width to support variable length architectectures
+    TokenFields tokenFields;
 
     // used for outtputing the "duplicated registers" export section
     map<string, unsigned int> duplicatedRegisters;
@@ -114,6 +114,10 @@ typedef struct _PARSED_DATA
     // directives
     vector<Slautil> slas;
 
+    // which of the loaded .sla files can match an opcode. Kept in sync with
+    // slas by parseInstructionsSla()
+    SlaIndex slaIndex;
+
     // endianess of the instruction set. Can be either "little" or "big".
     // Needed in the output files
     string endianness;
@@ -138,10 +142,23 @@ typedef struct _PARSED_DATA
     // the outputted .sla file. useful for debugging
     bool omitExampleInstructions;
 
+    // factor operands shared by many instructions into subtables, see
+    // factorSubtables()
+    bool factorSubtables;
+
     // number of threads to use for each thread pool
     // defaults to number of physical CPUs by default
     unsigned int numThreads;
 
+    // load .sla files through their <filename>.cache sidecar, see
+    // Slautil::loadSlaCached()
+    bool useSlaCache;
+
+    // combine the .sla files of --input-sleigh-dir as a tree while they are
+    // merged instead of combining their union at once, see
+    // parseInstructionsSlaFiles()
+    bool treeMerge;
+
 } PARSED_DATA, *PPARSED_DATA;
 
 int initRegisters(void);
@@ -150,8 +167,21 @@ bool isOpcode(const string& str);
 bool isInteger(const string &str);
 bool isImmediate(const string& str);
 bool isRegister(const string& str);
+int splitDisassemblyLine(vector<string>& lineSplit, const string& line);
 int parseInstructions(PARSED_DATA& parsedData, unsigned int fileId);
 void computeAttachVariables(PARSED_DATA& parsedData);
+void computeAttachVariablesWorker(PARSED_DATA& parsedData,
+                                  vector<Instruction*>& instructions,
+                                  vector<vector<ATTACH_REGISTER_FIELD>>& registerFields,
+                                  size_t start,
+                                  size_t end);
+void nameAttachVariables(PARSED_DATA& parsedData,
+                         vector<Instruction*>& instructions,
+                         vector<vector<ATTACH_REGISTER_FIELD>>& registerFields);
 void computeTokenInstructions(PARSED_DATA& parsedData);
+void computeTokenInstructionsWorker(vector<Instruction*>& instructions,
+                                    size_t start,
+                                    size_t end,
+                                    TOKEN_FIELD_KEYS& tokenFields);
 void clearParserData(PARSED_DATA& parsedData, bool save_registers);
 int convertOpcodeSizeToIndex(unsigned int opcodeSizeInBits);
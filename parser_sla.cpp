@@ -6,47 +6,468 @@
 // Copyright (c) Oberoi Security Solutions. All rights reserved.
 // Licensed under the Apache 2.0 License.
 //-----------------------------------------------------------------------------
+#include <boost/timer/timer.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/thread/thread.hpp>
+#include <unordered_set>
 #include "slautil/slautil.h"
+#include "combine.h"
 #include "parser.h"
+#include "thread_pool.h"
+
+// everything parsed from a single .sla file. Each file is parsed into its own
+// SLA_FILE so the files can be worked on concurrently without locking
+typedef struct _SLA_FILE
+{
+    string filename;
+
+    Slautil slautil;
+
+    // registers defined by the .sla
+    vector<string> registers;
+
+    // registers referenced by the constructors
+    set<string> seenRegisters;
+
+    // instructions parsed from the .sla. Instruction* was allocated by new
+    map<string, Instruction*> instructions;
+
+    // instructions with an opcode already parsed from an earlier file. Filled
+    // out when the files are merged
+    map<string, Instruction*> duplicates;
+
+    // number of bits for the biggest instruction opcode parsed
+    unsigned int maxOpcodeBits;
+
+    // lowest opcode parsed from the .sla, before combining. Used to order the
+    // files by opcode prefix for the tree merge
+    string firstOpcode;
+
+    // set by the tree merge workers. They can't use the worker counters of
+    // thread_pool.h as the combine passes they run reset them
+    bool failed;
+} SLA_FILE, *PSLA_FILE;
+
+static int loadSlaFile(SLA_FILE& slaFile, bool useSlaCache);
+static int tokenizeSlaFile(SLA_FILE& slaFile);
+static void loadSlaFileWorker(SLA_FILE& slaFile, bool useSlaCache);
+static void tokenizeSlaFileWorker(SLA_FILE& slaFile);
+static void mergeSlaFilesWorker(SLA_FILE& slaFile, SLA_FILE& nextSlaFile);
+static int treeMergeSlaFiles(PARSED_DATA& parsedData, vector<SLA_FILE>& slaFiles);
+static void combineSlaFile(SLA_FILE& slaFile, unsigned int numThreads);
+static void tokenizeCombineSlaFileWorker(SLA_FILE& slaFile, unsigned int numThreads);
+static void mergeCombineSlaFilesWorker(SLA_FILE& slaFile,
+                                       SLA_FILE& nextSlaFile,
+                                       unsigned int numThreads);
+static int addSlaFile(PARSED_DATA& parsedData, SLA_FILE& slaFile);
+static void freeSlaFile(SLA_FILE& slaFile);
 
 // Tokenizes the input instructions from the .sla and appends them to the
 // allInstructions set
 int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId)
-{   
-    Slautil slautil;
-    vector<string> registers;
-    unsigned int count = 0;
+{
+    SLA_FILE slaFile;
     int result = 0;
 
-    result = slautil.loadSla(parsedData.inputFilenames[fileId]);
+    slaFile.filename = parsedData.inputFilenames[fileId];
+    slaFile.maxOpcodeBits = 0;
+
+    result = loadSlaFile(slaFile, parsedData.useSlaCache);
     if(result != 0)
     {
         return result;
     }
 
-    result = slautil.getConstructorCount(count);
+    addRegisters(slaFile.registers);
+
+    result = tokenizeSlaFile(slaFile);
     if(result != 0)
     {
-        cout << "Failed to get constructor count" << endl;
+        freeSlaFile(slaFile);
         return result;
     }
 
-    result = slautil.getRegisters(registers);
+    // check for opcodes parsed from earlier files before inserting
+    for(auto& x: slaFile.instructions)
+    {
+        if(parsedData.allInstructions.find(x.first) != parsedData.allInstructions.end())
+        {
+            cout << "[-] Error " << slaFile.filename << ": Found duplicate opcode!!" << endl;
+            freeSlaFile(slaFile);
+            return -1;
+        }
+    }
+
+    parsedData.allInstructions.merge(slaFile.instructions);
+
+    return addSlaFile(parsedData, slaFile);
+}
+
+// Tokenizes the instructions from all of the input .sla files. The files are
+// loaded and tokenized concurrently on the thread pool, each into its own
+// SLA_FILE, and then merged pairwise until a single set of instructions is
+// left. Instructions in earlier files take priority like parsing the files
+// one after another with parseInstructionsSla(). With parsedData.treeMerge
+// the instructions are also combined while merging, see treeMergeSlaFiles()
+int parseInstructionsSlaFiles(PARSED_DATA& parsedData)
+{
+    boost::timer::auto_cpu_timer t;
+    vector<SLA_FILE> slaFiles(parsedData.inputFilenames.size());
+    int result = 0;
+
+    // sanity check thread value
+    if(parsedData.numThreads == 0)
+    {
+        cout << "[-] numThreads cannot be 0" << endl;
+        return -1;
+    }
+
+    if(slaFiles.size() == 0)
+    {
+        return 0;
+    }
+
+    //
+    // load the .sla files
+    //
+    resetThreadPool();
+    {
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
+
+        for(unsigned int i = 0; i < slaFiles.size(); i++)
+        {
+            slaFiles[i].filename = parsedData.inputFilenames[i];
+            slaFiles[i].maxOpcodeBits = 0;
+            slaFiles[i].failed = false;
+
+            boost::asio::post(threadPool,
+                              boost::bind(loadSlaFileWorker,
+                                          boost::ref(slaFiles[i]),
+                                          parsedData.useSlaCache));
+        }
+
+        threadPool.join();
+    }
+
+    if(getWorkerFailures() > 0)
+    {
+        return -1;
+    }
+
+    // isRegister() has to know about the registers of every file before
+    // the constructors are tokenized
+    for(auto& slaFile: slaFiles)
+    {
+        addRegisters(slaFile.registers);
+    }
+
+    if(parsedData.treeMerge)
+    {
+        result = treeMergeSlaFiles(parsedData, slaFiles);
+        if(result != 0)
+        {
+            goto ERROR_EXIT;
+        }
+
+        goto ADD_SLA_FILES;
+    }
+
+    //
+    // tokenize the constructors of each .sla file
+    //
+    resetThreadPool();
+    {
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
+
+        for(auto& slaFile: slaFiles)
+        {
+            boost::asio::post(threadPool,
+                              boost::bind(tokenizeSlaFileWorker,
+                                          boost::ref(slaFile)));
+        }
+
+        threadPool.join();
+    }
+
+    if(getWorkerFailures() > 0)
+    {
+        result = -1;
+        goto ERROR_EXIT;
+    }
+
+    //
+    // merge neighboring files until everything is in slaFiles[0]. The left
+    // file always wins so the earliest file keeps a duplicated opcode
+    //
+    resetThreadPool();
+    for(size_t stride = 1; stride < slaFiles.size(); stride *= 2)
+    {
+        boost::asio::thread_pool threadPool(parsedData.numThreads);
+
+        for(size_t i = 0; i + stride < slaFiles.size(); i += stride * 2)
+        {
+            boost::asio::post(threadPool,
+                              boost::bind(mergeSlaFilesWorker,
+                                          boost::ref(slaFiles[i]),
+                                          boost::ref(slaFiles[i + stride])));
+        }
+
+        threadPool.join();
+    }
+
+    if(getWorkerFailures() > 0)
+    {
+        result = -1;
+        goto ERROR_EXIT;
+    }
+
+    // The first duplicate of an opcode stays in allInstructions, it is only
+    // an error if the opcode is in more than two files
+    parsedData.allInstructions.swap(slaFiles[0].duplicates);
+    parsedData.combinedInstructions.swap(slaFiles[0].instructions);
+
+ADD_SLA_FILES:
+    // the .sla files are indexed by their position in parsedData.slas
+    for(auto& slaFile: slaFiles)
+    {
+        result = addSlaFile(parsedData, slaFile);
+        if(result != 0)
+        {
+            goto ERROR_EXIT;
+        }
+    }
+
+    return 0;
+
+ERROR_EXIT:
+    for(auto& slaFile: slaFiles)
+    {
+        freeSlaFile(slaFile);
+    }
+
+    return result;
+}
+
+// Tokenizes and combines the .sla files as a tree instead of combining the
+// union of all files at once. Every file is combined on its own, then files
+// next to each other by opcode are merged pairwise and re-combined, level by
+// level, until one set of combined instructions is left in
+// parsedData.combinedInstructions. The merges of a level run concurrently and
+// share the worker threads, so the combine passes work on small sets and
+// memory is bounded by the largest level instead of the whole union.
+// The files must not share opcodes, like the shards of the 4 byte ISA
+// workflow. Combined opcodes found in two files are reported as duplicates
+static int treeMergeSlaFiles(PARSED_DATA& parsedData, vector<SLA_FILE>& slaFiles)
+{
+    vector<unsigned int> order;
+    unsigned int level = 0;
+
+    cout << "[*] Combining instructions (tree merge)" << endl;
+
+    //
+    // tokenize and combine each file on its own
+    //
+    {
+        unsigned int poolThreads = min<size_t>(parsedData.numThreads, slaFiles.size());
+        unsigned int combineThreads = max<size_t>(1, parsedData.numThreads / slaFiles.size());
+        boost::asio::thread_pool threadPool(poolThreads);
+
+        for(auto& slaFile: slaFiles)
+        {
+            boost::asio::post(threadPool,
+                              boost::bind(tokenizeCombineSlaFileWorker,
+                                          boost::ref(slaFile),
+                                          combineThreads));
+        }
+
+        threadPool.join();
+    }
+
+    for(unsigned int i = 0; i < slaFiles.size(); i++)
+    {
+        if(slaFiles[i].failed)
+        {
+            return -1;
+        }
+
+        order.push_back(i);
+    }
+
+    // neighbors by opcode prefix are the most likely to combine, the input
+    // filenames don't have to be in opcode order
+    stable_sort(order.begin(), order.end(), [&slaFiles](unsigned int a, unsigned int b) {
+        return slaFiles[a].firstOpcode < slaFiles[b].firstOpcode;
+    });
+
+    //
+    // merge and re-combine neighbors until everything is in the first file
+    // of order
+    //
+    for(size_t stride = 1; stride < order.size(); stride *= 2)
+    {
+        size_t numMerges = (order.size() - stride + stride * 2 - 1) / (stride * 2);
+        unsigned int poolThreads = min<size_t>(parsedData.numThreads, numMerges);
+        unsigned int combineThreads = max<size_t>(1, parsedData.numThreads / numMerges);
+        unsigned long long numInstructions = 0;
+
+        {
+            boost::asio::thread_pool threadPool(poolThreads);
+
+            for(size_t i = 0; i + stride < order.size(); i += stride * 2)
+            {
+                boost::asio::post(threadPool,
+                                  boost::bind(mergeCombineSlaFilesWorker,
+                                              boost::ref(slaFiles[order[i]]),
+                                              boost::ref(slaFiles[order[i + stride]]),
+                                              combineThreads));
+            }
+
+            threadPool.join();
+        }
+
+        for(size_t i = 0; i < order.size(); i += stride * 2)
+        {
+            if(slaFiles[order[i]].failed)
+            {
+                return -1;
+            }
+
+            numInstructions += slaFiles[order[i]].instructions.size();
+        }
+
+        level++;
+        cout << "  [*] Level: " << level << " Merges: " << numMerges << " Instructions: " << numInstructions << endl;
+    }
+
+    parsedData.combinedInstructions.swap(slaFiles[order[0]].instructions);
+
+    return 0;
+}
+
+// Combines the instructions of a single file. Parsed instructions that were
+// combined into another instruction are freed right away, the tree merge
+// would otherwise hold every parsed instruction until the end
+static void combineSlaFile(SLA_FILE& slaFile, unsigned int numThreads)
+{
+    PARSED_DATA combineData;
+    vector<Instruction*> parsedInstructions;
+    unordered_set<Instruction*> remainingInstructions;
+
+    for(auto& x: slaFile.instructions)
+    {
+        if(x.second->getNeedsFree() == false)
+        {
+            parsedInstructions.push_back(x.second);
+        }
+    }
+
+    combineData.combinedInstructions.swap(slaFile.instructions);
+    combineData.maxOpcodeBits = slaFile.maxOpcodeBits;
+    combineData.numThreads = numThreads;
+
+    combineInstructionPasses(combineData, false);
+
+    slaFile.instructions.swap(combineData.combinedInstructions);
+
+    for(auto& x: slaFile.instructions)
+    {
+        remainingInstructions.insert(x.second);
+    }
+
+    for(auto instruction: parsedInstructions)
+    {
+        if(remainingInstructions.find(instruction) == remainingInstructions.end())
+        {
+            delete instruction;
+        }
+    }
+}
+
+// tree merge worker for the first level, tokenizeSlaFile() and
+// combineSlaFile()
+static void tokenizeCombineSlaFileWorker(SLA_FILE& slaFile, unsigned int numThreads)
+{
+    if(tokenizeSlaFile(slaFile) != 0)
+    {
+        cout << "[-] Failed to parse instructions " << slaFile.filename << endl;
+        slaFile.failed = true;
+        return;
+    }
+
+    if(slaFile.instructions.size() != 0)
+    {
+        slaFile.firstOpcode = slaFile.instructions.begin()->first;
+    }
+
+    combineSlaFile(slaFile, numThreads);
+}
+
+// tree merge worker, merges the combined instructions of nextSlaFile into
+// slaFile and combines the result again
+static void mergeCombineSlaFilesWorker(SLA_FILE& slaFile,
+                                       SLA_FILE& nextSlaFile,
+                                       unsigned int numThreads)
+{
+    slaFile.instructions.merge(nextSlaFile.instructions);
+
+    if(nextSlaFile.instructions.size() != 0)
+    {
+        cout << "[-] Error " << nextSlaFile.filename << ": Found duplicate opcode!!" << endl;
+        slaFile.failed = true;
+        return;
+    }
+
+    if(nextSlaFile.maxOpcodeBits > slaFile.maxOpcodeBits)
+    {
+        slaFile.maxOpcodeBits = nextSlaFile.maxOpcodeBits;
+    }
+
+    slaFile.seenRegisters.merge(nextSlaFile.seenRegisters);
+
+    combineSlaFile(slaFile, numThreads);
+}
+
+// loads the .sla and reads its registers
+static int loadSlaFile(SLA_FILE& slaFile, bool useSlaCache)
+{
+    int result = 0;
+
+    if(useSlaCache)
+    {
+        result = slaFile.slautil.loadSlaCached(slaFile.filename);
+    }
+    else
+    {
+        result = slaFile.slautil.loadSla(slaFile.filename);
+    }
     if(result != 0)
     {
-        cout << "Failed to get sla registers" << endl;
         return result;
     }
 
-    result = addRegisters(registers);
+    result = slaFile.slautil.getRegisters(slaFile.registers);
     if(result != 0)
     {
-        cout << "Failed to add sla registers" << endl;
+        cout << "Failed to get sla registers" << endl;
+        return result;
     }
 
-    for(unsigned int j = 0; j < registers.size(); j++)
+    return 0;
+}
+
+// tokenizes the constructors of a loaded .sla into slaFile.instructions
+// registers of the .sla must already be added with addRegisters()
+static int tokenizeSlaFile(SLA_FILE& slaFile)
+{
+    unsigned int count = 0;
+    int result = 0;
+
+    result = slaFile.slautil.getConstructorCount(count);
+    if(result != 0)
     {
-        parsedData.registers.insert(registers[j]);
+        cout << "Failed to get constructor count" << endl;
+        return result;
     }
 
     for(unsigned int i = 0; i < count; i++)
@@ -59,14 +480,14 @@ int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId)
         bool isCombined = false;
         map<string, Instruction*>::iterator itr;
 
-        result = slautil.getConstructorBitPattern(i, bit_pattern);
+        result = slaFile.slautil.getConstructorBitPattern(i, bit_pattern);
         if(result != 0)
         {
             cout << "Failed to get bit pattern" << endl;
             return result;
         }
 
-        result = slautil.getConstructorText(i, constructor_text);
+        result = slaFile.slautil.getConstructorText(i, constructor_text);
         if(result != 0)
         {
             cout << "Failed to get constructor text" << endl;
@@ -122,10 +543,9 @@ int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId)
                 // we need to keep track of the maximum bit length for the 
                 // combining stage
                 opcodeBitLength = currInstruction->getOpcode().length();
-                if(opcodeBitLength > parsedData.maxOpcodeBits)
+                if(opcodeBitLength > slaFile.maxOpcodeBits)
                 {
-                    //cout << "Updating bit length from " << parsedData.maxOpcodeBits << " to " << opcodeBitLength << endl;
-                    parsedData.maxOpcodeBits = opcodeBitLength;
+                    slaFile.maxOpcodeBits = opcodeBitLength;
                 }
             }
             else
@@ -151,7 +571,7 @@ int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId)
                     }
                     else
                     {
-                        parsedData.registers.insert(lineSplit[i]);
+                        slaFile.seenRegisters.insert(lineSplit[i]);
                     }
                 }
                 else if(isImmediate(lineSplit[i]))
@@ -185,8 +605,8 @@ int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId)
         }
 
         // check for duplicate instructions before inserting
-        itr = parsedData.allInstructions.find(currInstruction->getOpcode());
-        if(itr != parsedData.allInstructions.end())
+        itr = slaFile.instructions.find(currInstruction->getOpcode());
+        if(itr != slaFile.instructions.end())
         {
             cout << "[-] Error line " << i << ": Found duplicate opcode!!" << endl;
             delete currInstruction;
@@ -194,16 +614,107 @@ int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId)
         }
 
         // everything is good, insert instruction into our set
-        parsedData.allInstructions.insert({{currInstruction->getOpcode(),
+        slaFile.instructions.insert({{currInstruction->getOpcode(),
                                             currInstruction}});
 
     } // for(unsigned int i = 0; i < count; i++)
 
+    return 0;
+}
+
+// thread pool worker for loadSlaFile()
+static void loadSlaFileWorker(SLA_FILE& slaFile, bool useSlaCache)
+{
+    if(loadSlaFile(slaFile, useSlaCache) != 0)
+    {
+        cout << "[-] Failed to load " << slaFile.filename << endl;
+        incrementWorkerFailures();
+    }
+
+    incrementWorkerCompletions();
+}
+
+// thread pool worker for tokenizeSlaFile()
+static void tokenizeSlaFileWorker(SLA_FILE& slaFile)
+{
+    if(tokenizeSlaFile(slaFile) != 0)
+    {
+        cout << "[-] Failed to parse instructions " << slaFile.filename << endl;
+        incrementWorkerFailures();
+    }
+
+    incrementWorkerCompletions();
+}
+
+// merges the instructions of nextSlaFile into slaFile. Opcodes already in
+// slaFile are kept as duplicates
+static void mergeSlaFilesWorker(SLA_FILE& slaFile, SLA_FILE& nextSlaFile)
+{
+    slaFile.instructions.merge(nextSlaFile.instructions);
+    slaFile.duplicates.merge(nextSlaFile.duplicates);
+    slaFile.duplicates.merge(nextSlaFile.instructions);
+
+    if(nextSlaFile.duplicates.size() != 0 || nextSlaFile.instructions.size() != 0)
+    {
+        cout << "[-] Error " << nextSlaFile.filename << ": Found duplicate opcode!!" << endl;
+        incrementWorkerFailures();
+    }
+
+    if(nextSlaFile.maxOpcodeBits > slaFile.maxOpcodeBits)
+    {
+        slaFile.maxOpcodeBits = nextSlaFile.maxOpcodeBits;
+    }
+
+    slaFile.seenRegisters.merge(nextSlaFile.seenRegisters);
+
+    incrementWorkerCompletions();
+}
+
+// indexes the .sla and moves it along with its registers into parsedData
+// the instructions of slaFile must already be in parsedData
+static int addSlaFile(PARSED_DATA& parsedData, SLA_FILE& slaFile)
+{
+    int result = 0;
+
+    for(unsigned int j = 0; j < slaFile.registers.size(); j++)
+    {
+        parsedData.registers.insert(slaFile.registers[j]);
+    }
+    parsedData.registers.merge(slaFile.seenRegisters);
+
+    if(slaFile.maxOpcodeBits > parsedData.maxOpcodeBits)
+    {
+        parsedData.maxOpcodeBits = slaFile.maxOpcodeBits;
+    }
+
     // Copy the instructions into the combined instructions set
     // We need to save the original allInstructions to recreate the registers
     // lists when we print out the instructions
     parsedData.combinedInstructions.merge(parsedData.allInstructions);
 
-    parsedData.slas.push_back(slautil);
-    return 0;   
+    result = parsedData.slaIndex.addSla(slaFile.slautil, parsedData.slas.size());
+    if(result != 0)
+    {
+        cout << "Failed to index sla" << endl;
+        return result;
+    }
+
+    parsedData.slas.push_back(std::move(slaFile.slautil));
+    return 0;
+}
+
+// frees the instructions that were not moved into PARSED_DATA
+static void freeSlaFile(SLA_FILE& slaFile)
+{
+    for(auto& x: slaFile.instructions)
+    {
+        delete x.second;
+    }
+    slaFile.instructions.clear();
+
+    for(auto& x: slaFile.duplicates)
+    {
+        delete x.second;
+    }
+    slaFile.duplicates.clear();
 }
@@ -17,3 +17,4 @@
 using namespace std;
 
 int parseInstructionsSla(PARSED_DATA& parsedData, unsigned int fileId);
+int parseInstructionsSlaFiles(PARSED_DATA& parsedData);
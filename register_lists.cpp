@@ -0,0 +1,112 @@
+//-----------------------------------------------------------------------------
+// File: register_lists.cpp
+//
+// Interned register lists of the attach variables
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <boost/algorithm/string.hpp>
+#include "register_lists.h"
+
+using namespace std;
+
+// default constructor
+RegisterLists::RegisterLists(void) :
+    m_field_lookups(0),
+    m_field_hits(0)
+{
+}
+
+// Interns the register names and the list. The text of a list is only
+// joined the first time the list is seen
+unsigned int RegisterLists::intern(const vector<string>& registers)
+{
+    vector<unsigned int> register_ids;
+    unsigned int list_id = 0;
+
+    register_ids.reserve(registers.size());
+
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    for(auto& register_name: registers)
+    {
+        auto itr = m_register_ids.emplace(register_name, m_register_ids.size()).first;
+        register_ids.push_back(itr->second);
+    }
+
+    auto list_itr = m_list_ids.find(register_ids);
+    if(list_itr != m_list_ids.end())
+    {
+        return list_itr->second;
+    }
+
+    list_id = m_texts.size();
+    m_list_ids.emplace(std::move(register_ids), list_id);
+
+    m_texts.push_back(boost::algorithm::join(registers, " "));
+    boost::trim_right(m_texts.back());
+
+    return list_id;
+}
+
+// returns the text of a list. Not synchronized with intern(), only call it
+// once the lists are interned
+const string& RegisterLists::getText(unsigned int list_id)
+{
+    return m_texts[list_id];
+}
+
+// looks up the list id of an already enumerated field
+bool RegisterLists::findField(const string& field_key, unsigned int& list_id)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_field_lookups++;
+
+    auto itr = m_field_ids.find(field_key);
+    if(itr == m_field_ids.end())
+    {
+        return false;
+    }
+
+    m_field_hits++;
+    list_id = itr->second;
+    return true;
+}
+
+// remembers the list id of an enumerated field. Two threads can enumerate the
+// same field at once, they intern the same list so either id is kept
+void RegisterLists::addField(const string& field_key, unsigned int list_id)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_field_ids.emplace(field_key, list_id);
+}
+
+unsigned long long RegisterLists::getFieldLookups(void)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    return m_field_lookups;
+}
+
+unsigned long long RegisterLists::getFieldHits(void)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    return m_field_hits;
+}
+
+// removes all lists, registers and fields
+void RegisterLists::clear(void)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_register_ids.clear();
+    m_list_ids.clear();
+    m_texts.clear();
+    m_field_ids.clear();
+    m_field_lookups = 0;
+    m_field_hits = 0;
+}
@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------------
+// File: register_lists.h
+//
+// Interned register lists of the attach variables
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+using namespace std;
+
+// Every distinct list of registers of a register field is stored once and
+// referred to by id. Register names are interned to ids as well, so two
+// fields with the same registers get the same list id and can be compared
+// and named without comparing their text.
+// The list id of each enumerated field is remembered as well, so a field
+// that many combined instructions share is only enumerated once
+class RegisterLists
+{
+    public:
+        RegisterLists();
+
+        // returns the id of the list of register names, adding the list if
+        // it's new. Thread safe
+        unsigned int intern(const vector<string>& registers);
+
+        // space delimited register names of a list. Ex: "r0 r1 r2 r3".
+        // Only call once the lists are interned
+        const string& getText(unsigned int list_id);
+
+        // list id of a field that was already enumerated, see
+        // Instruction::getAttachedRegistersKey(). Thread safe
+        bool findField(const string& field_key, unsigned int& list_id);
+        void addField(const string& field_key, unsigned int list_id);
+
+        // number of fields looked up and number of them already enumerated
+        unsigned long long getFieldLookups(void);
+        unsigned long long getFieldHits(void);
+
+        void clear(void);
+
+    private:
+        boost::mutex m_mutex;
+
+        // register name to register id
+        boost::unordered_map<string, unsigned int> m_register_ids;
+
+        // register ids of a list to its list id
+        boost::unordered_map<vector<unsigned int>, unsigned int> m_list_ids;
+
+        // text of each list by list id, built once when the list is added.
+        // A deque so references stay valid while other lists are added
+        deque<string> m_texts;
+
+        // field key to the list id of the field
+        boost::unordered_map<string, unsigned int> m_field_ids;
+
+        unsigned long long m_field_lookups;
+        unsigned long long m_field_hits;
+};
@@ -0,0 +1,693 @@
+//-----------------------------------------------------------------------------
+// File: selfcheck.cpp
+//
+// Checking the combined instructions against the parsed instructions
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+
+#include <iostream>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/timer/timer.hpp>
+#include "selfcheck.h"
+
+// Decodes every parsed instruction with the combined instructions the same
+// way the .slaspec will: find the most specific combined instruction whose
+// fixed bits match the opcode, fill in its register fields from the attach
+// variable lists and its immediate fields from the opcode bits, and compare
+// that to the parsed instruction. Catches wrong or ambiguous merges without
+// compiling the .slaspec. Must run after computeAttachVariables()
+int selfCheckInstructions(PARSED_DATA& parsedData, unsigned int fileId)
+{
+    boost::timer::auto_cpu_timer t;
+    SELF_CHECK_DATA checkData;
+    vector<SELF_CHECK_RESULTS> workerResults(parsedData.numThreads);
+    SELF_CHECK_RESULTS results;
+    boost::asio::thread_pool threadPool(parsedData.numThreads);
+    unsigned long long numInstructions = 0;
+    unsigned long long portionSize = 0;
+    int result = 0;
+
+    result = buildSelfCheckData(parsedData, checkData);
+    if(result != 0)
+    {
+        return result;
+    }
+
+    //
+    // split the instructions into 1/num threads pieces
+    //
+    numInstructions = checkData.instructions.size();
+    portionSize = numInstructions/parsedData.numThreads;
+
+    if(portionSize == 0)
+    {
+        // we can end up with a 0 portionSize if numThreads > numInstructions
+        portionSize = 1;
+    }
+
+    for(unsigned int i = 0; i < parsedData.numThreads; i++)
+    {
+        unsigned long long start = i * portionSize;
+        unsigned long long end = 0;
+
+        if(i == parsedData.numThreads - 1)
+        {
+            // last thread, always set end to numInstructions
+            end = numInstructions - 1;
+        }
+        else
+        {
+            end = start + portionSize - 1;
+        }
+
+        if(start >= numInstructions)
+        {
+            continue;
+        }
+
+        boost::asio::post(threadPool,
+                          boost::bind(selfCheckWorker,
+                                      boost::ref(checkData),
+                                      start,
+                                      end,
+                                      boost::ref(workerResults[i])));
+    }
+
+    // wait for threads
+    threadPool.join();
+
+    //
+    // merge the worker results in order
+    //
+    results.checked = 0;
+    results.uncovered = 0;
+    results.ambiguous = 0;
+    results.mismatched = 0;
+
+    for(auto& workerResult: workerResults)
+    {
+        results.checked += workerResult.checked;
+        results.uncovered += workerResult.uncovered;
+        results.ambiguous += workerResult.ambiguous;
+        results.mismatched += workerResult.mismatched;
+
+        for(auto& group: workerResult.groups)
+        {
+            PSELF_CHECK_GROUP dest = &results.groups[group.first];
+
+            dest->count += group.second.count;
+            for(auto& sample: group.second.samples)
+            {
+                if(dest->samples.size() >= SELF_CHECK_SAMPLES)
+                {
+                    break;
+                }
+
+                dest->samples.push_back(std::move(sample));
+            }
+        }
+    }
+
+    // the samples are printed the same as the input file, not escaped like
+    // the .slaspec
+    readSelfCheckSampleText(parsedData.inputFilenames[fileId], results);
+
+    printSelfCheckResults(results);
+    return 0;
+}
+
+// Packs the combined instructions into patterns, indexes them by opcode
+// length and leading bits, and splits the attach variable register lists
+int buildSelfCheckData(PARSED_DATA& parsedData, SELF_CHECK_DATA& checkData)
+{
+    for(auto& registerVariable: parsedData.registerVariables)
+    {
+        vector<string>* registers = &checkData.registerLists[registerVariable.first];
+
+        boost::split(*registers, registerVariable.second, boost::is_any_of(" "));
+    }
+
+    //
+    // combined instructions to patterns
+    //
+    for(auto& combined: parsedData.combinedInstructions)
+    {
+        const string& opcode = combined.first;
+        SELF_CHECK_PATTERN pattern;
+
+        if(opcode.length() == 0 || opcode.length() > 64)
+        {
+            cout << "[-] Self check: unsupported opcode length " << opcode.length() << "!!" << endl;
+            return -1;
+        }
+
+        pattern.bits.length = opcode.length();
+        pattern.bits.mask = 0;
+        pattern.bits.value = 0;
+        pattern.instruction = combined.second;
+        pattern.opcode = &opcode;
+
+        for(unsigned int i = 0; i < opcode.length(); i++)
+        {
+            unsigned long long bit = 1ULL << (opcode.length() - i - 1);
+            char c = opcode[i];
+
+            if(c == '0' || c == '1')
+            {
+                pattern.bits.mask |= bit;
+                pattern.bits.value |= (c == '1') ? bit : 0;
+                continue;
+            }
+
+            if(c == '*')
+            {
+                continue;
+            }
+
+            // register or immediate field. computeAttachVariables() names the
+            // component after the last run of its letter, so a new run
+            // replaces the bits of an earlier one
+            unsigned int position = pattern.instruction->getComponentPositionFromLetter(c);
+            PSELF_CHECK_FIELD field = NULL;
+
+            for(auto& x: pattern.fields)
+            {
+                if(x.component == position)
+                {
+                    field = &x;
+                }
+            }
+
+            if(field == NULL)
+            {
+                const string& name = pattern.instruction->components[position].combinedComponent;
+                const vector<string>* registers = NULL;
+
+                if(c >= 'A' && c <= 'Z')
+                {
+                    auto itr = checkData.registerLists.find(name);
+                    if(itr == checkData.registerLists.end())
+                    {
+                        cout << "[-] Self check: no attach variable " << name << "!!" << endl;
+                        return -1;
+                    }
+                    registers = &itr->second;
+                }
+
+                pattern.fields.push_back({position, 0, registers});
+                field = &pattern.fields.back();
+            }
+
+            if(i > 0 && opcode[i - 1] != c)
+            {
+                field->mask = 0;
+            }
+            field->mask |= bit;
+        }
+
+        checkData.patterns.push_back(std::move(pattern));
+    }
+
+    //
+    // index the patterns by the leading bits. Patterns with wildcards in the
+    // leading bits are added to every bucket they can match
+    //
+    for(unsigned int id = 0; id < checkData.patterns.size(); id++)
+    {
+        PCONSTRUCTOR_MASK bits = &checkData.patterns[id].bits;
+        PSELF_CHECK_INDEX index = &checkData.indexes[bits->length];
+        unsigned int shift = 0;
+
+        if(index->buckets.size() == 0)
+        {
+            index->prefixBits = min(bits->length, (unsigned int)SELF_CHECK_PREFIX_BITS);
+            index->buckets.resize(1ULL << index->prefixBits);
+        }
+
+        shift = bits->length - index->prefixBits;
+
+        for(unsigned long long prefix = 0; prefix < index->buckets.size(); prefix++)
+        {
+            if(((prefix << shift) & bits->mask) == (bits->value & (((1ULL << index->prefixBits) - 1) << shift)))
+            {
+                index->buckets[prefix].push_back(id);
+            }
+        }
+    }
+
+    for(auto& instruction: parsedData.allInstructions)
+    {
+        checkData.instructions.push_back({&instruction.first, instruction.second});
+    }
+
+    return 0;
+}
+
+// thread pool worker, checks instructions [start, end]
+void selfCheckWorker(SELF_CHECK_DATA& checkData,
+                     unsigned long long start,
+                     unsigned long long end,
+                     SELF_CHECK_RESULTS& results)
+{
+    results.checked = 0;
+    results.uncovered = 0;
+    results.ambiguous = 0;
+    results.mismatched = 0;
+
+    for(unsigned long long i = start; i <= end; i++)
+    {
+        selfCheckInstruction(checkData,
+                             *checkData.instructions[i].first,
+                             checkData.instructions[i].second,
+                             results);
+    }
+}
+
+// converts a binary opcode string to hex like the input files
+static string getHexOpcode(const string& opcode)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+    string hexOpcode = "0x";
+
+    for(unsigned int i = 0; i < opcode.length(); i += 4)
+    {
+        unsigned int nibble = 0;
+
+        for(unsigned int j = i; j < i + 4; j++)
+        {
+            nibble = (nibble << 1) | (j < opcode.length() && opcode[j] == '1');
+        }
+
+        hexOpcode.push_back(hexDigits[nibble]);
+    }
+
+    return hexOpcode;
+}
+
+// value of an immediate as the parsed text, 0x for hex otherwise decimal
+static bool getImmediateValue(const string& immediate, unsigned long long& value)
+{
+    char* end = NULL;
+
+    if(immediate.length() > 2 && immediate[0] == '0' && (immediate[1] == 'x' || immediate[1] == 'X'))
+    {
+        value = strtoull(immediate.c_str() + 2, &end, 16);
+    }
+    else
+    {
+        value = strtoull(immediate.c_str(), &end, 10);
+    }
+
+    return end != NULL && *end == '\0';
+}
+
+// Checks a single parsed instruction. Patterns are compared on the opcode's
+// length and, for variable length ISAs, on its prefixes, since a shorter
+// instruction matching the start of the opcode would decode it too
+void selfCheckInstruction(SELF_CHECK_DATA& checkData,
+                          const string& opcode,
+                          Instruction* instruction,
+                          SELF_CHECK_RESULTS& results)
+{
+    vector<unsigned int> matches;
+    unsigned long long value = 0;
+    PSELF_CHECK_PATTERN best = NULL;
+    unsigned long long bestValue = 0;
+    Instruction rendered;
+    bool isEqual = true;
+
+    results.checked++;
+
+    if(opcode.length() > 64)
+    {
+        results.uncovered++;
+        addSelfCheckFailure(results, "uncovered", opcode, instruction, NULL);
+        return;
+    }
+
+    for(auto c: opcode)
+    {
+        value = (value << 1) | (c == '1');
+    }
+
+    //
+    // find the matching patterns of this length and shorter
+    //
+    for(auto& index: checkData.indexes)
+    {
+        unsigned int length = index.first;
+        unsigned long long prefixValue = 0;
+
+        if(length > opcode.length())
+        {
+            break;
+        }
+
+        prefixValue = value >> (opcode.length() - length);
+
+        for(auto id: index.second.buckets[prefixValue >> (length - index.second.prefixBits)])
+        {
+            PCONSTRUCTOR_MASK bits = &checkData.patterns[id].bits;
+
+            if((prefixValue & bits->mask) == bits->value)
+            {
+                matches.push_back(id);
+            }
+        }
+    }
+
+    if(matches.size() == 0)
+    {
+        results.uncovered++;
+        addSelfCheckFailure(results, "uncovered", opcode, instruction, NULL);
+        return;
+    }
+
+    //
+    // SLEIGH picks the pattern whose fixed bits include the fixed bits of
+    // every other matching pattern. Masks are compared aligned to the start
+    // of the opcode
+    //
+    for(auto id: matches)
+    {
+        PSELF_CHECK_PATTERN curr = &checkData.patterns[id];
+        unsigned long long currMask = curr->bits.mask << (opcode.length() - curr->bits.length);
+        bool mostSpecific = true;
+
+        for(auto otherId: matches)
+        {
+            PSELF_CHECK_PATTERN other = &checkData.patterns[otherId];
+            unsigned long long otherMask = other->bits.mask << (opcode.length() - other->bits.length);
+
+            if(otherId == id)
+            {
+                continue;
+            }
+
+            if((currMask & otherMask) != otherMask || (currMask == otherMask && curr->bits.length <= other->bits.length))
+            {
+                mostSpecific = false;
+                break;
+            }
+        }
+
+        if(mostSpecific)
+        {
+            best = curr;
+            break;
+        }
+    }
+
+    if(best == NULL)
+    {
+        string key = "ambiguous";
+
+        for(auto id: matches)
+        {
+            key += " " + *checkData.patterns[id].opcode;
+        }
+
+        results.ambiguous++;
+        addSelfCheckFailure(results, key, opcode, instruction, NULL);
+        return;
+    }
+
+    bestValue = value >> (opcode.length() - best->bits.length);
+
+    //
+    // decode the opcode with the pattern: take its components and fill in the
+    // register and immediate fields from the opcode bits
+    //
+    rendered.components = best->instruction->components;
+
+    for(auto& field: best->fields)
+    {
+        InstructionComponent* component = &rendered.components[field.component];
+        unsigned long long fieldValue = 0;
+
+        // gather the field bits, most significant first
+        for(int bit = best->bits.length - 1; bit >= 0; bit--)
+        {
+            if(field.mask & (1ULL << bit))
+            {
+                fieldValue = (fieldValue << 1) | ((bestValue >> bit) & 1);
+            }
+        }
+
+        if(field.registers != NULL)
+        {
+            if(fieldValue < field.registers->size())
+            {
+                component->component = (*field.registers)[fieldValue];
+            }
+            else
+            {
+                component->component = "?";
+            }
+        }
+        else
+        {
+            char immediate[32];
+            unsigned long long originalValue = 0;
+
+            // the .slaspec prints immediates in hex, keep the parsed text if
+            // it's the same value so only real differences are reported
+            snprintf(immediate, sizeof(immediate) - 1, "0x%llx", fieldValue);
+            if(field.component < instruction->components.size() &&
+               getImmediateValue(instruction->components[field.component].component, originalValue) &&
+               originalValue == fieldValue)
+            {
+                component->component = instruction->components[field.component].component;
+            }
+            else
+            {
+                component->component = immediate;
+            }
+        }
+    }
+
+    //
+    // compare the decoded instruction to the parsed one
+    //
+    if(rendered.components.size() != instruction->components.size())
+    {
+        isEqual = false;
+    }
+
+    for(unsigned int i = 0; isEqual && i < rendered.components.size(); i++)
+    {
+        if(rendered.components[i].type != instruction->components[i].type ||
+           rendered.components[i].component != instruction->components[i].component)
+        {
+            isEqual = false;
+        }
+    }
+
+    if(isEqual == false)
+    {
+        results.mismatched++;
+        addSelfCheckFailure(results,
+                            "mismatched " + *best->opcode,
+                            opcode,
+                            instruction,
+                            &rendered);
+    }
+}
+
+// counts a failure in its group and keeps the first few as samples
+// rendered is NULL if no combined instruction decoded the opcode
+void addSelfCheckFailure(SELF_CHECK_RESULTS& results,
+                         const string& key,
+                         const string& opcode,
+                         Instruction* instruction,
+                         Instruction* rendered)
+{
+    PSELF_CHECK_GROUP group = &results.groups[key];
+    SELF_CHECK_SAMPLE sample;
+
+    group->count++;
+    if(group->samples.size() >= SELF_CHECK_SAMPLES)
+    {
+        return;
+    }
+
+    sample.opcode = getHexOpcode(opcode);
+
+    for(auto& component: instruction->components)
+    {
+        sample.parsed.push_back(component.component);
+    }
+
+    if(rendered != NULL)
+    {
+        for(auto& component: rendered->components)
+        {
+            sample.rendered.push_back(component.component);
+        }
+    }
+
+    group->samples.push_back(std::move(sample));
+}
+
+// Fills in the input text of the samples so they are printed the same as the
+// input file. Only runs if there are failures, the input is read line by line
+// until every sample opcode was found
+int readSelfCheckSampleText(const string& inputFilename, SELF_CHECK_RESULTS& results)
+{
+    map<string, vector<PSELF_CHECK_SAMPLE>> samples; // key = upper case hex opcode
+    string line;
+
+    for(auto& group: results.groups)
+    {
+        for(auto& sample: group.second.samples)
+        {
+            samples[boost::to_upper_copy(sample.opcode)].push_back(&sample);
+        }
+    }
+
+    if(samples.size() == 0)
+    {
+        return 0;
+    }
+
+    boost::filesystem::path infile{inputFilename};
+    boost::filesystem::ifstream ifs{infile};
+
+    if(!ifs)
+    {
+        cout << "[-] Self check: failed to open input file!!" << endl;
+        return -1;
+    }
+
+    while(samples.size() > 0 && getline(ifs, line))
+    {
+        map<string, vector<PSELF_CHECK_SAMPLE>>::iterator itr;
+        size_t opcodeStart = line.find_first_not_of(" \t");
+        size_t opcodeEnd = 0;
+
+        if(opcodeStart == string::npos)
+        {
+            continue;
+        }
+
+        opcodeEnd = line.find_first_of(" \t\r", opcodeStart);
+        if(opcodeEnd == string::npos)
+        {
+            opcodeEnd = line.length();
+        }
+
+        itr = samples.find(boost::to_upper_copy(line.substr(opcodeStart, opcodeEnd - opcodeStart)));
+        if(itr == samples.end())
+        {
+            continue;
+        }
+
+        for(auto sample: itr->second)
+        {
+            sample->text = boost::trim_copy(line.substr(opcodeEnd));
+        }
+
+        samples.erase(itr);
+    }
+
+    return 0;
+}
+
+// Prints components in place of the tokens of an input line, keeping the
+// spacing of the line. Ex: "mov #-0x80,r0" with "mov", "#", "-", "0x7f", ","
+// and "r0" is "mov #-0x7f,r0". If the tokens don't line up only the space
+// after the mnemonic is kept. Ex: "mov #0x80,r0" for "mov", "#", "0x80", ","
+// and "r0"
+string getSelfCheckSampleText(const string& text, const vector<string>& components)
+{
+    vector<string> tokens;
+    string output;
+    size_t pos = 0;
+
+    splitDisassemblyLine(tokens, text);
+
+    for(unsigned int i = 0; i < tokens.size() && tokens.size() == components.size(); i++)
+    {
+        size_t found = text.find(tokens[i], pos);
+
+        if(found == string::npos)
+        {
+            break;
+        }
+
+        output += text.substr(pos, found - pos);
+        output += components[i];
+        pos = found + tokens[i].length();
+
+        if(i == tokens.size() - 1)
+        {
+            return output + text.substr(pos);
+        }
+    }
+
+    output.clear();
+    for(unsigned int i = 0; i < components.size(); i++)
+    {
+        output += components[i];
+        if(i == 0 && components.size() > 1)
+        {
+            output += " ";
+        }
+    }
+
+    return output;
+}
+
+// prints the totals and the groups with the most failures
+void printSelfCheckResults(SELF_CHECK_RESULTS& results)
+{
+    vector<pair<string, PSELF_CHECK_GROUP>> groups;
+
+    cout << "[*] Self check: " << results.checked << " instructions checked, "
+         << results.uncovered << " uncovered, "
+         << results.ambiguous << " ambiguous, "
+         << results.mismatched << " mismatched" << endl;
+
+    if(results.groups.size() == 0)
+    {
+        return;
+    }
+
+    for(auto& group: results.groups)
+    {
+        groups.push_back({group.first, &group.second});
+    }
+
+    // most failures first, ties by key so the output is stable
+    stable_sort(groups.begin(), groups.end(),
+                [](const pair<string, PSELF_CHECK_GROUP>& left, const pair<string, PSELF_CHECK_GROUP>& right)
+                {
+                    return left.second->count > right.second->count;
+                });
+
+    for(unsigned int i = 0; i < groups.size() && i < SELF_CHECK_MAX_GROUPS; i++)
+    {
+        cout << "[-] " << groups[i].first << ": " << groups[i].second->count << endl;
+
+        for(auto& sample: groups[i].second->samples)
+        {
+            cout << "      " << sample.opcode << " " << getSelfCheckSampleText(sample.text, sample.parsed);
+            if(sample.rendered.size() > 0)
+            {
+                cout << " -> " << getSelfCheckSampleText(sample.text, sample.rendered);
+            }
+            cout << endl;
+        }
+    }
+
+    if(groups.size() > SELF_CHECK_MAX_GROUPS)
+    {
+        cout << "[-] " << groups.size() - SELF_CHECK_MAX_GROUPS << " more groups not shown" << endl;
+    }
+}
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// File: selfcheck.h
+//
+// Checking the combined instructions against the parsed instructions
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "parser.h"
+
+// number of leading opcode bits the combined instructions are indexed on
+#define SELF_CHECK_PREFIX_BITS 8
+
+// number of failing opcodes kept as samples for each group
+#define SELF_CHECK_SAMPLES 3
+
+// number of failure groups printed, the ones with the most failures first
+#define SELF_CHECK_MAX_GROUPS 20
+
+// a register or immediate field of a combined instruction
+typedef struct _SELF_CHECK_FIELD
+{
+    unsigned int component; // index into the instruction's components
+    unsigned long long mask; // bits of the field in the opcode, same bit order as CONSTRUCTOR_MASK
+    const vector<string>* registers; // attach variable list by field value, NULL for immediates
+} SELF_CHECK_FIELD, *PSELF_CHECK_FIELD;
+
+// a combined instruction as the .slaspec constructor decodes it
+typedef struct _SELF_CHECK_PATTERN
+{
+    CONSTRUCTOR_MASK bits;
+    Instruction* instruction;
+    const string* opcode; // combined opcode, key in combinedInstructions
+    vector<SELF_CHECK_FIELD> fields;
+} SELF_CHECK_PATTERN, *PSELF_CHECK_PATTERN;
+
+// combined instructions of a single opcode length, by leading opcode bits
+typedef struct _SELF_CHECK_INDEX
+{
+    unsigned int prefixBits;
+    vector<vector<unsigned int>> buckets; // ids into SELF_CHECK_DATA::patterns
+} SELF_CHECK_INDEX, *PSELF_CHECK_INDEX;
+
+// an opcode that failed the check
+typedef struct _SELF_CHECK_SAMPLE
+{
+    string opcode; // hex like the input file
+    string text; // the input line after the opcode, empty until readSelfCheckSampleText()
+    vector<string> parsed; // components of the parsed instruction
+    vector<string> rendered; // components the combined instruction decodes it as
+} SELF_CHECK_SAMPLE, *PSELF_CHECK_SAMPLE;
+
+// failures with the same cause, ex. all mismatches of one combined instruction
+typedef struct _SELF_CHECK_GROUP
+{
+    unsigned long long count;
+    vector<SELF_CHECK_SAMPLE> samples;
+} SELF_CHECK_GROUP, *PSELF_CHECK_GROUP;
+
+// results of a worker, merged in worker order so the samples don't depend on
+// timing
+typedef struct _SELF_CHECK_RESULTS
+{
+    unsigned long long checked;
+    unsigned long long uncovered; // no combined instruction matches
+    unsigned long long ambiguous; // no single most specific combined instruction matches
+    unsigned long long mismatched; // decodes to different text
+    map<string, SELF_CHECK_GROUP> groups; // key = kind of failure and combined opcodes
+} SELF_CHECK_RESULTS, *PSELF_CHECK_RESULTS;
+
+typedef struct _SELF_CHECK_DATA
+{
+    vector<SELF_CHECK_PATTERN> patterns;
+
+    // key = opcode length in bits
+    map<unsigned int, SELF_CHECK_INDEX> indexes;
+
+    // parsed registerVariables, key = register variable name
+    map<string, vector<string>> registerLists;
+
+    // parsed instructions to check
+    vector<pair<const string*, Instruction*>> instructions;
+} SELF_CHECK_DATA, *PSELF_CHECK_DATA;
+
+int selfCheckInstructions(PARSED_DATA& parsedData, unsigned int fileId);
+int buildSelfCheckData(PARSED_DATA& parsedData, SELF_CHECK_DATA& checkData);
+void selfCheckWorker(SELF_CHECK_DATA& checkData,
+                     unsigned long long start,
+                     unsigned long long end,
+                     SELF_CHECK_RESULTS& results);
+void selfCheckInstruction(SELF_CHECK_DATA& checkData,
+                          const string& opcode,
+                          Instruction* instruction,
+                          SELF_CHECK_RESULTS& results);
+void addSelfCheckFailure(SELF_CHECK_RESULTS& results,
+                         const string& key,
+                         const string& opcode,
+                         Instruction* instruction,
+                         Instruction* rendered);
+int readSelfCheckSampleText(const string& inputFilename, SELF_CHECK_RESULTS& results);
+string getSelfCheckSampleText(const string& text, const vector<string>& components);
+void printSelfCheckResults(SELF_CHECK_RESULTS& results);
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// File: sla_test.cpp
+//
+// Helpers shared by the .sla tests
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <sstream>
+#include "sla_test.h"
+using namespace std;
+
+// everything the generator reads from a loaded .sla. Looking up every bit
+// pattern goes through the decision index
+int getSlaTestOutput(Slautil& slautil, string& output)
+{
+    vector<string> registers;
+    unsigned int count = 0;
+    stringstream ss;
+
+    if(slautil.getRegisters(registers) != SLA_SUCCESS ||
+       slautil.getConstructorCount(count) != SLA_SUCCESS)
+    {
+        return -1;
+    }
+
+    for(auto& reg: registers)
+    {
+        ss << reg << endl;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        string bit_pattern;
+        string constructor_text;
+        unsigned int id = 0;
+        int result = 0;
+
+        result = slautil.getConstructorBitPattern(i, bit_pattern);
+        ss << i << " " << result << " " << bit_pattern;
+
+        try
+        {
+            result = slautil.getConstructorText(i, constructor_text);
+            ss << " " << result << " " << constructor_text;
+        }
+        catch(int e)
+        {
+            ss << " throw " << e;
+        }
+
+        if(bit_pattern.size() != 0)
+        {
+            result = slautil.getConstructorIdByBitPattern(bit_pattern, id);
+            ss << " " << result << " " << (result == SLA_SUCCESS ? id : 0);
+        }
+
+        ss << endl;
+    }
+
+    output = ss.str();
+    return SLA_SUCCESS;
+}
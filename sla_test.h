@@ -0,0 +1,13 @@
+//-----------------------------------------------------------------------------
+// File: sla_test.h
+//
+// Helpers shared by the .sla tests
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "slautil/slautil.h"
+
+int getSlaTestOutput(Slautil& slautil, string& output);
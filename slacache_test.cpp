@@ -0,0 +1,262 @@
+//-----------------------------------------------------------------------------
+// File: slacache_test.cpp
+//
+// Tests that a damaged .sla cache is ignored. A valid cache is written for
+// the given .sla, a decision node index in it is overwritten and loading has
+// to fall back to parsing the .sla, rewrite the cache and give the same
+// constructors as an uncached load
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <boost/filesystem.hpp>
+#include "sla_test.h"
+#include "slautil/slacache.h"
+using namespace std;
+
+// a way of damaging the decision index of a valid cache
+typedef struct _SLA_CACHE_TEST
+{
+    const char* name;
+    bool pointToSelf; // child index of the node points back at the node
+    bool rehash; // fix up the payload hash so only the range checks catch it
+} SLA_CACHE_TEST, *PSLA_CACHE_TEST;
+
+static const SLA_CACHE_TEST g_tests[] =
+{
+    {"out of range child, stale payload hash", false, false},
+    {"out of range child, valid payload hash", false, true},
+    {"cyclic child, valid payload hash", true, true},
+};
+
+static bool readTestFile(const string& filename, string& data);
+static bool writeTestFile(const string& filename, const string& data);
+static int corruptDecisionNode(string& cache, bool pointToSelf);
+static int runTest(const SLA_CACHE_TEST& test,
+                   const string& slaFilename,
+                   const string& validCache,
+                   const string& expectedOutput);
+
+int main(int argc, char* argv[])
+{
+    boost::filesystem::path tempDir;
+    string slaFilename;
+    string validCache;
+    string expectedOutput;
+    string output;
+    Slautil reference;
+    Slautil cached;
+    unsigned int failures = 0;
+
+    if(argc != 2)
+    {
+        cout << "Usage: " << argv[0] << " <file.sla>" << endl;
+        return -1;
+    }
+
+    // the cache is written next to the .sla, keep it out of the source tree
+    tempDir = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("slacache-test-%%%%-%%%%");
+    boost::filesystem::create_directories(tempDir);
+    slaFilename = (tempDir / boost::filesystem::path(argv[1]).filename()).string();
+    boost::filesystem::copy_file(argv[1], slaFilename);
+
+    if(reference.loadSla(argv[1]) != SLA_SUCCESS ||
+       getSlaTestOutput(reference, expectedOutput) != SLA_SUCCESS)
+    {
+        cout << "[-] Failed to load " << argv[1] << endl;
+        boost::filesystem::remove_all(tempDir);
+        return -1;
+    }
+
+    // first load writes the cache
+    if(cached.loadSlaCached(slaFilename) != SLA_SUCCESS ||
+       !readTestFile(slaFilename + SLA_CACHE_EXTENSION, validCache))
+    {
+        cout << "[-] Failed to write the sla cache" << endl;
+        boost::filesystem::remove_all(tempDir);
+        return -1;
+    }
+
+    // second load reads it
+    cached = Slautil();
+    if(cached.loadSlaCached(slaFilename) != SLA_SUCCESS ||
+       getSlaTestOutput(cached, output) != SLA_SUCCESS ||
+       output != expectedOutput)
+    {
+        cout << "[-] Valid sla cache doesn't match the .sla" << endl;
+        failures++;
+    }
+
+    for(auto& test: g_tests)
+    {
+        if(runTest(test, slaFilename, validCache, expectedOutput) != SLA_SUCCESS)
+        {
+            failures++;
+        }
+    }
+
+    boost::filesystem::remove_all(tempDir);
+
+    if(failures != 0)
+    {
+        cout << "[-] " << failures << " sla cache tests failed" << endl;
+        return -1;
+    }
+
+    cout << "[+] All sla cache tests passed" << endl;
+    return 0;
+}
+
+// damages the cache, loads it and checks the load fell back to the .sla
+static int runTest(const SLA_CACHE_TEST& test,
+                   const string& slaFilename,
+                   const string& validCache,
+                   const string& expectedOutput)
+{
+    string cacheFilename = slaFilename + SLA_CACHE_EXTENSION;
+    string cache = validCache;
+    string rewrittenCache;
+    string output;
+    Slautil slautil;
+
+    if(corruptDecisionNode(cache, test.pointToSelf) != SLA_SUCCESS)
+    {
+        cout << "[-] " << test.name << ": no decision node found in the cache" << endl;
+        return -1;
+    }
+
+    if(test.rehash)
+    {
+        SLA_CACHE_HEADER header = {};
+
+        memcpy(&header, cache.data(), sizeof(header));
+        header.payload_hash = hashSlaFile(cache.data() + sizeof(header), cache.size() - sizeof(header));
+        cache.replace(0, sizeof(header), (const char*)&header, sizeof(header));
+    }
+
+    if(!writeTestFile(cacheFilename, cache))
+    {
+        cout << "[-] " << test.name << ": failed to write the cache" << endl;
+        return -1;
+    }
+
+    if(slautil.loadSlaCached(slaFilename) != SLA_SUCCESS ||
+       getSlaTestOutput(slautil, output) != SLA_SUCCESS)
+    {
+        cout << "[-] " << test.name << ": load failed" << endl;
+        return -1;
+    }
+
+    if(output != expectedOutput)
+    {
+        cout << "[-] " << test.name << ": constructors differ from the .sla" << endl;
+        return -1;
+    }
+
+    // the fallback parses the .sla and writes a good cache again
+    if(!readTestFile(cacheFilename, rewrittenCache) ||
+       rewrittenCache.size() != validCache.size() ||
+       rewrittenCache == cache)
+    {
+        cout << "[-] " << test.name << ": cache wasn't rewritten" << endl;
+        return -1;
+    }
+
+    cout << "[+] " << test.name << endl;
+    return SLA_SUCCESS;
+}
+
+// Overwrites the child index of the first inner decision node. The nodes are
+// found by the tables written before them: the decision pairs and constructor
+// masks are both one per constructor and stored as a count and raw structs
+static int corruptDecisionNode(string& cache, bool pointToSelf)
+{
+    unsigned long long constructorCount = 0;
+    size_t tablesSize = 0;
+
+    if(cache.size() < sizeof(SLA_CACHE_HEADER) + sizeof(unsigned long long))
+    {
+        return -1;
+    }
+
+    // m_constructor_count comes right after the sleigh version
+    memcpy(&constructorCount,
+           cache.data() + sizeof(SLA_CACHE_HEADER) + sizeof(unsigned long long),
+           sizeof(constructorCount));
+
+    tablesSize = sizeof(unsigned long long) + constructorCount * sizeof(DECISION_PAIR) +
+                 sizeof(unsigned long long) + constructorCount * sizeof(CONSTRUCTOR_MASK);
+
+    for(size_t pos = sizeof(SLA_CACHE_HEADER);
+        pos + tablesSize + sizeof(unsigned long long) <= cache.size();
+        pos++)
+    {
+        unsigned long long pairCount = 0;
+        unsigned long long maskCount = 0;
+        unsigned long long nodeCount = 0;
+        size_t nodes = pos + tablesSize + sizeof(unsigned long long);
+
+        memcpy(&pairCount, cache.data() + pos, sizeof(pairCount));
+        memcpy(&maskCount,
+               cache.data() + pos + sizeof(unsigned long long) + constructorCount * sizeof(DECISION_PAIR),
+               sizeof(maskCount));
+        memcpy(&nodeCount, cache.data() + pos + tablesSize, sizeof(nodeCount));
+
+        if(pairCount != constructorCount ||
+           maskCount != constructorCount ||
+           nodeCount > (cache.size() - nodes) / sizeof(DECISION_NODE))
+        {
+            continue;
+        }
+
+        for(unsigned int i = 0; i < nodeCount; i++)
+        {
+            DECISION_NODE node = {};
+
+            memcpy(&node, cache.data() + nodes + i * sizeof(node), sizeof(node));
+            if(node.size == 0)
+            {
+                continue;
+            }
+
+            node.first = pointToSelf ? i : 0xffffff00;
+            cache.replace(nodes + i * sizeof(node), sizeof(node), (const char*)&node, sizeof(node));
+            return SLA_SUCCESS;
+        }
+    }
+
+    return -1;
+}
+
+static bool readTestFile(const string& filename, string& data)
+{
+    ifstream ifs(filename, std::ios::binary);
+    stringstream ss;
+
+    if(!ifs)
+    {
+        return false;
+    }
+
+    ss << ifs.rdbuf();
+    data = ss.str();
+    return true;
+}
+
+static bool writeTestFile(const string& filename, const string& data)
+{
+    ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+
+    if(!ofs)
+    {
+        return false;
+    }
+
+    ofs.write(data.data(), data.size());
+    ofs.close();
+    return (bool)ofs;
+}
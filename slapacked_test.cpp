@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+// File: slapacked_test.cpp
+//
+// Tests the packed binary .sla reader against the XML one. Both .sla files
+// must be compiled from the same .slaspec, the packed one by Ghidra 11.1 or
+// later, and have to give the same registers, constructors and bit patterns
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include "sla_test.h"
+#include "slautil/slareader.h"
+using namespace std;
+
+static bool isPackedSlaFile(const string& filename);
+
+int main(int argc, char* argv[])
+{
+    Slautil xmlSla;
+    Slautil packedSla;
+    string xmlOutput;
+    string packedOutput;
+    istringstream xmlLines;
+    istringstream packedLines;
+    string xmlLine;
+    string packedLine;
+    unsigned int lineNum = 0;
+
+    if(argc != 3)
+    {
+        cout << "Usage: " << argv[0] << " <xml.sla> <packed.sla>" << endl;
+        return -1;
+    }
+
+    if(!isPackedSlaFile(argv[2]))
+    {
+        cout << "[-] " << argv[2] << " isn't a packed .sla" << endl;
+        return -1;
+    }
+
+    if(xmlSla.loadSla(argv[1]) != SLA_SUCCESS ||
+       getSlaTestOutput(xmlSla, xmlOutput) != SLA_SUCCESS)
+    {
+        cout << "[-] Failed to load " << argv[1] << endl;
+        return -1;
+    }
+
+    if(packedSla.loadSla(argv[2]) != SLA_SUCCESS ||
+       getSlaTestOutput(packedSla, packedOutput) != SLA_SUCCESS)
+    {
+        cout << "[-] Failed to load " << argv[2] << endl;
+        return -1;
+    }
+
+    if(xmlOutput == packedOutput)
+    {
+        cout << "[+] " << argv[2] << " matches " << argv[1] << endl;
+        return 0;
+    }
+
+    // show where the readers disagree
+    xmlLines.str(xmlOutput);
+    packedLines.str(packedOutput);
+
+    while(true)
+    {
+        bool xmlRead = (bool)getline(xmlLines, xmlLine);
+        bool packedRead = (bool)getline(packedLines, packedLine);
+
+        lineNum++;
+
+        if(!xmlRead || !packedRead || xmlLine != packedLine)
+        {
+            cout << "[-] " << argv[2] << " doesn't match " << argv[1] << " at line " << lineNum << endl;
+            cout << "      xml:    " << (xmlRead ? xmlLine : "<end>") << endl;
+            cout << "      packed: " << (packedRead ? packedLine : "<end>") << endl;
+            break;
+        }
+    }
+
+    return -1;
+}
+
+// packed .sla files start with "sla" and the format version
+static bool isPackedSlaFile(const string& filename)
+{
+    ifstream ifs(filename, std::ios::binary);
+    char header[SLA_PACKED_HEADER_SIZE] = {};
+
+    if(!ifs.read(header, sizeof(header)))
+    {
+        return false;
+    }
+
+    return header[0] == 's' && header[1] == 'l' && header[2] == 'a' &&
+           header[3] == SLA_PACKED_FORMAT_VERSION;
+}
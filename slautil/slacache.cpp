@@ -0,0 +1,762 @@
+//-----------------------------------------------------------------------------
+// File: slacache.cpp
+//
+// Caching the parsed state of a .sla file in a binary sidecar file
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "slacache.h"
+
+using namespace std;
+
+// read position in a mapped cache file. Every read is bounds checked so a
+// truncated cache fails to load, the tables it holds are range checked by
+// validateCache() once they are decoded
+typedef struct _SLA_CACHE_READER
+{
+    const char* data;
+    size_t size;
+    size_t pos;
+} SLA_CACHE_READER, *PSLA_CACHE_READER;
+
+// maps a whole file read only. Returns NULL if the file can't be mapped
+static const char* mapSlaCacheFile(const string& filename, size_t& size);
+static bool checkCacheTokenField(const TOKENFIELD& bitfield, unsigned int width);
+
+static void writeCacheUInt(string& buffer, unsigned long long value);
+static void writeCacheString(string& buffer, const string& value);
+static void writeCacheTokenField(string& buffer, const TOKENFIELD& bitfield);
+template <typename T>
+static void writeCacheArray(string& buffer, const vector<T>& values);
+
+static bool readCacheUInt(SLA_CACHE_READER& reader, unsigned long long& value);
+static bool readCacheUInt(SLA_CACHE_READER& reader, unsigned int& value);
+static bool readCacheString(SLA_CACHE_READER& reader, string& value);
+static bool readCacheTokenField(SLA_CACHE_READER& reader, TOKENFIELD& bitfield);
+template <typename T>
+static bool readCacheArray(SLA_CACHE_READER& reader, vector<T>& values);
+
+// Loads the processor module from its cache file (filename + SLA_CACHE_EXTENSION)
+// if the cache was created from the same .sla contents. Otherwise the .sla
+// is parsed and the cache is (re)written for the next run
+int Slautil::loadSlaCached(const string& filename)
+{
+    string cache_filename = filename + SLA_CACHE_EXTENSION;
+    unsigned long long sla_hash = 0;
+    const char* sla_data = NULL;
+    size_t sla_size = 0;
+    int status = 0;
+
+    sla_data = mapSlaCacheFile(filename, sla_size);
+    if(sla_data == NULL)
+    {
+        // let loadSla report the error
+        return this->loadSla(filename);
+    }
+
+    sla_hash = hashSlaFile(sla_data, sla_size);
+    munmap((void*)sla_data, sla_size);
+
+    status = this->loadCache(cache_filename, sla_size, sla_hash);
+    if(status == SLA_SUCCESS)
+    {
+        // the operand tables are derived from the cached state
+        status = this->buildConstructorTables();
+        if(status != SLA_SUCCESS)
+        {
+            return status;
+        }
+
+        m_initialized = true;
+        return SLA_SUCCESS;
+    }
+
+    status = this->loadSla(filename);
+    if(status != SLA_SUCCESS)
+    {
+        return status;
+    }
+
+    // a missing cache only costs time, don't fail the load over it
+    if(this->saveCache(cache_filename, sla_size, sla_hash) != SLA_SUCCESS)
+    {
+        cout << "[-] Failed to write sla cache (" << cache_filename << ")" << endl;
+    }
+
+    return SLA_SUCCESS;
+}
+
+// serializes everything loadSla parsed into cache_filename
+// the cache is written to a temporary file first and renamed into place so
+// concurrent loads never see a partial cache
+int Slautil::saveCache(const string& cache_filename,
+                       unsigned long long sla_size,
+                       unsigned long long sla_hash)
+{
+    SLA_CACHE_HEADER header = {};
+    string buffer;
+    string temp_filename;
+    ofstream ofs;
+
+    memcpy(header.magic, SLA_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SLA_CACHE_VERSION;
+    header.decision_pair_size = sizeof(DECISION_PAIR);
+    header.constructor_mask_size = sizeof(CONSTRUCTOR_MASK);
+    header.decision_node_size = sizeof(DECISION_NODE);
+    header.sla_size = sla_size;
+    header.sla_hash = sla_hash;
+
+    buffer.append((const char*)&header, sizeof(header));
+
+    writeCacheUInt(buffer, m_sleigh_version);
+    writeCacheUInt(buffer, m_constructor_count);
+
+    writeCacheUInt(buffer, m_vars.size());
+    for(auto& var: m_vars)
+    {
+        writeCacheUInt(buffer, var.first);
+        writeCacheString(buffer, var.second);
+    }
+
+    writeCacheUInt(buffer, m_subsyms.size());
+    for(auto& subsym: m_subsyms)
+    {
+        writeCacheUInt(buffer, subsym.first);
+        writeCacheUInt(buffer, subsym.second);
+    }
+
+    writeCacheUInt(buffer, m_operand_syms.size());
+    for(auto& operand_sym: m_operand_syms)
+    {
+        writeCacheUInt(buffer, operand_sym.second.id);
+        writeCacheTokenField(buffer, operand_sym.second.bitfield);
+    }
+
+    writeCacheUInt(buffer, m_varlist_syms.size());
+    for(auto& varlist: m_varlist_syms)
+    {
+        writeCacheUInt(buffer, varlist.second.id);
+        writeCacheTokenField(buffer, varlist.second.bitfield);
+        writeCacheArray(buffer, varlist.second.register_ids);
+    }
+
+    writeCacheUInt(buffer, m_constructors.size());
+    for(auto& constructor: m_constructors)
+    {
+        writeCacheUInt(buffer, constructor.id);
+        writeCacheUInt(buffer, constructor.constructor_length);
+        writeCacheUInt(buffer, constructor.source_file);
+        writeCacheUInt(buffer, constructor.line_number);
+
+        writeCacheUInt(buffer, constructor.constructor_pieces.size());
+        for(auto& piece: constructor.constructor_pieces)
+        {
+            writeCacheString(buffer, piece.type);
+            writeCacheUInt(buffer, piece.id);
+            writeCacheString(buffer, piece.part);
+        }
+
+        writeCacheUInt(buffer, constructor.bit_patterns.size());
+        for(auto& bit_pattern: constructor.bit_patterns)
+        {
+            writeCacheUInt(buffer, bit_pattern.start_bit);
+            writeCacheUInt(buffer, bit_pattern.end_bit);
+            writeCacheString(buffer, bit_pattern.pattern_type);
+            writeCacheString(buffer, bit_pattern.pattern);
+        }
+    }
+
+    writeCacheArray(buffer, m_decision_pairs);
+    writeCacheArray(buffer, m_constructor_masks);
+    writeCacheArray(buffer, m_decision_nodes);
+    writeCacheArray(buffer, m_decision_ids);
+
+    writeCacheUInt(buffer, m_decision_roots.size());
+    for(auto& root: m_decision_roots)
+    {
+        writeCacheUInt(buffer, root.first);
+        writeCacheUInt(buffer, root.second);
+    }
+
+    writeCacheUInt(buffer, m_registers.size());
+    for(auto& reg: m_registers)
+    {
+        writeCacheString(buffer, reg);
+    }
+
+    // the payload hash covers everything written after the header
+    header.payload_size = buffer.size() - sizeof(header);
+    header.payload_hash = hashSlaFile(buffer.data() + sizeof(header), header.payload_size);
+    buffer.replace(0, sizeof(header), (const char*)&header, sizeof(header));
+
+    temp_filename = cache_filename + "." + to_string(getpid()) + "." + to_string((unsigned long long)this);
+
+    ofs.open(temp_filename, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+    {
+        return -1;
+    }
+
+    ofs.write(buffer.data(), buffer.size());
+    ofs.close();
+    if(!ofs)
+    {
+        remove(temp_filename.c_str());
+        return -1;
+    }
+
+    if(rename(temp_filename.c_str(), cache_filename.c_str()) != 0)
+    {
+        remove(temp_filename.c_str());
+        return -1;
+    }
+
+    return SLA_SUCCESS;
+}
+
+// Loads the state saved by saveCache. The cache file is mapped and decoded
+// in place, the fixed size tables are copied straight out of the mapping
+// Fails if the cache doesn't exist, wasn't created from this .sla or is corrupt
+int Slautil::loadCache(const string& cache_filename,
+                       unsigned long long sla_size,
+                       unsigned long long sla_hash)
+{
+    SLA_CACHE_READER reader = {};
+    SLA_CACHE_HEADER header = {};
+    unsigned long long count = 0;
+    bool valid = false;
+
+    reader.data = mapSlaCacheFile(cache_filename, reader.size);
+    if(reader.data == NULL)
+    {
+        return -1;
+    }
+
+    if(reader.size < sizeof(header))
+    {
+        munmap((void*)reader.data, reader.size);
+        return -1;
+    }
+
+    memcpy(&header, reader.data, sizeof(header));
+    reader.pos = sizeof(header);
+
+    if(memcmp(header.magic, SLA_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+       header.version != SLA_CACHE_VERSION ||
+       header.decision_pair_size != sizeof(DECISION_PAIR) ||
+       header.constructor_mask_size != sizeof(CONSTRUCTOR_MASK) ||
+       header.decision_node_size != sizeof(DECISION_NODE) ||
+       header.sla_size != sla_size ||
+       header.sla_hash != sla_hash)
+    {
+        munmap((void*)reader.data, reader.size);
+        return -1;
+    }
+
+    // a damaged cache never gets decoded
+    if(header.payload_size != reader.size - sizeof(header) ||
+       header.payload_hash != hashSlaFile(reader.data + sizeof(header), header.payload_size))
+    {
+        goto ERROR_EXIT;
+    }
+
+    if(!readCacheUInt(reader, m_sleigh_version) ||
+       !readCacheUInt(reader, m_constructor_count))
+    {
+        goto ERROR_EXIT;
+    }
+
+    if(!readCacheUInt(reader, count))
+    {
+        goto ERROR_EXIT;
+    }
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        unsigned int id = 0;
+        string name;
+
+        if(!readCacheUInt(reader, id) || !readCacheString(reader, name))
+        {
+            goto ERROR_EXIT;
+        }
+        m_vars.emplace(id, std::move(name));
+    }
+
+    if(!readCacheUInt(reader, count))
+    {
+        goto ERROR_EXIT;
+    }
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        unsigned int id = 0;
+        unsigned int subsym = 0;
+
+        if(!readCacheUInt(reader, id) || !readCacheUInt(reader, subsym))
+        {
+            goto ERROR_EXIT;
+        }
+        m_subsyms[id] = subsym;
+    }
+
+    if(!readCacheUInt(reader, count))
+    {
+        goto ERROR_EXIT;
+    }
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        OPERAND_SYM operand_sym = {};
+
+        if(!readCacheUInt(reader, operand_sym.id) ||
+           !readCacheTokenField(reader, operand_sym.bitfield))
+        {
+            goto ERROR_EXIT;
+        }
+        m_operand_syms[operand_sym.id] = operand_sym;
+    }
+
+    if(!readCacheUInt(reader, count))
+    {
+        goto ERROR_EXIT;
+    }
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        varlist_sym varlist = {};
+
+        if(!readCacheUInt(reader, varlist.id) ||
+           !readCacheTokenField(reader, varlist.bitfield) ||
+           !readCacheArray(reader, varlist.register_ids))
+        {
+            goto ERROR_EXIT;
+        }
+        m_varlist_syms[varlist.id] = std::move(varlist);
+    }
+
+    if(!readCacheUInt(reader, count) || count > reader.size)
+    {
+        goto ERROR_EXIT;
+    }
+    m_constructors.resize(count);
+    for(auto& constructor: m_constructors)
+    {
+        if(!readCacheUInt(reader, constructor.id) ||
+           !readCacheUInt(reader, constructor.constructor_length) ||
+           !readCacheUInt(reader, constructor.source_file) ||
+           !readCacheUInt(reader, constructor.line_number) ||
+           !readCacheUInt(reader, count) ||
+           count > reader.size)
+        {
+            goto ERROR_EXIT;
+        }
+
+        constructor.constructor_pieces.resize(count);
+        for(auto& piece: constructor.constructor_pieces)
+        {
+            if(!readCacheString(reader, piece.type) ||
+               !readCacheUInt(reader, piece.id) ||
+               !readCacheString(reader, piece.part))
+            {
+                goto ERROR_EXIT;
+            }
+        }
+
+        if(!readCacheUInt(reader, count) || count > reader.size)
+        {
+            goto ERROR_EXIT;
+        }
+
+        constructor.bit_patterns.resize(count);
+        for(auto& bit_pattern: constructor.bit_patterns)
+        {
+            if(!readCacheUInt(reader, bit_pattern.start_bit) ||
+               !readCacheUInt(reader, bit_pattern.end_bit) ||
+               !readCacheString(reader, bit_pattern.pattern_type) ||
+               !readCacheString(reader, bit_pattern.pattern))
+            {
+                goto ERROR_EXIT;
+            }
+        }
+    }
+
+    if(!readCacheArray(reader, m_decision_pairs) ||
+       !readCacheArray(reader, m_constructor_masks) ||
+       !readCacheArray(reader, m_decision_nodes) ||
+       !readCacheArray(reader, m_decision_ids))
+    {
+        goto ERROR_EXIT;
+    }
+
+    if(!readCacheUInt(reader, count))
+    {
+        goto ERROR_EXIT;
+    }
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        unsigned int length = 0;
+        unsigned int node = 0;
+
+        if(!readCacheUInt(reader, length) || !readCacheUInt(reader, node))
+        {
+            goto ERROR_EXIT;
+        }
+        m_decision_roots[length] = node;
+    }
+
+    if(!readCacheUInt(reader, count) || count > reader.size)
+    {
+        goto ERROR_EXIT;
+    }
+    m_registers.resize(count);
+    for(auto& reg: m_registers)
+    {
+        if(!readCacheString(reader, reg))
+        {
+            goto ERROR_EXIT;
+        }
+    }
+
+    // the payload hash only catches accidental damage, the tables are
+    // indexed without bounds checks later on so check them as well
+    valid = (reader.pos == reader.size && this->validateCache() == SLA_SUCCESS);
+
+ERROR_EXIT:
+    munmap((void*)reader.data, reader.size);
+
+    if(!valid)
+    {
+        // don't leave a partially loaded state behind, the .sla gets parsed
+        // from scratch
+        cout << "[-] Ignoring corrupt sla cache (" << cache_filename << ")" << endl;
+        *this = Slautil();
+        return -1;
+    }
+
+    return SLA_SUCCESS;
+}
+
+// Range checks the decoded cache. Every id that is used as an index later on
+// has to be inside its table and every token field inside the opcode of the
+// constructors it is printed with. The decision index must only point
+// forward so a lookup can't loop
+int Slautil::validateCache(void)
+{
+    unsigned int max_width = 0;
+
+    if(m_constructors.size() != m_constructor_count ||
+       m_decision_pairs.size() != m_constructor_count ||
+       m_constructor_masks.size() != m_constructor_count)
+    {
+        return -1;
+    }
+
+    for(auto& decision_pair: m_decision_pairs)
+    {
+        if(decision_pair.id >= m_constructor_count)
+        {
+            return -1;
+        }
+    }
+
+    for(auto& constructor: m_constructors)
+    {
+        unsigned int width = 0;
+
+        for(auto& bit_pattern: constructor.bit_patterns)
+        {
+            // the pattern string holds one character per bit so the bit
+            // pattern built by buildConstructorTables() can't be larger than
+            // the cache
+            if(bit_pattern.start_bit > bit_pattern.end_bit ||
+               bit_pattern.pattern.size() != (unsigned long long)bit_pattern.end_bit - bit_pattern.start_bit + 1)
+            {
+                return -1;
+            }
+
+            if(bit_pattern.pattern_type == "opcode" ||
+               bit_pattern.pattern_type == "reg" ||
+               bit_pattern.pattern_type == "imm")
+            {
+                width += bit_pattern.pattern.size();
+            }
+        }
+
+        for(auto& piece: constructor.constructor_pieces)
+        {
+            boost::unordered_map<unsigned int, varlist_sym>::iterator itr;
+            boost::unordered_map<unsigned int, OPERAND_SYM>::iterator itr2;
+
+            if(piece.type != "opprint")
+            {
+                continue;
+            }
+
+            itr = m_varlist_syms.find(piece.id);
+            itr2 = m_operand_syms.find(piece.id);
+
+            if(itr != m_varlist_syms.end() &&
+               !checkCacheTokenField(itr->second.bitfield, width))
+            {
+                return -1;
+            }
+
+            if(itr == m_varlist_syms.end() &&
+               itr2 != m_operand_syms.end() &&
+               !checkCacheTokenField(itr2->second.bitfield, width))
+            {
+                return -1;
+            }
+        }
+
+        max_width = max(max_width, width);
+    }
+
+    for(auto& operand_sym: m_operand_syms)
+    {
+        if(!checkCacheTokenField(operand_sym.second.bitfield, max_width))
+        {
+            return -1;
+        }
+    }
+
+    for(auto& varlist: m_varlist_syms)
+    {
+        if(!checkCacheTokenField(varlist.second.bitfield, max_width))
+        {
+            return -1;
+        }
+
+        for(auto register_id: varlist.second.register_ids)
+        {
+            if(m_vars.find(register_id) == m_vars.end())
+            {
+                return -1;
+            }
+        }
+    }
+
+    for(auto& constructor_mask: m_constructor_masks)
+    {
+        if(constructor_mask.length > 64)
+        {
+            return -1;
+        }
+    }
+
+    for(unsigned int i = 0; i < m_decision_nodes.size(); i++)
+    {
+        const DECISION_NODE& node = m_decision_nodes[i];
+
+        if(node.size == 0)
+        {
+            if((unsigned long long)node.first + node.count > m_decision_ids.size())
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        // children are always added after their parent
+        if(node.size > DECISION_WINDOW_BITS ||
+           node.shift + node.size > 64 ||
+           node.first <= i ||
+           (unsigned long long)node.first + (1ULL << node.size) > m_decision_nodes.size())
+        {
+            return -1;
+        }
+    }
+
+    for(auto id: m_decision_ids)
+    {
+        if(id >= m_constructor_masks.size())
+        {
+            return -1;
+        }
+    }
+
+    for(auto& root: m_decision_roots)
+    {
+        if(root.first > 64 || root.second >= m_decision_nodes.size())
+        {
+            return -1;
+        }
+    }
+
+    return SLA_SUCCESS;
+}
+
+static const char* mapSlaCacheFile(const string& filename, size_t& size)
+{
+    struct stat st = {};
+    void* data = NULL;
+    int fd = 0;
+
+    fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    size = st.st_size;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    return (const char*)data;
+}
+
+// 64 bit hash of the .sla or cache contents, 8 bytes at a time
+unsigned long long hashSlaFile(const char* data, size_t size)
+{
+    unsigned long long hash = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+
+    for(i = 0; i + sizeof(unsigned long long) <= size; i += sizeof(unsigned long long))
+    {
+        unsigned long long word = 0;
+
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+
+    for(; i < size; i++)
+    {
+        hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+    }
+
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// a token field of a cache is only used if it fits in width opcode bits
+static bool checkCacheTokenField(const TOKENFIELD& bitfield, unsigned int width)
+{
+    return bitfield.startbit <= bitfield.endbit &&
+           bitfield.endbit < width &&
+           bitfield.startbyte <= bitfield.endbyte;
+}
+
+// integers are stored as 8 bytes in native byte order, the cache is only
+// meant to be read back on the same machine
+static void writeCacheUInt(string& buffer, unsigned long long value)
+{
+    buffer.append((const char*)&value, sizeof(value));
+}
+
+static void writeCacheString(string& buffer, const string& value)
+{
+    writeCacheUInt(buffer, value.size());
+    buffer.append(value);
+}
+
+static void writeCacheTokenField(string& buffer, const TOKENFIELD& bitfield)
+{
+    writeCacheUInt(buffer, bitfield.bigendian);
+    writeCacheUInt(buffer, bitfield.signbit);
+    writeCacheUInt(buffer, bitfield.startbit);
+    writeCacheUInt(buffer, bitfield.endbit);
+    writeCacheUInt(buffer, bitfield.startbyte);
+    writeCacheUInt(buffer, bitfield.endbyte);
+    writeCacheUInt(buffer, bitfield.shift);
+}
+
+// fixed size tables are stored as the raw array
+template <typename T>
+static void writeCacheArray(string& buffer, const vector<T>& values)
+{
+    writeCacheUInt(buffer, values.size());
+    buffer.append((const char*)values.data(), values.size() * sizeof(T));
+}
+
+static bool readCacheUInt(SLA_CACHE_READER& reader, unsigned long long& value)
+{
+    if(reader.size - reader.pos < sizeof(value))
+    {
+        return false;
+    }
+
+    memcpy(&value, reader.data + reader.pos, sizeof(value));
+    reader.pos += sizeof(value);
+    return true;
+}
+
+static bool readCacheUInt(SLA_CACHE_READER& reader, unsigned int& value)
+{
+    unsigned long long temp = 0;
+
+    if(!readCacheUInt(reader, temp))
+    {
+        return false;
+    }
+
+    value = temp;
+    return true;
+}
+
+static bool readCacheString(SLA_CACHE_READER& reader, string& value)
+{
+    unsigned long long length = 0;
+
+    if(!readCacheUInt(reader, length) || reader.size - reader.pos < length)
+    {
+        return false;
+    }
+
+    value.assign(reader.data + reader.pos, length);
+    reader.pos += length;
+    return true;
+}
+
+static bool readCacheTokenField(SLA_CACHE_READER& reader, TOKENFIELD& bitfield)
+{
+    unsigned int bigendian = 0;
+    unsigned int signbit = 0;
+
+    if(!readCacheUInt(reader, bigendian) ||
+       !readCacheUInt(reader, signbit) ||
+       !readCacheUInt(reader, bitfield.startbit) ||
+       !readCacheUInt(reader, bitfield.endbit) ||
+       !readCacheUInt(reader, bitfield.startbyte) ||
+       !readCacheUInt(reader, bitfield.endbyte) ||
+       !readCacheUInt(reader, bitfield.shift))
+    {
+        return false;
+    }
+
+    bitfield.bigendian = bigendian;
+    bitfield.signbit = signbit;
+    return true;
+}
+
+template <typename T>
+static bool readCacheArray(SLA_CACHE_READER& reader, vector<T>& values)
+{
+    unsigned long long count = 0;
+
+    if(!readCacheUInt(reader, count) ||
+       count > (reader.size - reader.pos) / sizeof(T))
+    {
+        return false;
+    }
+
+    values.resize(count);
+    memcpy((void*)values.data(), reader.data + reader.pos, count * sizeof(T));
+    reader.pos += count * sizeof(T);
+    return true;
+}
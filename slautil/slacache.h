@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// File: slacache.h
+//
+// Layout of the binary sidecar file Slautil::loadSlaCached() keeps
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "slautil.h"
+
+// identifies a cache file. Bump SLA_CACHE_VERSION whenever the layout or the
+// parsed state of Slautil changes
+#define SLA_CACHE_MAGIC "SLACACHE"
+#define SLA_CACHE_VERSION 2
+
+typedef struct _SLA_CACHE_HEADER
+{
+    char magic[8];
+    unsigned int version;
+
+    // sizes of the structs that are stored as raw arrays, so a cache written
+    // by a different build isn't misread
+    unsigned int decision_pair_size;
+    unsigned int constructor_mask_size;
+    unsigned int decision_node_size;
+
+    // the .sla the cache was created from
+    unsigned long long sla_size;
+    unsigned long long sla_hash;
+
+    // everything after the header, checked before anything is decoded
+    unsigned long long payload_size;
+    unsigned long long payload_hash;
+} SLA_CACHE_HEADER, *PSLA_CACHE_HEADER;
+
+// 64 bit hash used for both the .sla and the cache payload
+unsigned long long hashSlaFile(const char* data, size_t size);
@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+// File: slaindex.cpp
+//
+// Index over multiple loaded .sla files
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include "slaindex.h"
+
+using namespace std;
+
+// default constructor
+SlaIndex::SlaIndex(void)
+{
+}
+
+// Adds the constructors of a loaded .sla file to the index. Every leading bit
+// value a constructor can match is mapped to sla_id. Unfixed leading bits are
+// enumerated, which is cheap since shards normally fix all of them
+int SlaIndex::addSla(Slautil& sla, unsigned int sla_id)
+{
+    unsigned int count = 0;
+    int result = 0;
+
+    result = sla.getConstructorCount(count);
+    if(result != SLA_SUCCESS)
+    {
+        return result;
+    }
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        CONSTRUCTOR_MASK constructor_mask;
+        unsigned int prefix_bits = 0;
+        unsigned long long prefix_mask = 0;
+        unsigned long long prefix_value = 0;
+        unsigned long long unfixed = 0;
+        unsigned long long sub = 0;
+
+        result = sla.getConstructorMask(i, constructor_mask);
+        if(result != SLA_SUCCESS || constructor_mask.length == 0)
+        {
+            // constructors without a mask never match a bit pattern of 64
+            // bits or less, longer bit patterns always get m_all_slas
+            continue;
+        }
+
+        prefix_bits = min((unsigned int)SLA_INDEX_PREFIX_BITS, constructor_mask.length);
+        prefix_mask = constructor_mask.mask >> (constructor_mask.length - prefix_bits);
+        prefix_value = constructor_mask.value >> (constructor_mask.length - prefix_bits);
+        unfixed = ~prefix_mask & ((1ULL << prefix_bits) - 1);
+
+        // walk every subset of the unfixed bits
+        sub = unfixed;
+        while(true)
+        {
+            unsigned long long key = ((unsigned long long)constructor_mask.length << 32) | prefix_value | sub;
+            vector<unsigned int>& slas = m_candidates[key];
+
+            // .sla files are added in order, so only the last entry can be
+            // this one
+            if(slas.size() == 0 || slas.back() != sla_id)
+            {
+                slas.push_back(sla_id);
+            }
+
+            if(sub == 0)
+            {
+                break;
+            }
+            sub = (sub - 1) & unfixed;
+        }
+    }
+
+    m_all_slas.push_back(sla_id);
+    return SLA_SUCCESS;
+}
+
+// removes all .sla files from the index
+void SlaIndex::clear(void)
+{
+    m_candidates.clear();
+    m_all_slas.clear();
+}
+
+// Returns the ids of the .sla files with a constructor that can match
+// bit_pattern. Bit patterns with combined fields in the leading bits or
+// longer than 64 bits return every .sla file
+const vector<unsigned int>& SlaIndex::getCandidateSlas(const string& bit_pattern)
+{
+    boost::unordered_map<unsigned long long, vector<unsigned int>>::iterator itr;
+    unsigned int prefix_bits = 0;
+    unsigned long long key = 0;
+
+    if(bit_pattern.size() == 0 || bit_pattern.size() > 64)
+    {
+        return m_all_slas;
+    }
+
+    prefix_bits = min((unsigned int)SLA_INDEX_PREFIX_BITS, (unsigned int)bit_pattern.size());
+
+    for(unsigned int i = 0; i < prefix_bits; i++)
+    {
+        if(bit_pattern[i] == '1')
+        {
+            key = (key << 1) | 1;
+        }
+        else if(bit_pattern[i] == '0')
+        {
+            key = key << 1;
+        }
+        else
+        {
+            return m_all_slas;
+        }
+    }
+
+    key |= (unsigned long long)bit_pattern.size() << 32;
+
+    itr = m_candidates.find(key);
+    if(itr == m_candidates.end())
+    {
+        return m_no_slas;
+    }
+
+    return itr->second;
+}
@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+// File: slaindex.h
+//
+// Index over multiple loaded .sla files
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <vector>
+#include "slautil.h"
+
+using namespace std;
+
+// number of leading opcode bits the index is keyed on. Shards of a 4 byte ISA
+// differ in their top byte
+#define SLA_INDEX_PREFIX_BITS 8
+
+// Maps the leading bits of an opcode to the .sla files that have at least one
+// constructor that can match it. Lets a lookup across many shard .sla files
+// go straight to the shard(s) that cover the opcode instead of trying each one
+class SlaIndex
+{
+    public:
+        SlaIndex();
+
+        // .sla files must be added in the same order as they are stored
+        int addSla(Slautil& sla, unsigned int sla_id);
+        void clear(void);
+
+        // ids of the .sla files that can match bit_pattern, in load order
+        const vector<unsigned int>& getCandidateSlas(const string& bit_pattern);
+
+    private:
+        // key = bit pattern length << 32 | leading bits
+        boost::unordered_map<unsigned long long, vector<unsigned int>> m_candidates;
+
+        // returned for bit patterns the index can't key on
+        vector<unsigned int> m_all_slas;
+
+        // returned when no .sla file can match
+        vector<unsigned int> m_no_slas;
+};
@@ -0,0 +1,581 @@
+//-----------------------------------------------------------------------------
+// File: slapacked.cpp
+//
+// Reading packed binary .sla files
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "slareader.h"
+
+using namespace std;
+
+// Ghidra's packed encoding, see PackedFormat in marshal.hh
+#define PACKED_HEADER_MASK 0xc0
+#define PACKED_ELEMENT_START 0x40
+#define PACKED_ELEMENT_END 0x80
+#define PACKED_ATTRIBUTE 0xc0
+#define PACKED_HEADEREXTEND_MASK 0x20
+#define PACKED_ELEMENTID_MASK 0x1f
+#define PACKED_RAWDATA_MASK 0x7f
+#define PACKED_RAWDATA_BITSPERBYTE 7
+#define PACKED_TYPECODE_SHIFT 4
+#define PACKED_LENGTHCODE_MASK 0xf
+
+// attribute value types
+#define PACKED_TYPECODE_BOOLEAN 1
+#define PACKED_TYPECODE_SIGNEDINT_POSITIVE 2
+#define PACKED_TYPECODE_SIGNEDINT_NEGATIVE 3
+#define PACKED_TYPECODE_UNSIGNEDINT 4
+#define PACKED_TYPECODE_ADDRESSSPACE 5
+#define PACKED_TYPECODE_SPECIALSPACE 6
+#define PACKED_TYPECODE_STRING 7
+
+// element ids of the .sla format, see sla::ELEM_* in slaformat.cc
+static const char* g_slaElementNames[] = {
+    NULL,                  // 0
+    "const_real",          // 1
+    "varnode_tpl",         // 2
+    "const_spaceid",       // 3
+    "const_handle",        // 4
+    "op_tpl",              // 5
+    "mask_word",           // 6
+    "pat_block",           // 7
+    "print",               // 8
+    "pair",                // 9
+    "context_pat",         // 10
+    "null",                // 11
+    "operand_exp",         // 12
+    "operand_sym",         // 13
+    "operand_sym_head",    // 14
+    "oper",                // 15
+    "decision",            // 16
+    "opprint",             // 17
+    "instruct_pat",        // 18
+    "combine_pat",         // 19
+    "constructor",         // 20
+    "construct_tpl",       // 21
+    "scope",               // 22
+    "varnode_sym",         // 23
+    "varnode_sym_head",    // 24
+    "userop",              // 25
+    "userop_head",         // 26
+    "tokenfield",          // 27
+    "var",                 // 28
+    "contextfield",        // 29
+    "handle_tpl",          // 30
+    "const_relative",      // 31
+    "context_op",          // 32
+    "sleigh",              // 33
+    "spaces",              // 34
+    "sourcefiles",         // 35
+    "sourcefile",          // 36
+    "space",               // 37
+    "symbol_table",        // 38
+    "value_sym",           // 39
+    "value_sym_head",      // 40
+    "context_sym",         // 41
+    "context_sym_head",    // 42
+    "end_sym",             // 43
+    "end_sym_head",        // 44
+    "space_other",         // 45
+    "space_unique",        // 46
+    "and_exp",             // 47
+    "div_exp",             // 48
+    "lshift_exp",          // 49
+    "minus_exp",           // 50
+    "mult_exp",            // 51
+    "not_exp",             // 52
+    "or_exp",              // 53
+    "plus_exp",            // 54
+    "rshift_exp",          // 55
+    "sub_exp",             // 56
+    "xor_exp",             // 57
+    "intb",                // 58
+    "end_exp",             // 59
+    "next2_exp",           // 60
+    "start_exp",           // 61
+    "epsilon_sym",         // 62
+    "epsilon_sym_head",    // 63
+    "name_sym",            // 64
+    "name_sym_head",       // 65
+    "nametab",             // 66
+    "next2_sym",           // 67
+    "next2_sym_head",      // 68
+    "start_sym",           // 69
+    "start_sym_head",      // 70
+    "subtable_sym",        // 71
+    "subtable_sym_head",   // 72
+    "valuemap_sym",        // 73
+    "valuemap_sym_head",   // 74
+    "valuetab",            // 75
+    "varlist_sym",         // 76
+    "varlist_sym_head",    // 77
+    "or_pat",              // 78
+    "commit",              // 79
+    "const_start",         // 80
+    "const_next",          // 81
+    "const_next2",         // 82
+    "const_curspace",      // 83
+    "const_curspace_size", // 84
+    "const_flowref",       // 85
+    "const_flowref_size",  // 86
+    "const_flowdest",      // 87
+    "const_flowdest_size", // 88
+};
+
+// attribute ids of the .sla format, see sla::ATTRIB_* in slaformat.cc
+static const char* g_slaAttributeNames[] = {
+    NULL,           // 0
+    NULL,           // 1, reserved
+    "val",          // 2
+    "id",           // 3
+    "space",        // 4
+    "s",            // 5
+    "off",          // 6
+    "code",         // 7
+    "mask",         // 8
+    "index",        // 9
+    "nonzero",      // 10
+    "piece",        // 11
+    "name",         // 12
+    "scope",        // 13
+    "startbit",     // 14
+    "size",         // 15
+    "table",        // 16
+    "ct",           // 17
+    "minlen",       // 18
+    "base",         // 19
+    "number",       // 20
+    "context",      // 21
+    "parent",       // 22
+    "subsym",       // 23
+    "line",         // 24
+    "source",       // 25
+    "length",       // 26
+    "first",        // 27
+    "plus",         // 28
+    "shift",        // 29
+    "endbit",       // 30
+    "signbit",      // 31
+    "endbyte",      // 32
+    "startbyte",    // 33
+    "version",      // 34
+    "bigendian",    // 35
+    "align",        // 36
+    "uniqbase",     // 37
+    "maxdelay",     // 38
+    "uniqmask",     // 39
+    "numsections",  // 40
+    "defaultspace", // 41
+    "delay",        // 42
+    "wordsize",     // 43
+    "physical",     // 44
+    "scopesize",    // 45
+    "symbolsize",   // 46
+    "varnode",      // 47
+    "low",          // 48
+    "high",         // 49
+    "flow",         // 50
+    "contain",      // 51
+    "i",            // 52
+    "numct",        // 53
+    "section",      // 54
+    "labels",       // 55
+};
+
+// names of the special address spaces, see PackedFormat::SPECIALSPACE_*
+static const char* g_slaSpecialSpaceNames[] = {"stack",
+                                               "join",
+                                               "fspec",
+                                               "iop",
+                                               "spacebase"};
+
+static int readPackedId(SLA_XML_READER& reader,
+                        size_t& offset,
+                        unsigned int& id);
+static int readPackedInteger(SLA_XML_READER& reader,
+                             size_t& offset,
+                             unsigned int length,
+                             unsigned long long& value);
+static int readPackedAttribute(SLA_XML_READER& reader,
+                               size_t& offset,
+                               SLA_XML_TAG& tag);
+static string getPackedName(const char* names[],
+                            size_t count,
+                            unsigned int id,
+                            const char* prefix);
+
+// Checks for the packed binary header. If it is there the rest of the file is
+// decompressed as it is read. Otherwise the file is rewound to be read as XML
+// Returns 1 if the file is packed, 0 if it isn't and -1 on error
+int openSlaPacked(SLA_XML_READER& reader)
+{
+    char header[SLA_PACKED_HEADER_SIZE] = {};
+
+    reader.is_packed = false;
+    reader.zstream_initialized = false;
+    reader.corrupt = false;
+
+    reader.ifs.read(header, sizeof(header));
+    if(reader.ifs.gcount() != sizeof(header) ||
+       header[0] != 's' ||
+       header[1] != 'l' ||
+       header[2] != 'a')
+    {
+        reader.ifs.clear();
+        reader.ifs.seekg(0, std::ios::beg);
+        return 0;
+    }
+
+    if(header[3] != SLA_PACKED_FORMAT_VERSION)
+    {
+        cout << "[-] Invalid packed sla format version (" << (unsigned int)header[3] << ")!" << endl;
+        return -1;
+    }
+
+    memset(&reader.zstream, 0, sizeof(reader.zstream));
+    if(inflateInit(&reader.zstream) != Z_OK)
+    {
+        cout << "[-] Failed to initialize zlib!" << endl;
+        return -1;
+    }
+
+    reader.compressed.resize(SLA_XML_CHUNK_SIZE);
+    reader.zstream_initialized = true;
+    reader.is_packed = true;
+    return 1;
+}
+
+// frees the zlib state of a packed .sla
+void closeSlaPacked(SLA_XML_READER& reader)
+{
+    if(reader.zstream_initialized)
+    {
+        inflateEnd(&reader.zstream);
+        reader.zstream_initialized = false;
+    }
+}
+
+// Decompresses up to size bytes of the packed .sla into dest
+// Returns the number of bytes decompressed, 0 at the end of the data and -1
+// if the data is corrupt
+long readSlaPackedChunk(SLA_XML_READER& reader, char* dest, size_t size)
+{
+    z_stream& zstream = reader.zstream;
+    int result = Z_OK;
+
+    if(reader.zstream_initialized == false)
+    {
+        return 0;
+    }
+
+    zstream.next_out = (Bytef*)dest;
+    zstream.avail_out = size;
+
+    while(zstream.avail_out == size)
+    {
+        if(zstream.avail_in == 0)
+        {
+            reader.ifs.read(reader.compressed.data(), reader.compressed.size());
+            if(reader.ifs.gcount() <= 0)
+            {
+                break;
+            }
+
+            zstream.next_in = (Bytef*)reader.compressed.data();
+            zstream.avail_in = reader.ifs.gcount();
+        }
+
+        result = inflate(&zstream, Z_NO_FLUSH);
+        if(result == Z_STREAM_END)
+        {
+            break;
+        }
+
+        if(result != Z_OK)
+        {
+            cout << "[-] Corrupt packed sla (" << result << ")!" << endl;
+            reader.corrupt = true;
+            return -1;
+        }
+    }
+
+    return size - zstream.avail_out;
+}
+
+// Reads the next start or end element of a packed .sla and converts it to
+// the tag the XML encoder would have written
+// Returns 1 if a tag was read, 0 at the end of the file and -1 on malformed
+// data
+int readSlaPackedTag(SLA_XML_READER& reader, SLA_XML_TAG& tag)
+{
+    size_t offset = 0;
+    unsigned int id = 0;
+    int header = 0;
+
+    tag.name.clear();
+    tag.attributes.clear();
+    tag.is_end = false;
+    tag.is_empty = false;
+
+    header = peekSlaXmlChar(reader, 0);
+    if(header < 0)
+    {
+        return 0;
+    }
+
+    if((header & PACKED_HEADER_MASK) != PACKED_ELEMENT_START &&
+       (header & PACKED_HEADER_MASK) != PACKED_ELEMENT_END)
+    {
+        cout << "[-] Unexpected packed sla header 0x" << std::hex << header << std::dec << endl;
+        return -1;
+    }
+
+    tag.is_end = ((header & PACKED_HEADER_MASK) == PACKED_ELEMENT_END);
+
+    if(readPackedId(reader, offset, id) != 0)
+    {
+        return -1;
+    }
+
+    tag.name = getPackedName(g_slaElementNames,
+                             sizeof(g_slaElementNames)/sizeof(g_slaElementNames[0]),
+                             id,
+                             "element_");
+
+    if(tag.is_end == false)
+    {
+        // attributes directly follow the start of the element
+        while((header = peekSlaXmlChar(reader, offset)) >= 0 &&
+              (header & PACKED_HEADER_MASK) == PACKED_ATTRIBUTE)
+        {
+            if(readPackedAttribute(reader, offset, tag) != 0)
+            {
+                return -1;
+            }
+        }
+    }
+
+    // address spaces are defined before anything references them by index
+    if(tag.name == "space" ||
+       tag.name == "space_other" ||
+       tag.name == "space_unique")
+    {
+        const string* name = NULL;
+        const string* index = NULL;
+
+        for(auto& attribute: tag.attributes)
+        {
+            if(attribute.first == "name")
+            {
+                name = &attribute.second;
+            }
+            else if(attribute.first == "index")
+            {
+                index = &attribute.second;
+            }
+        }
+
+        if(name != NULL && index != NULL)
+        {
+            reader.space_names[strtoul(index->c_str(), NULL, 0)] = *name;
+        }
+    }
+
+    reader.pos += offset;
+    return 1;
+}
+
+// reads the header byte(s) of an element or attribute and returns its id
+static int readPackedId(SLA_XML_READER& reader,
+                        size_t& offset,
+                        unsigned int& id)
+{
+    int header = peekSlaXmlChar(reader, offset);
+
+    if(header < 0)
+    {
+        return -1;
+    }
+    offset++;
+
+    id = header & PACKED_ELEMENTID_MASK;
+    if(header & PACKED_HEADEREXTEND_MASK)
+    {
+        int extension = peekSlaXmlChar(reader, offset);
+
+        if(extension < 0)
+        {
+            return -1;
+        }
+        offset++;
+
+        id = (id << PACKED_RAWDATA_BITSPERBYTE) | (extension & PACKED_RAWDATA_MASK);
+    }
+
+    return 0;
+}
+
+// reads an integer stored as length 7 bit bytes, most significant first
+static int readPackedInteger(SLA_XML_READER& reader,
+                             size_t& offset,
+                             unsigned int length,
+                             unsigned long long& value)
+{
+    value = 0;
+
+    for(unsigned int i = 0; i < length; i++)
+    {
+        int ch = peekSlaXmlChar(reader, offset);
+
+        if(ch < 0)
+        {
+            return -1;
+        }
+        offset++;
+
+        value = (value << PACKED_RAWDATA_BITSPERBYTE) | (ch & PACKED_RAWDATA_MASK);
+    }
+
+    return 0;
+}
+
+// Reads an attribute and adds it to tag as text. Unsigned integers are
+// printed in hex and signed integers in decimal like the XML encoder does,
+// address spaces are printed by name
+static int readPackedAttribute(SLA_XML_READER& reader,
+                               size_t& offset,
+                               SLA_XML_TAG& tag)
+{
+    unsigned long long value = 0;
+    unsigned int id = 0;
+    unsigned int type_code = 0;
+    unsigned int length_code = 0;
+    string name;
+    string text;
+    int type = 0;
+
+    if(readPackedId(reader, offset, id) != 0)
+    {
+        return -1;
+    }
+
+    name = getPackedName(g_slaAttributeNames,
+                         sizeof(g_slaAttributeNames)/sizeof(g_slaAttributeNames[0]),
+                         id,
+                         "attribute_");
+
+    type = peekSlaXmlChar(reader, offset);
+    if(type < 0)
+    {
+        return -1;
+    }
+    offset++;
+
+    type_code = type >> PACKED_TYPECODE_SHIFT;
+    length_code = type & PACKED_LENGTHCODE_MASK;
+
+    switch(type_code)
+    {
+        case PACKED_TYPECODE_BOOLEAN:
+            text = length_code ? "true" : "false";
+            break;
+        case PACKED_TYPECODE_SIGNEDINT_POSITIVE:
+        case PACKED_TYPECODE_SIGNEDINT_NEGATIVE:
+            if(readPackedInteger(reader, offset, length_code, value) != 0)
+            {
+                return -1;
+            }
+
+            text = to_string(value);
+            if(type_code == PACKED_TYPECODE_SIGNEDINT_NEGATIVE)
+            {
+                text = "-" + text;
+            }
+            break;
+        case PACKED_TYPECODE_UNSIGNEDINT:
+        {
+            char hex[32] = {};
+
+            if(readPackedInteger(reader, offset, length_code, value) != 0)
+            {
+                return -1;
+            }
+
+            snprintf(hex, sizeof(hex), "0x%llx", value);
+            text = hex;
+            break;
+        }
+        case PACKED_TYPECODE_ADDRESSSPACE:
+        {
+            boost::unordered_map<unsigned int, string>::iterator itr;
+
+            if(readPackedInteger(reader, offset, length_code, value) != 0)
+            {
+                return -1;
+            }
+
+            itr = reader.space_names.find(value);
+            if(itr == reader.space_names.end())
+            {
+                text = to_string(value);
+            }
+            else
+            {
+                text = itr->second;
+            }
+            break;
+        }
+        case PACKED_TYPECODE_SPECIALSPACE:
+            text = getPackedName(g_slaSpecialSpaceNames,
+                                 sizeof(g_slaSpecialSpaceNames)/sizeof(g_slaSpecialSpaceNames[0]),
+                                 length_code,
+                                 "special_");
+            break;
+        case PACKED_TYPECODE_STRING:
+            if(readPackedInteger(reader, offset, length_code, value) != 0)
+            {
+                return -1;
+            }
+
+            text.reserve(value);
+            for(unsigned long long i = 0; i < value; i++)
+            {
+                int ch = peekSlaXmlChar(reader, offset);
+
+                if(ch < 0)
+                {
+                    return -1;
+                }
+                offset++;
+
+                text.push_back(ch);
+            }
+            break;
+        default:
+            cout << "[-] Unknown packed sla attribute type " << type_code << endl;
+            return -1;
+    }
+
+    tag.attributes.emplace_back(std::move(name), std::move(text));
+    return 0;
+}
+
+// returns names[id] or prefix followed by the id if there is no name for it
+static string getPackedName(const char* names[],
+                            size_t count,
+                            unsigned int id,
+                            const char* prefix)
+{
+    if(id < count && names[id] != NULL)
+    {
+        return names[id];
+    }
+
+    return prefix + to_string(id);
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// File: slareader.h
+//
+// Reading the elements of XML and packed binary .sla files
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <zlib.h>
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <vector>
+#include <fstream>
+
+using namespace std;
+
+// size of the chunks the .sla file is read in
+#define SLA_XML_CHUNK_SIZE (1024 * 1024)
+
+// packed binary .sla files start with "sla" followed by the format version.
+// Everything after the header is zlib compressed
+#define SLA_PACKED_HEADER_SIZE 4
+#define SLA_PACKED_FORMAT_VERSION 4
+
+// a single start or end tag from the .sla. Packed binary elements are
+// converted to the same names and attribute text the XML encoder writes
+typedef struct _SLA_XML_TAG
+{
+    string name;
+    vector<pair<string, string>> attributes;
+    bool is_end; // </name>
+    bool is_empty; // <name/>
+} SLA_XML_TAG, *PSLA_XML_TAG;
+
+// reads the .sla a chunk at a time. Only the tag being parsed has to fit in
+// the buffer
+typedef struct _SLA_XML_READER
+{
+    ifstream ifs;
+    vector<char> buffer;
+    size_t pos; // start of the unread data in buffer
+    size_t end; // end of the valid data in buffer
+
+    // set if the file is in the packed binary format. buffer then holds the
+    // decompressed data
+    bool is_packed;
+    bool zstream_initialized;
+    z_stream zstream;
+    vector<char> compressed;
+    bool corrupt; // set if decompressing failed, the data ends early
+
+    // address space names by index, needed to print space attributes
+    boost::unordered_map<unsigned int, string> space_names;
+} SLA_XML_READER, *PSLA_XML_READER;
+
+int peekSlaXmlChar(SLA_XML_READER& reader, size_t offset);
+int openSlaPacked(SLA_XML_READER& reader);
+void closeSlaPacked(SLA_XML_READER& reader);
+long readSlaPackedChunk(SLA_XML_READER& reader, char* dest, size_t size);
+int readSlaPackedTag(SLA_XML_READER& reader, SLA_XML_TAG& tag);
@@ -6,16 +6,12 @@
 // Copyright (c) Oberoi Security Solutions. All rights reserved.
 // Licensed under the Apache 2.0 License.
 //-----------------------------------------------------------------------------
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
-#include <boost/foreach.hpp>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include "slautil.h"
 
 using namespace std;
-namespace pt = boost::property_tree;
 
 // sorting bit_patterns by start_bit
 struct less_than_key
@@ -33,7 +29,7 @@ Slautil::Slautil(void)
 }
 
 // load the processor module file
-// currently only supports XML .sla files
+// supports XML and packed binary .sla files
 int Slautil::loadSla(const string& filename)
 {
     int status = 0;
@@ -44,6 +40,19 @@ int Slautil::loadSla(const string& filename)
         return status;
     }
 
+    // the decision index is built from the constructor bit patterns
+    status = this->buildConstructorTables();
+    if(status != SLA_SUCCESS)
+    {
+        return status;
+    }
+
+    status = this->buildDecisionIndex();
+    if(status != SLA_SUCCESS)
+    {
+        return status;
+    }
+
     m_initialized = true;
     return SLA_SUCCESS;
 }
@@ -207,48 +216,39 @@ int Slautil::addBitPattern(CONSTRUCTOR& curr_constructor,
 // get the opcode bit pattern given an constructor id
 int Slautil::getConstructorBitPattern(unsigned int id, string& bit_pattern)
 {
-    PCONSTRUCTOR curr_constructor = NULL;
-    unsigned int size = 0;
-
-    if(id >= m_constructors.size())
+    if(id >= m_bit_patterns.size())
     {
         cout << "Bad ID!!" << endl;
         return -2;
     }
 
-    curr_constructor = &m_constructors[id];
-    bit_pattern = "";
+    bit_pattern = m_bit_patterns[id];
 
-    for(unsigned int k = 0; k < curr_constructor->bit_patterns.size(); k++)
+    // sanity check the bit pattern size
+    if(bit_pattern.size() == 0)
     {
-        PBIT_PATTERN curr_bit_pattern = &curr_constructor->bit_patterns[k];
+        return -1;
+    }
 
-        //bit_pattern += curr_bit_pattern->pattern_type + "_" + to_string(curr_bit_pattern->start_bit) + "_" + to_string(curr_bit_pattern->end_bit) + "=";
+    return SLA_SUCCESS;
+}
 
-        if(curr_bit_pattern->pattern_type == "opcode")
-        {
-            bit_pattern += curr_constructor->bit_patterns[k].pattern;
-        }
-        else if(curr_bit_pattern->pattern_type == "reg")
-        {
-            size = curr_bit_pattern->end_bit -
-                   curr_bit_pattern->start_bit + 1;
-            bit_pattern += string(size, curr_bit_pattern->pattern[0]);
-        }
-        else if(curr_bit_pattern->pattern_type == "imm")
-        {
-            size = curr_bit_pattern->end_bit -
-                   curr_bit_pattern->start_bit + 1;
-            bit_pattern += string(size, curr_bit_pattern->pattern[0]);
-        }
+// get the packed opcode bit pattern given a constructor id
+// length is 0 for constructors the decision index doesn't cover
+int Slautil::getConstructorMask(unsigned int id, CONSTRUCTOR_MASK& constructor_mask)
+{
+    if(!m_initialized)
+    {
+        return NOT_INITIALIZED;
     }
 
-    // sanity check the bit pattern size
-    if(bit_pattern.size() == 0)
+    if(id >= m_constructor_masks.size())
     {
-        return -1;
+        cout << "Bad ID!!" << endl;
+        return -2;
     }
 
+    constructor_mask = m_constructor_masks[id];
     return SLA_SUCCESS;
 }
 
@@ -265,8 +265,6 @@ int Slautil::getConstructorText(unsigned int id,
                                 bool use_bit_pattern,
                                 const string& bit_pattern)
 {
-    PCONSTRUCTOR curr_constructor = NULL;
-
     if(!m_initialized)
     {
         return NOT_INITIALIZED;
@@ -278,97 +276,70 @@ int Slautil::getConstructorText(unsigned int id,
         return -2;
     }
 
-    curr_constructor = &m_constructors[id];
     constructor_text = "";
 
-    for(unsigned int j = 0; j < curr_constructor->constructor_pieces.size(); j++)
+    for(unsigned int j = m_operand_starts[id]; j < m_operand_starts[id + 1]; j++)
     {
-        PCONSTRUCTOR_PIECE curr_constructor_piece = NULL;
-
-        curr_constructor_piece = &curr_constructor->constructor_pieces[j];
+        const CONSTRUCTOR_OPERAND& operand = m_operands[j];
 
-        if(curr_constructor_piece->type == "print")
-        {
-            constructor_text += curr_constructor_piece->part;
-        }
-        else if(curr_constructor_piece->type == "opprint")
+        switch(operand.type)
         {
-            //cout << curr_constructor_piece->type << endl;
-            //cout << curr_constructor_piece->id << endl;
-
-            // todo change logic
-            boost::unordered_map<unsigned int, varlist_sym> ::iterator itr;
-            boost::unordered_map<unsigned int, OPERAND_SYM> ::iterator itr2;
-
-            itr = m_varlist_syms.find(curr_constructor_piece->id);
-            if(itr == m_varlist_syms.end())
-            {
-                itr2 = m_operand_syms.find(curr_constructor_piece->id);
-                if(itr2 == m_operand_syms.end())
+            case OPERAND_PRINT:
+                constructor_text += operand.text;
+                break;
+            case OPERAND_SYMBOL:
+                if(!operand.has_name)
                 {
-                    boost::unordered_map<unsigned int, string> ::iterator itr3;
-                    itr3 = m_vars.find(curr_constructor_piece->id);
-
-                    if(itr3 == m_vars.end())
-                    {
-                        cout << "Failed to find " << curr_constructor_piece->id << endl;
-                        throw 1;
-                        continue;
-                    }
+                    cout << "Failed to find " << operand.id << endl;
+                    throw 1;
+                }
 
-                    constructor_text += itr3->second;
-                    continue;
+                constructor_text += operand.text;
+                break;
+            case OPERAND_IMMEDIATE:
+                if(use_bit_pattern == false)
+                {
+                    constructor_text += "__immediate_list__";
                 }
                 else
                 {
-                    if(use_bit_pattern == false)
-                    {
-                        constructor_text += "__immediate_list__";
-                    }
-                    else
-                    {
-                        unsigned int value = 0;
-                        convertBitFieldToValue(itr2->second.bitfield,
-                                               bit_pattern,
-                                               value);
+                    unsigned int value = 0;
+                    char hex[16] = {};
 
-                        stringstream ss;
-                        ss << setbase(16) << value;
+                    convertBitFieldToValue(operand.bitfield,
+                                           bit_pattern,
+                                           value);
 
-                        constructor_text += "0x" + ss.str();
-                    }
+                    snprintf(hex, sizeof(hex), "0x%x", value);
+                    constructor_text += hex;
                 }
-
-                continue;
-            }
-            else
-            {
+                break;
+            case OPERAND_REGISTER_LIST:
                 if(use_bit_pattern == false)
                 {
                     constructor_text += "__register_list__";
                 }
                 else
                 {
+                    const vector<string>& register_table = m_register_tables[operand.register_table];
                     unsigned int register_index = 0;
-                    convertBitFieldToValue(itr->second.bitfield,
+
+                    convertBitFieldToValue(operand.bitfield,
                                            bit_pattern,
                                            register_index);
 
-                    if(register_index < itr->second.register_ids.size())
+                    if(register_index < register_table.size())
                     {
-                        boost::unordered_map<unsigned int, string> ::iterator itr3;
-                        itr3 = m_vars.find(itr->second.register_ids[register_index]);
-
-                        constructor_text += itr3->second;
+                        constructor_text += register_table[register_index];
                     }
                     else
                     {
                         constructor_text += "___ERROR_REGISTER__INDEX__";
                     }
                 }
-            }
+                break;
         }
-    } // for(unsigned int j = 0; j < curr_constructor->constructor_pieces.size(); j++)
+    }
 
     return SLA_SUCCESS;
 }
@@ -379,7 +350,6 @@ int Slautil::getConstructorTextRegisterById(unsigned int id,
                                             unsigned int register_number,
                                             string& bit_pattern)
 {
-    PCONSTRUCTOR curr_constructor = NULL;
     unsigned int registers_count = 0;
 
     // TODO: sloppy, add error handling
@@ -395,105 +365,55 @@ int Slautil::getConstructorTextRegisterById(unsigned int id,
         return -2;
     }
 
-    curr_constructor = &m_constructors[id];
     register_name = "";
 
-    for(unsigned int j = 0;
-        j < curr_constructor->constructor_pieces.size();
-        j++)
+    for(unsigned int j = m_operand_starts[id]; j < m_operand_starts[id + 1]; j++)
     {
-        PCONSTRUCTOR_PIECE curr_constructor_piece = NULL;
-        curr_constructor_piece = &curr_constructor->constructor_pieces[j];
+        const CONSTRUCTOR_OPERAND& operand = m_operands[j];
 
-        if(curr_constructor_piece->type == "opprint")
+        if(operand.type == OPERAND_REGISTER_LIST)
         {
-            // todo change logic
-            boost::unordered_map<unsigned int, varlist_sym> ::iterator itr;
-            boost::unordered_map<unsigned int, OPERAND_SYM> ::iterator itr2;
+            const vector<string>& register_table = m_register_tables[operand.register_table];
+            unsigned int register_index = 0;
 
-            itr = m_varlist_syms.find(curr_constructor_piece->id);
-            if(itr != m_varlist_syms.end())
+            if(registers_count != register_number)
             {
-                if(registers_count != register_number)
-                {
-                    registers_count++;
-                    continue;
-                }
-
-                unsigned int register_index = 0;
-
-                /*
-                cout << "itr->second.bitfield " << &itr->second.bitfield << endl;
-                cout << "bitpattern " << bit_pattern << endl;
-                cout << "regindex " << register_index << endl;
-                */
-
-                convertBitFieldToValue(itr->second.bitfield,
-                                       bit_pattern,
-                                       register_index);
-
-                if(register_index < itr->second.register_ids.size())
-                {
-                    boost::unordered_map<unsigned int, string> ::iterator itr3;
-                    itr3 = m_vars.find(itr->second.register_ids[register_index]);
-                    register_name += itr3->second;
-                    return 0;
-                }
-                else
-                {
-                    cout << "bad bad bad" << endl;
-                    register_name += "___ERROR_REGISTER__INDEX__";
-                    cout << register_name << endl;
-                    throw 1;
-                    return 0;
-                }
+                registers_count++;
+                continue;
             }
 
-            boost::unordered_map<unsigned int, string> ::iterator itr3;
-            itr3 = m_vars.find(curr_constructor_piece->id);
-            if(itr3 == m_vars.end())
+            convertBitFieldToValue(operand.bitfield,
+                                   bit_pattern,
+                                   register_index);
+
+            if(register_index < register_table.size())
             {
-                cout << "Failed to find " << curr_constructor_piece->id << endl;
-                throw 1;
-                continue;
+                register_name += register_table[register_index];
+                return 0;
             }
-            else
-            {
-                if(std::find(m_registers.begin(), m_registers.end(), itr3->second) != m_registers.end())
-                {
-                    if(registers_count == register_number)
-                    {
-                        register_name = itr3->second;
-                        //cout << "FOUND " << register_name << endl;
-                        //throw 1;
-                        return 0;
-                    }
 
-                    registers_count++;
-                    continue;
-                }
-                continue;
-            }
+            cout << "bad bad bad" << endl;
+            register_name += "___ERROR_REGISTER__INDEX__";
+            cout << register_name << endl;
+            throw 1;
         }
-        else if(curr_constructor_piece->type == "print")
-        {
-            // TODO:
-            // BUGBUG: incorrect hack
-            if(curr_constructor_piece->part[0] == 'r' &&
-               curr_constructor_piece->part[1] == '0')
-            {
-                //cout << "print: " << curr_constructor_piece->part << endl;
 
-                if(registers_count == register_number)
-                {
-                    register_name = "r0";
-                    //cout << "FOUND " << register_name << endl;
-                    return 0;
-                }
+        if(operand.type != OPERAND_PRINT && !operand.has_name)
+        {
+            cout << "Failed to find " << operand.id << endl;
+            throw 1;
+        }
 
-                registers_count++;
-                continue;
+        // fixed registers, either a register symbol or printed text
+        if(operand.register_name.size() != 0)
+        {
+            if(registers_count == register_number)
+            {
+                register_name = operand.register_name;
+                return 0;
             }
+
+            registers_count++;
         }
     }
 
@@ -528,8 +448,77 @@ int Slautil::getConstructorTextByBitPattern(const string& bit_pattern,
 }
 
 // get a constructor ID by opcode bit string
+// walks the decision index built by loadSla(). Bit patterns that aren't plain
+// 0s and 1s or are longer than 64 bits fall back to a linear scan
 int Slautil::getConstructorIdByBitPattern(const string& bit_pattern,
                                           unsigned int& id)
+{
+    boost::unordered_map<unsigned int, unsigned int>::iterator itr;
+    PDECISION_NODE curr_node = NULL;
+    unsigned long long value = 0;
+    id = 0xffffffff;
+
+    if(!m_initialized)
+    {
+        return NOT_INITIALIZED;
+    }
+
+    if(bit_pattern.size() > 64)
+    {
+        return scanConstructorIdByBitPattern(bit_pattern, id);
+    }
+
+    for(unsigned int i = 0; i < bit_pattern.size(); i++)
+    {
+        if(bit_pattern[i] == '1')
+        {
+            value = (value << 1) | 1;
+        }
+        else if(bit_pattern[i] == '0')
+        {
+            value = value << 1;
+        }
+        else
+        {
+            // combined fields need the fuzzy compare
+            return scanConstructorIdByBitPattern(bit_pattern, id);
+        }
+    }
+
+    itr = m_decision_roots.find(bit_pattern.size());
+    if(itr == m_decision_roots.end())
+    {
+        return -1;
+    }
+
+    curr_node = &m_decision_nodes[itr->second];
+    while(curr_node->size != 0)
+    {
+        unsigned long long window = (value >> curr_node->shift) & ((1ULL << curr_node->size) - 1);
+        curr_node = &m_decision_nodes[curr_node->first + window];
+    }
+
+    // leaf ids are sorted, search from the back so the highest matching id
+    // wins the same as the linear scan
+    for(unsigned int i = curr_node->count; i > 0; i--)
+    {
+        unsigned int curr_id = m_decision_ids[curr_node->first + i - 1];
+        PCONSTRUCTOR_MASK curr_mask = &m_constructor_masks[curr_id];
+
+        if((value & curr_mask->mask) == curr_mask->value)
+        {
+            id = curr_id;
+            return SLA_SUCCESS;
+        }
+    }
+
+    return -1;
+}
+
+// get a constructor ID by opcode bit string by comparing against every
+// constructor. Used for bit patterns the decision index can't handle
+int Slautil::scanConstructorIdByBitPattern(const string& bit_pattern,
+                                           unsigned int& id)
 {
     unsigned int count;
     int result = 0;
@@ -577,6 +566,308 @@ int Slautil::getConstructorIdByBitPattern(const string& bit_pattern,
     return -1;
 }
 
+// Resolves the constructor pieces into flat operand tables and builds the
+// bit pattern string of every constructor. Called once at load time so
+// printing a constructor is straight-line code without lookups
+int Slautil::buildConstructorTables(void)
+{
+    boost::unordered_map<unsigned int, unsigned int> register_tables; // varlist id -> m_register_tables index
+
+    m_bit_patterns.clear();
+    m_operands.clear();
+    m_operand_starts.clear();
+    m_register_tables.clear();
+
+    m_bit_patterns.resize(m_constructors.size());
+    m_operand_starts.reserve(m_constructors.size() + 1);
+
+    for(unsigned int i = 0; i < m_constructors.size(); i++)
+    {
+        CONSTRUCTOR& curr_constructor = m_constructors[i];
+        string& bit_pattern = m_bit_patterns[i];
+
+        for(auto& curr_bit_pattern: curr_constructor.bit_patterns)
+        {
+            if(curr_bit_pattern.pattern_type == "opcode")
+            {
+                bit_pattern += curr_bit_pattern.pattern;
+            }
+            else if(curr_bit_pattern.pattern_type == "reg" ||
+                    curr_bit_pattern.pattern_type == "imm")
+            {
+                unsigned int size = curr_bit_pattern.end_bit -
+                                    curr_bit_pattern.start_bit + 1;
+                bit_pattern += string(size, curr_bit_pattern.pattern[0]);
+            }
+        }
+
+        m_operand_starts.push_back(m_operands.size());
+
+        for(auto& curr_constructor_piece: curr_constructor.constructor_pieces)
+        {
+            CONSTRUCTOR_OPERAND operand = {};
+            boost::unordered_map<unsigned int, varlist_sym>::iterator itr;
+            boost::unordered_map<unsigned int, OPERAND_SYM>::iterator itr2;
+            boost::unordered_map<unsigned int, string>::iterator itr3;
+
+            operand.id = curr_constructor_piece.id;
+
+            if(curr_constructor_piece.type == "print")
+            {
+                operand.type = OPERAND_PRINT;
+                operand.text = curr_constructor_piece.part;
+                operand.has_name = true;
+
+                // TODO:
+                // BUGBUG: incorrect hack
+                if(operand.text.size() >= 2 &&
+                   operand.text[0] == 'r' &&
+                   operand.text[1] == '0')
+                {
+                    operand.register_name = "r0";
+                }
+
+                m_operands.push_back(std::move(operand));
+                continue;
+            }
+
+            if(curr_constructor_piece.type != "opprint")
+            {
+                continue;
+            }
+
+            itr3 = m_vars.find(curr_constructor_piece.id);
+            if(itr3 != m_vars.end())
+            {
+                operand.text = itr3->second;
+                operand.has_name = true;
+            }
+
+            itr = m_varlist_syms.find(curr_constructor_piece.id);
+            itr2 = m_operand_syms.find(curr_constructor_piece.id);
+
+            if(itr != m_varlist_syms.end())
+            {
+                boost::unordered_map<unsigned int, unsigned int>::iterator table_itr;
+
+                operand.type = OPERAND_REGISTER_LIST;
+                operand.bitfield = itr->second.bitfield;
+
+                table_itr = register_tables.find(itr->first);
+                if(table_itr == register_tables.end())
+                {
+                    vector<string> register_table;
+
+                    for(auto register_id: itr->second.register_ids)
+                    {
+                        boost::unordered_map<unsigned int, string>::iterator name_itr;
+
+                        name_itr = m_vars.find(register_id);
+                        register_table.push_back(name_itr == m_vars.end() ? "" : name_itr->second);
+                    }
+
+                    table_itr = register_tables.emplace(itr->first, m_register_tables.size()).first;
+                    m_register_tables.push_back(std::move(register_table));
+                }
+
+                operand.register_table = table_itr->second;
+            }
+            else
+            {
+                if(itr2 != m_operand_syms.end())
+                {
+                    operand.type = OPERAND_IMMEDIATE;
+                    operand.bitfield = itr2->second.bitfield;
+                }
+                else
+                {
+                    operand.type = OPERAND_SYMBOL;
+                }
+
+                if(operand.has_name &&
+                   std::find(m_registers.begin(), m_registers.end(), operand.text) != m_registers.end())
+                {
+                    operand.register_name = operand.text;
+                }
+            }
+
+            m_operands.push_back(std::move(operand));
+        }
+    }
+
+    m_operand_starts.push_back(m_operands.size());
+
+    return SLA_SUCCESS;
+}
+
+// Builds the decision index from the constructor bit patterns. Constructors
+// are grouped by bit pattern length, each group is then split on windows of
+// fixed opcode bits until the leaves are small
+int Slautil::buildDecisionIndex(void)
+{
+    map<unsigned int, vector<unsigned int>> ids_by_length;
+    int result = 0;
+
+    m_constructor_masks.assign(m_constructors.size(), {0, 0, 0});
+    m_decision_nodes.clear();
+    m_decision_ids.clear();
+    m_decision_roots.clear();
+
+    for(unsigned int i = 0; i < m_constructors.size(); i++)
+    {
+        PCONSTRUCTOR_MASK curr_mask = &m_constructor_masks[i];
+        string bit_pattern;
+
+        // constructors without a bit pattern never match, anything longer
+        // than 64 bits is only found by scanConstructorIdByBitPattern()
+        result = getConstructorBitPattern(i, bit_pattern);
+        if(result != SLA_SUCCESS || bit_pattern.size() > 64)
+        {
+            continue;
+        }
+
+        curr_mask->length = bit_pattern.size();
+
+        for(unsigned int j = 0; j < bit_pattern.size(); j++)
+        {
+            curr_mask->mask <<= 1;
+            curr_mask->value <<= 1;
+
+            if(bit_pattern[j] == '0' || bit_pattern[j] == '1')
+            {
+                curr_mask->mask |= 1;
+                curr_mask->value |= (bit_pattern[j] == '1');
+            }
+        }
+
+        ids_by_length[curr_mask->length].push_back(i);
+    }
+
+    for(auto& x: ids_by_length)
+    {
+        unsigned int root = m_decision_nodes.size();
+
+        m_decision_nodes.push_back({0, 0, 0, 0});
+        m_decision_roots[x.first] = root;
+
+        result = buildDecisionNode(root, x.second, x.first, 0);
+        if(result != SLA_SUCCESS)
+        {
+            return result;
+        }
+    }
+
+    return SLA_SUCCESS;
+}
+
+// Fills out m_decision_nodes[node_index] for the constructors in ids.
+// Picks the window of bits not in used_bits that is fixed in the most
+// constructors and recurses into one child per window value. Constructors with
+// unfixed bits in the window are added to every child they can match
+int Slautil::buildDecisionNode(unsigned int node_index,
+                               const vector<unsigned int>& ids,
+                               unsigned int length,
+                               unsigned long long used_bits)
+{
+    unsigned int size = min((unsigned int)DECISION_WINDOW_BITS, length);
+    int result = 0;
+
+    while(ids.size() > DECISION_LEAF_SIZE)
+    {
+        vector<vector<unsigned int>> children;
+        unsigned long long window_mask = 0;
+        unsigned int best_shift = 0;
+        unsigned int best_fixed = 0;
+        unsigned int largest = 0;
+        unsigned int first = 0;
+
+        // prefer the highest window on ties, major opcodes are normally at
+        // the top of the instruction
+        for(unsigned int shift = 0; shift + size <= length; shift++)
+        {
+            unsigned long long window = ((1ULL << size) - 1) << shift;
+            unsigned int fixed = 0;
+
+            if(window & used_bits)
+            {
+                continue;
+            }
+
+            for(auto curr_id: ids)
+            {
+                if((m_constructor_masks[curr_id].mask & window) == window)
+                {
+                    fixed++;
+                }
+            }
+
+            if(fixed > 0 && fixed >= best_fixed)
+            {
+                best_fixed = fixed;
+                best_shift = shift;
+            }
+        }
+
+        // stop once most constructors have unfixed bits in every window,
+        // splitting further would only copy them into every child
+        if(best_fixed == 0 || best_fixed * 2 < ids.size())
+        {
+            break;
+        }
+
+        window_mask = (1ULL << size) - 1;
+        used_bits |= window_mask << best_shift;
+        children.resize(1 << size);
+
+        for(auto curr_id: ids)
+        {
+            unsigned long long mask = (m_constructor_masks[curr_id].mask >> best_shift) & window_mask;
+            unsigned long long value = (m_constructor_masks[curr_id].value >> best_shift) & window_mask;
+
+            for(unsigned int i = 0; i < children.size(); i++)
+            {
+                if((i & mask) == value)
+                {
+                    children[i].push_back(curr_id);
+                }
+            }
+        }
+
+        for(auto& child: children)
+        {
+            largest = max(largest, (unsigned int)child.size());
+        }
+
+        // the window didn't separate any constructors, try the next one
+        if(largest == ids.size())
+        {
+            continue;
+        }
+
+        // children of a node are contiguous so the lookup can index them
+        first = m_decision_nodes.size();
+        m_decision_nodes.resize(first + children.size(), {0, 0, 0, 0});
+        m_decision_nodes[node_index] = {best_shift, size, first, 0};
+
+        for(unsigned int i = 0; i < children.size(); i++)
+        {
+            result = buildDecisionNode(first + i, children[i], length, used_bits);
+            if(result != SLA_SUCCESS)
+            {
+                return result;
+            }
+        }
+
+        return SLA_SUCCESS;
+    }
+
+    // leaf
+    m_decision_nodes[node_index] = {0, 0, (unsigned int)m_decision_ids.size(), (unsigned int)ids.size()};
+    m_decision_ids.insert(m_decision_ids.end(), ids.begin(), ids.end());
+
+    return SLA_SUCCESS;
+}
+
 // compare two opcode bit patterns
 // has fuzzy logic for combined fields
 int Slautil::compareBitPatterns(const string& a, const string& b)
@@ -613,7 +904,7 @@ int Slautil::compareBitPatterns(const string& a, const string& b)
 }
 
 // converts a bit field into a value
-int Slautil::convertBitFieldToValue(TOKENFIELD& bitfield,
+int Slautil::convertBitFieldToValue(const TOKENFIELD& bitfield,
                                     const string& bit_pattern,
                                     unsigned int& value)
 {
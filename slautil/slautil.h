@@ -8,21 +8,28 @@
 //-----------------------------------------------------------------------------
 #pragma once
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
-#include <boost/foreach.hpp>
 #include <boost/unordered_map.hpp>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iomanip>
 
 using namespace std;
-namespace pt = boost::property_tree;
 
 #define SLEIGH_VERSION 4
 #define SLA_SUCCESS (0)
 #define NOT_INITIALIZED (-1)
 
+// the decision index splits on windows of up to this many opcode bits and
+// stops splitting once a leaf has this many constructors or less
+#define DECISION_WINDOW_BITS 4
+#define DECISION_LEAF_SIZE 4
+
+// loadSlaCached keeps the parsed .sla next to it in <filename>.cache
+#define SLA_CACHE_EXTENSION ".cache"
+
 typedef struct _DECISION_PAIR
 {
     unsigned int id;
@@ -83,18 +90,101 @@ typedef struct _CONSTRUCTOR
     vector<BIT_PATTERN> bit_patterns;
 } CONSTRUCTOR, *PCONSTRUCTOR;
 
+// constructor as read from the .sla XML. opprint pieces still hold the index
+// into operand_ids, they are resolved once all symbols have been read
+typedef struct _SLA_XML_CONSTRUCTOR
+{
+    CONSTRUCTOR constructor;
+    vector<unsigned int> operand_ids;
+} SLA_XML_CONSTRUCTOR, *PSLA_XML_CONSTRUCTOR;
+
+// everything Slautil needs from the .sla XML, collected in a single pass
+// over the file. Symbols can be referenced before they are defined so the
+// records are only resolved into the Slautil members after the whole file
+// has been read
+typedef struct _SLA_XML_DATA
+{
+    unsigned int sleigh_version;
+    vector<pair<unsigned int, string>> var_heads; // varnode, value and operand sym heads
+    vector<pair<unsigned int, string>> subtable_heads;
+    vector<pair<unsigned int, unsigned int>> subsyms; // operand syms with a subsym
+    vector<OPERAND_SYM> operand_syms;
+    vector<varlist_sym> varlist_syms;
+    vector<unsigned int> register_ids; // varnode syms in the register space
+    unsigned int constructor_count; // numct of the instruction table
+    vector<SLA_XML_CONSTRUCTOR> constructors;
+    vector<DECISION_PAIR> decision_pairs;
+} SLA_XML_DATA, *PSLA_XML_DATA;
+
+// constructor bit pattern packed into integers for the decision index
+// bit 0 of mask/value is the last character of the bit pattern string
+typedef struct _CONSTRUCTOR_MASK
+{
+    unsigned int length; // number of bits in the bit pattern
+    unsigned long long mask; // 1 where the bit pattern has a fixed 0 or 1
+    unsigned long long value; // the fixed bits
+} CONSTRUCTOR_MASK, *PCONSTRUCTOR_MASK;
+
+// node of the decision index. Inner nodes switch on a window of bits of the
+// opcode, leaves list every constructor that can match opcodes reaching them
+typedef struct _DECISION_NODE
+{
+    unsigned int shift; // lowest bit of the window
+    unsigned int size; // number of bits in the window, 0 for leaves
+    unsigned int first; // first child node for inner nodes
+                        // first entry in m_decision_ids for leaves
+    unsigned int count; // number of constructor ids in the leaf
+} DECISION_NODE, *PDECISION_NODE;
+
+// what a constructor operand prints as, see CONSTRUCTOR_OPERAND
+enum OPERAND_TYPE
+{
+    OPERAND_PRINT = 0,         // fixed text
+    OPERAND_SYMBOL = 1,        // fixed symbol, printed by name
+    OPERAND_IMMEDIATE = 2,     // value of a token field
+    OPERAND_REGISTER_LIST = 3, // register picked by a token field
+};
+
+// constructor piece with its symbol resolved at load time so printing a
+// constructor doesn't have to look anything up
+typedef struct _CONSTRUCTOR_OPERAND
+{
+    OPERAND_TYPE type;
+    unsigned int id; // symbol id of opprint pieces
+
+    // OPERAND_PRINT: the text. Otherwise the name of the symbol
+    string text;
+
+    // text is a known symbol name. Only false for symbols missing from the
+    // .sla, which are reported when the constructor is printed
+    bool has_name;
+
+    // name of the fixed register the operand prints, as counted by
+    // getConstructorTextRegisterById(). Empty if it isn't a fixed register
+    string register_name;
+
+    // OPERAND_IMMEDIATE and OPERAND_REGISTER_LIST: where the value is in the
+    // opcode
+    TOKENFIELD bitfield;
+
+    // OPERAND_REGISTER_LIST: index into m_register_tables
+    unsigned int register_table;
+} CONSTRUCTOR_OPERAND, *PCONSTRUCTOR_OPERAND;
+
 class Slautil
 {
     public:
         Slautil();
 
         int loadSla(const string& filename);
+        int loadSlaCached(const string& filename);
         int getRegisters(vector<string>& registers);
 
         // various way to look up instructions
         int getConstructorCount(unsigned int& count);
         int getConstructorText(unsigned int id, string& constructor_text);
         int getConstructorBitPattern(unsigned int id, string& bit_pattern);
+        int getConstructorMask(unsigned int id, CONSTRUCTOR_MASK& constructor_mask);
         int getConstructorTextByBitPattern(const string& bit_pattern,
                                            string& constructor_text);
         int getConstructorIdByBitPattern(const string& bit_pattern,
@@ -107,19 +197,38 @@ class Slautil
     private:
         int loadSlaXML(const string& filename);
 
+        // binary cache of everything loadSla parses, see slacache.cpp
+        int saveCache(const string& cache_filename,
+                      unsigned long long sla_size,
+                      unsigned long long sla_hash);
+        int loadCache(const string& cache_filename,
+                      unsigned long long sla_size,
+                      unsigned long long sla_hash);
+        int validateCache(void);
+
         // parsing fields within the xml
-        int parseRegisters(void);
-        int parseVars(void);
-        int parseSubtableSymHeads(void);
-        int parseConstructors(void);
-        int parseVarlistSym(void);
-        int parseOperandSyms(void);
-        int parseDecisionPairs(void);
+        int parseRegisters(const SLA_XML_DATA& sla_xml);
+        int parseVars(const SLA_XML_DATA& sla_xml);
+        int parseSubtableSymHeads(const SLA_XML_DATA& sla_xml);
+        int parseConstructors(SLA_XML_DATA& sla_xml);
+        int parseVarlistSym(SLA_XML_DATA& sla_xml);
+        int parseOperandSyms(const SLA_XML_DATA& sla_xml);
+        int parseDecisionPairs(const SLA_XML_DATA& sla_xml);
         int convertDecisionPairsToBitPatterns(void);
-        int recursiveParseDecisionPairs(const boost::property_tree::ptree & subtree);
-        int parseDecisionPair(const boost::property_tree::ptree& subtree);
         int addNonOpcodeBitPatterns(void);
 
+        // decision index used by getConstructorIdByBitPattern
+        int buildDecisionIndex(void);
+        int buildDecisionNode(unsigned int node_index,
+                              const vector<unsigned int>& ids,
+                              unsigned int length,
+                              unsigned long long used_bits);
+        int scanConstructorIdByBitPattern(const string& bit_pattern,
+                                          unsigned int& id);
+
+        // flattened constructor bit patterns and operands used when printing
+        int buildConstructorTables(void);
+
         // various helper routines
         int getConstructorText(unsigned int id,
                                string& constructor_text,
@@ -137,7 +246,7 @@ class Slautil
                           const string& type,
                           unsigned int count);
         int compareBitPatterns(const string& a, const string& b);
-        int convertBitFieldToValue(TOKENFIELD& bitfield,
+        int convertBitFieldToValue(const TOKENFIELD& bitfield,
                                    const string& bit_pattern,
                                    unsigned int& value);
 
@@ -148,9 +257,16 @@ class Slautil
         boost::unordered_map<unsigned int, string> m_vars;
         vector<CONSTRUCTOR> m_constructors;
         vector<DECISION_PAIR> m_decision_pairs;
+        vector<CONSTRUCTOR_MASK> m_constructor_masks; // indexed by constructor id
+        vector<DECISION_NODE> m_decision_nodes;
+        vector<unsigned int> m_decision_ids; // constructor ids of all leaves
+        boost::unordered_map<unsigned int, unsigned int> m_decision_roots; // bit pattern length -> root node
+        vector<string> m_bit_patterns; // indexed by constructor id
+        vector<CONSTRUCTOR_OPERAND> m_operands; // operands of all constructors
+        vector<unsigned int> m_operand_starts; // first operand of each constructor, plus the end
+        vector<vector<string>> m_register_tables; // register names of varlist syms
         vector<string> m_registers;
         unsigned int m_constructor_count;
         unsigned int m_sleigh_version;
-        pt::ptree m_tree;
         bool m_initialized;
 };
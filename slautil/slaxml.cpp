@@ -1,37 +1,116 @@
 //-----------------------------------------------------------------------------
-// File: slautil.h
+// File: slaxml.cpp
 //
-// Parsing XML SLA files
+// Parsing XML and packed binary SLA files
 //
 // Copyright (c) Oberoi Security Solutions. All rights reserved.
 // Licensed under the Apache 2.0 License.
 //-----------------------------------------------------------------------------
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
-#include <boost/foreach.hpp>
+#include <cstring>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include "slautil.h"
+#include "slareader.h"
 
 using namespace std;
-namespace pt = boost::property_tree;
 
-// load the XML SLA processor module
+// where we are in the .sla XML while reading it
+typedef struct _SLA_XML_STATE
+{
+    vector<string> open_tags;
+
+    // the first subtable_sym is the instruction table
+    bool seen_instruction_table;
+    bool in_instruction_table;
+    bool seen_decision;
+    bool in_decision;
+
+    // symbol_table children that span multiple tags
+    OPERAND_SYM operand_sym;
+    string operand_sym_id;
+    string operand_sym_subsym;
+    bool seen_operand_tokenfield;
+    varlist_sym varlist;
+    bool seen_varlist_tokenfield;
+    SLA_XML_CONSTRUCTOR constructor;
+    bool in_constructor;
+
+    // decision pair being read and the depth of its pair tag
+    DECISION_PAIR decision_pair;
+    bool in_pair;
+    size_t pair_depth;
+    bool seen_instruct_pat;
+    bool in_instruct_pat;
+    bool seen_pat_block;
+    bool in_pat_block;
+    bool seen_mask_word;
+    string mask;
+    string val;
+} SLA_XML_STATE, *PSLA_XML_STATE;
+
+static int readSlaXML(SLA_XML_READER& reader, SLA_XML_DATA& sla_xml);
+static int readSlaXmlTag(SLA_XML_READER& reader, SLA_XML_TAG& tag);
+static int skipSlaXmlUntil(SLA_XML_READER& reader,
+                           size_t offset,
+                           const char* terminator);
+static bool isSlaXmlSpace(int ch);
+static void decodeSlaXmlEntities(string& value);
+static int startSlaXmlElement(SLA_XML_STATE& state,
+                              const SLA_XML_TAG& tag,
+                              SLA_XML_DATA& sla_xml);
+static int endSlaXmlElement(SLA_XML_STATE& state,
+                            const string& name,
+                            SLA_XML_DATA& sla_xml);
+static const string* getSlaXmlAttribute(const SLA_XML_TAG& tag,
+                                        const char* name);
+static string getSlaXmlAttribute(const SLA_XML_TAG& tag,
+                                 const char* name,
+                                 const char* default_value);
+static unsigned int getSlaXmlAttributeUInt(const SLA_XML_TAG& tag,
+                                           const char* name,
+                                           unsigned int default_value);
+static void getSlaXmlTokenField(const SLA_XML_TAG& tag, TOKENFIELD& bitfield);
+
+// load the XML or packed binary SLA processor module
+// The file is read once, tag by tag, keeping only the records Slautil needs.
+// No document tree is built
 int Slautil::loadSlaXML(const string& filename)
 {
-    // Parse the XML into the property tree.
+    SLA_XML_READER reader;
+    SLA_XML_DATA sla_xml = {};
+    int result = 0;
+
+    reader.pos = 0;
+    reader.end = 0;
+    reader.is_packed = false;
+    reader.zstream_initialized = false;
+    reader.corrupt = false;
+    reader.ifs.open(filename, std::ios::binary);
+
     try
     {
-        pt::read_xml(filename, m_tree);
+        result = -1;
+        if(reader.ifs && openSlaPacked(reader) >= 0)
+        {
+            result = readSlaXML(reader, sla_xml);
+        }
     }
     catch(...)
+    {
+        result = -1;
+    }
+
+    closeSlaPacked(reader);
+
+    if(result != SLA_SUCCESS)
     {
         cout << "[-] Exception when opening sla (" << filename << ")!" << endl;
         return -1;
     }
 
-    m_sleigh_version = m_tree.get("sleigh.<xmlattr>.version", 0);
+    m_sleigh_version = sla_xml.sleigh_version;
     if(m_sleigh_version != SLEIGH_VERSION)
     {
         cout << "[-] Invalid sleigh version (" << m_sleigh_version << ")!" << endl;
@@ -39,268 +118,954 @@ int Slautil::loadSlaXML(const string& filename)
         return -1;
     }
 
-    this->parseVars();
-    this->parseSubtableSymHeads();
-    this->parseOperandSyms();
-    this->parseConstructors();
-    this->parseDecisionPairs();
+    this->parseVars(sla_xml);
+    this->parseSubtableSymHeads(sla_xml);
+    this->parseOperandSyms(sla_xml);
+    this->parseConstructors(sla_xml);
+    this->parseDecisionPairs(sla_xml);
     this->convertDecisionPairsToBitPatterns();
-    this->parseVarlistSym();
-    this->parseRegisters(); // TODO: needs to happen before add_non_opcode_bit_patterns()
+    this->parseVarlistSym(sla_xml);
+    this->parseRegisters(sla_xml); // TODO: needs to happen before add_non_opcode_bit_patterns()
     this->addNonOpcodeBitPatterns();
 
     return SLA_SUCCESS;
 }
 
-// read the variables from the processor module
-int Slautil::parseVars(void)
+// reads every tag of the .sla XML and collects the records into sla_xml
+static int readSlaXML(SLA_XML_READER& reader, SLA_XML_DATA& sla_xml)
 {
-    for(auto &v : m_tree.get_child("sleigh.symbol_table"))
+    SLA_XML_STATE state = {};
+    SLA_XML_TAG tag;
+    int result = 0;
+
+    while(true)
     {
-        if(v.first != "varnode_sym_head" &&
-           v.first != "value_sym_head" &&
-           v.first != "operand_sym_head")
+        result = readSlaXmlTag(reader, tag);
+        if(result < 0)
+        {
+            return result;
+        }
+
+        if(result == 0)
         {
+            if(reader.is_packed && reader.corrupt)
+            {
+                return -1;
+            }
+            break;
+        }
+
+        if(tag.is_end)
+        {
+            if(state.open_tags.size() == 0 ||
+               state.open_tags.back() != tag.name)
+            {
+                cout << "[-] Mismatched closing tag " << tag.name << endl;
+                return -1;
+            }
+
+            state.open_tags.pop_back();
+            result = endSlaXmlElement(state, tag.name, sla_xml);
+            if(result != SLA_SUCCESS)
+            {
+                return result;
+            }
             continue;
         }
 
-        // todo can throw
-        std::string name = v.second.get_child("<xmlattr>.name").data();
-        std::string id_str = v.second.get_child("<xmlattr>.id").data();
+        result = startSlaXmlElement(state, tag, sla_xml);
+        if(result != SLA_SUCCESS)
+        {
+            return result;
+        }
 
-        unsigned int id = stoi(id_str, 0, 0x10);
+        state.open_tags.push_back(tag.name);
 
-        m_vars.emplace(id, name);
+        if(tag.is_empty)
+        {
+            state.open_tags.pop_back();
+            result = endSlaXmlElement(state, tag.name, sla_xml);
+            if(result != SLA_SUCCESS)
+            {
+                return result;
+            }
+        }
+    }
+
+    if(state.open_tags.size() != 0)
+    {
+        cout << "[-] Unexpected end of sla, " << state.open_tags.back() << " is not closed" << endl;
+        return -1;
     }
 
     return SLA_SUCCESS;
 }
 
-// read the subtable sym heads from the processor module
-int Slautil::parseSubtableSymHeads(void)
+// handles a start tag. state.open_tags holds the parents of the tag
+static int startSlaXmlElement(SLA_XML_STATE& state,
+                              const SLA_XML_TAG& tag,
+                              SLA_XML_DATA& sla_xml)
 {
-    for(auto &v : m_tree.get_child("sleigh.symbol_table"))
+    vector<string>& open_tags = state.open_tags;
+    size_t depth = open_tags.size();
+
+    if(depth == 0)
     {
-        size_t pos = 0;
+        if(tag.name == "sleigh")
+        {
+            sla_xml.sleigh_version = getSlaXmlAttributeUInt(tag, "version", 0);
+        }
+        return SLA_SUCCESS;
+    }
+
+    if(depth < 2 || open_tags[0] != "sleigh" || open_tags[1] != "symbol_table")
+    {
+        return SLA_SUCCESS;
+    }
 
-        if(v.first != "subtable_sym_head")
+    //
+    // direct children of sleigh.symbol_table
+    //
+    if(depth == 2)
+    {
+        if(tag.name == "varnode_sym_head" ||
+           tag.name == "value_sym_head" ||
+           tag.name == "operand_sym_head" ||
+           tag.name == "subtable_sym_head")
         {
-            continue;
+            const string* name = getSlaXmlAttribute(tag, "name");
+            const string* id_str = getSlaXmlAttribute(tag, "id");
+            size_t pos = 0;
+
+            if(name == NULL || id_str == NULL)
+            {
+                cout << "[-] " << tag.name << " is missing its name or id" << endl;
+                return -1;
+            }
+
+            if(tag.name != "subtable_sym_head")
+            {
+                sla_xml.var_heads.push_back({stoi(*id_str, 0, 0x10), *name});
+                return SLA_SUCCESS;
+            }
+
+            // silly workaround to support instructions that reference the same reg more than once
+            pos = name->find("_dup");
+            if(pos != std::string::npos)
+            {
+                sla_xml.subtable_heads.push_back({stoi(*id_str, 0, 0x10), name->substr(0, pos)});
+            }
+        }
+        else if(tag.name == "varnode_sym")
+        {
+            const string* space = getSlaXmlAttribute(tag, "space");
+            const string* id_str = getSlaXmlAttribute(tag, "id");
+
+            if(space == NULL)
+            {
+                cout << "[-] varnode_sym is missing its space" << endl;
+                return -1;
+            }
+
+            if(*space != "register")
+            {
+                return SLA_SUCCESS;
+            }
+
+            if(id_str == NULL)
+            {
+                cout << "[-] varnode_sym is missing its id" << endl;
+                return -1;
+            }
+
+            sla_xml.register_ids.push_back(stoi(*id_str, 0, 0x10));
+        }
+        else if(tag.name == "operand_sym")
+        {
+            state.operand_sym = {};
+            state.operand_sym_id = getSlaXmlAttribute(tag, "id", "");
+            state.operand_sym_subsym = getSlaXmlAttribute(tag, "subsym", "");
+            state.seen_operand_tokenfield = false;
+        }
+        else if(tag.name == "varlist_sym")
+        {
+            state.varlist = {};
+            state.varlist.id = stoi(getSlaXmlAttribute(tag, "id", ""), 0, 0x10);
+            state.seen_varlist_tokenfield = false;
+        }
+        else if(tag.name == "subtable_sym" && state.seen_instruction_table == false)
+        {
+            state.seen_instruction_table = true;
+            state.in_instruction_table = true;
+            sla_xml.constructor_count = getSlaXmlAttributeUInt(tag, "numct", 0);
         }
 
-        // todo can throw
-        std::string name = v.second.get_child("<xmlattr>.name").data();
-        std::string id_str = v.second.get_child("<xmlattr>.id").data();
+        return SLA_SUCCESS;
+    }
 
-        // silly workaround to support instructions that reference the same reg more than once
-        pos = name.find("_dup");
-        if (pos == std::string::npos)
+    //
+    // children of operand_sym and varlist_sym
+    //
+    if(depth == 3 && open_tags[2] == "operand_sym")
+    {
+        if(tag.name == "tokenfield" && state.seen_operand_tokenfield == false)
         {
-            continue;
+            getSlaXmlTokenField(tag, state.operand_sym.bitfield);
+            state.seen_operand_tokenfield = true;
         }
+        return SLA_SUCCESS;
+    }
 
-        name.resize(pos);
+    if(depth == 3 && open_tags[2] == "varlist_sym")
+    {
+        if(tag.name == "tokenfield" && state.seen_varlist_tokenfield == false)
+        {
+            getSlaXmlTokenField(tag, state.varlist.bitfield);
+            state.seen_varlist_tokenfield = true;
+        }
+        else if(tag.name == "var")
+        {
+            state.varlist.register_ids.push_back(stoi(getSlaXmlAttribute(tag, "id", ""), 0, 0x10));
+        }
+        return SLA_SUCCESS;
+    }
 
-        unsigned int id = stoi(id_str, 0, 0x10);
-        m_vars.emplace(id, name);
+    if(state.in_instruction_table == false)
+    {
+        return SLA_SUCCESS;
+    }
+
+    //
+    // children of the instruction table
+    //
+    if(depth == 3)
+    {
+        if(tag.name == "constructor")
+        {
+            state.constructor = {};
+            state.constructor.constructor.constructor_length = getSlaXmlAttributeUInt(tag, "length", 0);
+            state.constructor.constructor.source_file = getSlaXmlAttributeUInt(tag, "source", 0);
+            state.constructor.constructor.line_number = getSlaXmlAttributeUInt(tag, "line", 0);
+            state.in_constructor = true;
+        }
+        else if(tag.name == "decision" && state.seen_decision == false)
+        {
+            state.seen_decision = true;
+            state.in_decision = true;
+        }
+        return SLA_SUCCESS;
+    }
+
+    if(depth == 4 && state.in_constructor)
+    {
+        CONSTRUCTOR_PIECE temp_constructor_piece;
+
+        if(tag.name == "construct_tpl")
+        {
+            return SLA_SUCCESS;
+        }
+        else if(tag.name == "oper")
+        {
+            state.constructor.operand_ids.push_back(stoi(getSlaXmlAttribute(tag, "id", ""), NULL, 0x10));
+            return SLA_SUCCESS;
+        }
+        else if(tag.name == "print")
+        {
+            temp_constructor_piece.type = "print";
+            temp_constructor_piece.id = -1;
+            temp_constructor_piece.part = getSlaXmlAttribute(tag, "piece", "");
+        }
+        else if(tag.name == "opprint")
+        {
+            // index into operand_ids for now, see parseConstructors()
+            temp_constructor_piece.type = "opprint";
+            temp_constructor_piece.id = stoi(getSlaXmlAttribute(tag, "id", ""));
+        }
+        else
+        {
+            cout << "Unknown constructor node child: " << tag.name << endl;
+            return -2;
+        }
+
+        state.constructor.constructor.constructor_pieces.push_back(temp_constructor_piece);
+        return SLA_SUCCESS;
+    }
+
+    if(state.in_decision == false)
+    {
+        return SLA_SUCCESS;
+    }
+
+    //
+    // decision pairs can be recursively defined
+    //
+    if(state.in_pair == false)
+    {
+        if(open_tags[depth - 1] != "decision" || tag.name == "decision")
+        {
+            return SLA_SUCCESS;
+        }
+
+        if(tag.name != "pair")
+        {
+            cout << "Unknown value!!" << tag.name << endl;
+            return SLA_SUCCESS;
+        }
+
+        state.decision_pair = {};
+        state.decision_pair.id = getSlaXmlAttributeUInt(tag, "id", 0);
+        state.in_pair = true;
+        state.pair_depth = depth;
+        state.seen_instruct_pat = false;
+        state.seen_pat_block = false;
+        state.seen_mask_word = false;
+        state.mask = "";
+        state.val = "";
+        return SLA_SUCCESS;
+    }
+
+    // pair.instruct_pat.pat_block.mask_word, only the first of each counts
+    if(depth == state.pair_depth + 1 && tag.name == "instruct_pat" && state.seen_instruct_pat == false)
+    {
+        state.seen_instruct_pat = true;
+        state.in_instruct_pat = true;
+    }
+    else if(depth == state.pair_depth + 2 && tag.name == "pat_block" && state.in_instruct_pat && state.seen_pat_block == false)
+    {
+        state.seen_pat_block = true;
+        state.in_pat_block = true;
+        state.decision_pair.off = getSlaXmlAttributeUInt(tag, "off", 0);
+        state.decision_pair.nonzero = getSlaXmlAttributeUInt(tag, "nonzero", 0);
+    }
+    else if(depth == state.pair_depth + 3 && tag.name == "mask_word" && state.in_pat_block && state.seen_mask_word == false)
+    {
+        state.seen_mask_word = true;
+        state.mask = getSlaXmlAttribute(tag, "mask", "");
+        state.val = getSlaXmlAttribute(tag, "val", "");
     }
 
     return SLA_SUCCESS;
 }
 
-// read the operand syms from the processor module
-int Slautil::parseOperandSyms(void)
+// handles an end tag. The tag has already been popped from state.open_tags
+static int endSlaXmlElement(SLA_XML_STATE& state,
+                            const string& name,
+                            SLA_XML_DATA& sla_xml)
 {
-    for(auto &operand_sym_node : m_tree.get_child("sleigh.symbol_table"))
+    size_t depth = state.open_tags.size();
+
+    if(depth == 2 && state.open_tags[1] == "symbol_table")
     {
-        OPERAND_SYM curr_operand_sym;
-        std::string var_subsym_id_str;
-        std::string var_id_str;
+        if(name == "operand_sym" && state.operand_sym_id != "")
+        {
+            unsigned int var_id = stoi(state.operand_sym_id, 0, 0x10);
 
-        if(operand_sym_node.first != "operand_sym")
+            if(state.operand_sym_subsym != "")
+            {
+                sla_xml.subsyms.push_back({var_id, stoi(state.operand_sym_subsym, 0, 0x10)});
+            }
+            else
+            {
+                state.operand_sym.id = var_id;
+                sla_xml.operand_syms.push_back(state.operand_sym);
+            }
+        }
+        else if(name == "varlist_sym")
         {
-            continue;
+            sla_xml.varlist_syms.push_back(std::move(state.varlist));
         }
-
-        var_id_str = operand_sym_node.second.get("<xmlattr>.id", "");
-        if(var_id_str == "")
+        else if(name == "subtable_sym")
         {
-            continue;
+            state.in_instruction_table = false;
         }
-        unsigned int var_id = stoi(var_id_str, 0, 0x10);
 
-        var_subsym_id_str = operand_sym_node.second.get("<xmlattr>.subsym", "");
-        if(var_subsym_id_str != "")
+        return SLA_SUCCESS;
+    }
+
+    if(state.in_instruction_table && depth == 3)
+    {
+        if(name == "constructor")
         {
-            unsigned int var_subsym_id = stoi(var_subsym_id_str, 0, 0x10);
-            m_subsyms[var_id] = var_subsym_id;
-            continue;
+            sla_xml.constructors.push_back(std::move(state.constructor));
+            state.in_constructor = false;
+        }
+        else if(name == "decision")
+        {
+            state.in_decision = false;
         }
 
-        curr_operand_sym.id = var_id;
-        curr_operand_sym.bitfield.startbit = operand_sym_node.second.get("tokenfield.<xmlattr>.startbit", 0);
-        curr_operand_sym.bitfield.endbit = operand_sym_node.second.get("tokenfield.<xmlattr>.endbit", 0);
-        curr_operand_sym.bitfield.startbyte = operand_sym_node.second.get("tokenfield.<xmlattr>.startbyte", 0);
-        curr_operand_sym.bitfield.endbyte = operand_sym_node.second.get("tokenfield.<xmlattr>.endbyte", 0);
-        curr_operand_sym.bitfield.shift = operand_sym_node.second.get("tokenfield.<xmlattr>.shift", 0);
+        return SLA_SUCCESS;
+    }
+
+    if(state.in_pair == false)
+    {
+        return SLA_SUCCESS;
+    }
 
-        m_operand_syms[curr_operand_sym.id] = curr_operand_sym;
+    if(depth == state.pair_depth)
+    {
+        state.decision_pair.mask = stol(state.mask, NULL, 0x10);
+        state.decision_pair.val = stol(state.val, NULL, 0x10);
+        sla_xml.decision_pairs.push_back(state.decision_pair);
+        state.in_pair = false;
+    }
+    else if(depth == state.pair_depth + 1 && name == "instruct_pat")
+    {
+        state.in_instruct_pat = false;
+    }
+    else if(depth == state.pair_depth + 2 && name == "pat_block")
+    {
+        state.in_pat_block = false;
     }
 
     return SLA_SUCCESS;
 }
 
-// read the instruction constructors from the processor module
-int Slautil::parseConstructors(void)
+// Reads the next start or end tag. Text, comments, processing instructions
+// and CDATA are skipped. Returns 1 if a tag was read, 0 at the end of the
+// file and -1 on malformed XML
+static int readSlaXmlTag(SLA_XML_READER& reader, SLA_XML_TAG& tag)
 {
-    m_constructor_count = m_tree.get("sleigh.symbol_table.subtable_sym.<xmlattr>.numct", 0);
+    size_t offset = 0;
+    int ch = 0;
 
-    for(auto &constructor_node : m_tree.get_child("sleigh.symbol_table.subtable_sym"))
+    if(reader.is_packed)
     {
-        CONSTRUCTOR temp_constructor = {};
-        vector<unsigned int> ids;
+        return readSlaPackedTag(reader, tag);
+    }
+
+    tag.name.clear();
+    tag.attributes.clear();
+    tag.is_end = false;
+    tag.is_empty = false;
+
+    while(true)
+    {
+        int skip = 0;
+
+        // skip text up to the next tag
+        ch = peekSlaXmlChar(reader, 0);
+        if(ch < 0)
+        {
+            return 0;
+        }
 
-        if(constructor_node.first != "constructor")
+        if(ch != '<')
         {
+            reader.pos++;
             continue;
         }
 
-        temp_constructor.constructor_length = constructor_node.second.get("<xmlattr>.length", 0);
-        temp_constructor.source_file = constructor_node.second.get("<xmlattr>.source", 0);
-        temp_constructor.line_number = constructor_node.second.get("<xmlattr>.line", 0);
+        ch = peekSlaXmlChar(reader, 1);
+        if(ch == '?')
+        {
+            skip = skipSlaXmlUntil(reader, 2, "?>");
+        }
+        else if(ch == '!' &&
+                peekSlaXmlChar(reader, 2) == '-' &&
+                peekSlaXmlChar(reader, 3) == '-')
+        {
+            skip = skipSlaXmlUntil(reader, 4, "-->");
+        }
+        else if(ch == '!' && peekSlaXmlChar(reader, 2) == '[')
+        {
+            skip = skipSlaXmlUntil(reader, 3, "]]>");
+        }
+        else if(ch == '!')
+        {
+            skip = skipSlaXmlUntil(reader, 2, ">");
+        }
+        else
+        {
+            break;
+        }
+
+        if(skip < 0)
+        {
+            return -1;
+        }
+    }
 
-        // todo: should we check constructor.parent = 0?
+    offset = 1;
+    if(peekSlaXmlChar(reader, offset) == '/')
+    {
+        tag.is_end = true;
+        offset++;
+    }
 
-        for(auto &constructor_node_child : constructor_node.second)
+    while((ch = peekSlaXmlChar(reader, offset)) >= 0 &&
+          !isSlaXmlSpace(ch) && ch != '>' && ch != '/')
+    {
+        tag.name.push_back(ch);
+        offset++;
+    }
+
+    if(tag.name.size() == 0)
+    {
+        return -1;
+    }
+
+    while(true)
+    {
+        string attribute_name;
+        string attribute_value;
+        int quote = 0;
+
+        while(isSlaXmlSpace(ch = peekSlaXmlChar(reader, offset)))
         {
-            if(constructor_node_child.first == "<xmlattr>")
-            {
-                continue;
-            }
-            else if(constructor_node_child.first == "construct_tpl")
+            offset++;
+        }
+
+        if(ch < 0)
+        {
+            return -1;
+        }
+
+        if(ch == '>')
+        {
+            offset++;
+            break;
+        }
+
+        if(ch == '/')
+        {
+            if(peekSlaXmlChar(reader, offset + 1) != '>')
             {
-                continue;
+                return -1;
             }
-            else if(constructor_node_child.first == "oper")
-            {
-                string id_str;
-                unsigned int id = 0;
+            tag.is_empty = true;
+            offset += 2;
+            break;
+        }
 
-                id_str = constructor_node_child.second.get("<xmlattr>.id", "");
-                id = stoi(id_str, NULL, 0x10);
-                ids.push_back(id);
-            }
-            else if(constructor_node_child.first == "print")
-            {
-                CONSTRUCTOR_PIECE temp_constructor_piece;
+        if(tag.is_end)
+        {
+            return -1;
+        }
 
-                temp_constructor_piece.type = "print";
-                temp_constructor_piece.id = -1;
-                temp_constructor_piece.part = constructor_node_child.second.get("<xmlattr>.piece", "");
+        while((ch = peekSlaXmlChar(reader, offset)) >= 0 &&
+              !isSlaXmlSpace(ch) && ch != '=' && ch != '>' && ch != '/')
+        {
+            attribute_name.push_back(ch);
+            offset++;
+        }
 
-                temp_constructor.constructor_pieces.push_back(temp_constructor_piece);
-            }
-            else if(constructor_node_child.first == "opprint")
-            {
-                string id_str;
-                unsigned int id = 0;
-                unsigned int id2 = 0;
+        while(isSlaXmlSpace(ch = peekSlaXmlChar(reader, offset)))
+        {
+            offset++;
+        }
 
-                id_str = constructor_node_child.second.get("<xmlattr>.id", "");
-                id = stoi(id_str);
+        if(ch != '=' || attribute_name.size() == 0)
+        {
+            return -1;
+        }
+        offset++;
 
-                CONSTRUCTOR_PIECE temp_constructor_piece;
+        while(isSlaXmlSpace(quote = peekSlaXmlChar(reader, offset)))
+        {
+            offset++;
+        }
 
-                id2 = ids[id];
+        if(quote != '"' && quote != '\'')
+        {
+            return -1;
+        }
+        offset++;
+
+        while((ch = peekSlaXmlChar(reader, offset)) >= 0 && ch != quote)
+        {
+            attribute_value.push_back(ch);
+            offset++;
+        }
+
+        if(ch < 0)
+        {
+            return -1;
+        }
+        offset++;
+
+        decodeSlaXmlEntities(attribute_value);
+        tag.attributes.emplace_back(std::move(attribute_name), std::move(attribute_value));
+    }
+
+    reader.pos += offset;
+    return 1;
+}
+
+// Returns the character offset bytes past the unread data, reading more of
+// the file as needed. Packed files are decompressed as they are read
+// Returns -1 at the end of the file
+int peekSlaXmlChar(SLA_XML_READER& reader, size_t offset)
+{
+    while(reader.pos + offset >= reader.end)
+    {
+        size_t unread = reader.end - reader.pos;
+        long read = 0;
 
-                checkSubsym(id2);
+        // move the unread data, which includes the tag being parsed, to the
+        // front of the buffer
+        if(reader.pos > 0)
+        {
+            memmove(reader.buffer.data(), reader.buffer.data() + reader.pos, unread);
+            reader.pos = 0;
+            reader.end = unread;
+        }
 
-                string var = m_vars[id2];
+        if(reader.buffer.size() < reader.end + SLA_XML_CHUNK_SIZE)
+        {
+            reader.buffer.resize(reader.end + SLA_XML_CHUNK_SIZE);
+        }
 
-                temp_constructor_piece.type = "opprint";
-                temp_constructor_piece.id = id2;
-                temp_constructor_piece.part = var;
+        if(reader.is_packed)
+        {
+            read = readSlaPackedChunk(reader, reader.buffer.data() + reader.end, SLA_XML_CHUNK_SIZE);
+        }
+        else if(reader.ifs)
+        {
+            reader.ifs.read(reader.buffer.data() + reader.end, SLA_XML_CHUNK_SIZE);
+            read = reader.ifs.gcount();
+        }
 
-                // part??
+        if(read <= 0)
+        {
+            return -1;
+        }
 
-                temp_constructor.constructor_pieces.push_back(temp_constructor_piece);
+        reader.end += read;
+    }
+
+    return (unsigned char)reader.buffer[reader.pos + offset];
+}
+
+// Skips from offset past the next occurrence of terminator. The skipped data
+// is consumed. Returns -1 if the terminator is never found
+static int skipSlaXmlUntil(SLA_XML_READER& reader,
+                           size_t offset,
+                           const char* terminator)
+{
+    size_t length = strlen(terminator);
+
+    while(true)
+    {
+        size_t i = 0;
+
+        for(i = 0; i < length; i++)
+        {
+            int ch = peekSlaXmlChar(reader, offset + i);
+            if(ch < 0)
+            {
+                return -1;
             }
-            else
+
+            if(ch != terminator[i])
             {
-                cout << "Unknown constructor node child: " << constructor_node_child.first << endl;
-                return -2;
+                break;
             }
         }
-        m_constructors.push_back(temp_constructor);
+
+        if(i == length)
+        {
+            reader.pos += offset + length;
+            return 0;
+        }
+
+        offset++;
     }
 
-    if(m_constructor_count != m_constructors.size())
+    return -1;
+}
+
+// returns true for XML whitespace
+static bool isSlaXmlSpace(int ch)
+{
+    switch(ch)
     {
-        cout << "Invalid constructors: " << m_constructor_count << " " << m_constructors.size() << endl;
-        return -2;
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            return true;
+        default:
+            return false;
     }
 
-    return SLA_SUCCESS;
+    return false;
 }
 
-// parse the decision pairs from the processor module
-// decision pairs are used to differentiate instructions via their opcode
-int Slautil::parseDecisionPairs(void)
+// replaces the predefined and numeric character references in an attribute
+// value. Unknown references are left as is
+static void decodeSlaXmlEntities(string& value)
 {
-    m_decision_pairs.resize(m_constructor_count);
+    string decoded;
 
-    const boost::property_tree::ptree & subtree = m_tree.get_child("sleigh.symbol_table.subtable_sym.decision");
-    this->recursiveParseDecisionPairs(subtree);
+    if(value.find('&') == string::npos)
+    {
+        return;
+    }
 
-    return SLA_SUCCESS;
-}
+    decoded.reserve(value.size());
 
-// decision pairs can be recursively defined
-int Slautil::recursiveParseDecisionPairs(const boost::property_tree::ptree& subtree)
-{
-    //TODO: why use boost foreach??
-    for(auto &v : subtree)
+    for(size_t i = 0; i < value.size(); i++)
     {
-        if(v.first == "decision")
+        size_t semicolon = 0;
+        string entity;
+        unsigned long code = 0;
+        char* end = NULL;
+
+        if(value[i] != '&' ||
+           (semicolon = value.find(';', i)) == string::npos)
+        {
+            decoded.push_back(value[i]);
+            continue;
+        }
+
+        entity = value.substr(i + 1, semicolon - i - 1);
+
+        if(entity == "lt")
         {
-            this->recursiveParseDecisionPairs(v.second);
+            decoded.push_back('<');
         }
-        else if(v.first == "pair")
+        else if(entity == "gt")
         {
-            this->parseDecisionPair(v.second);
+            decoded.push_back('>');
         }
-        else if(v.first == "<xmlattr>")
+        else if(entity == "amp")
         {
-            continue;
+            decoded.push_back('&');
+        }
+        else if(entity == "quot")
+        {
+            decoded.push_back('"');
+        }
+        else if(entity == "apos")
+        {
+            decoded.push_back('\'');
+        }
+        else if(entity.size() > 1 && entity[0] == '#')
+        {
+            if(entity[1] == 'x' || entity[1] == 'X')
+            {
+                code = strtoul(entity.c_str() + 2, &end, 0x10);
+            }
+            else
+            {
+                code = strtoul(entity.c_str() + 1, &end, 10);
+            }
+
+            if(end == NULL || *end != '\0')
+            {
+                decoded.push_back(value[i]);
+                continue;
+            }
+
+            // encode as UTF-8
+            if(code < 0x80)
+            {
+                decoded.push_back(code);
+            }
+            else if(code < 0x800)
+            {
+                decoded.push_back(0xc0 | (code >> 6));
+                decoded.push_back(0x80 | (code & 0x3f));
+            }
+            else if(code < 0x10000)
+            {
+                decoded.push_back(0xe0 | (code >> 12));
+                decoded.push_back(0x80 | ((code >> 6) & 0x3f));
+                decoded.push_back(0x80 | (code & 0x3f));
+            }
+            else
+            {
+                decoded.push_back(0xf0 | (code >> 18));
+                decoded.push_back(0x80 | ((code >> 12) & 0x3f));
+                decoded.push_back(0x80 | ((code >> 6) & 0x3f));
+                decoded.push_back(0x80 | (code & 0x3f));
+            }
         }
         else
         {
-            cout << "Unknown value!!" << v.first << endl;
-            return -1;
+            decoded.push_back(value[i]);
+            continue;
         }
+
+        i = semicolon;
     }
 
-    return 0;
+    value = std::move(decoded);
 }
 
-// parse an individual decision pair
-int Slautil::parseDecisionPair(const boost::property_tree::ptree& subtree)
+// returns the value of an attribute or NULL if the tag doesn't have it
+static const string* getSlaXmlAttribute(const SLA_XML_TAG& tag,
+                                        const char* name)
 {
-    DECISION_PAIR decision_pair = {};
+    for(auto& attribute: tag.attributes)
+    {
+        if(attribute.first == name)
+        {
+            return &attribute.second;
+        }
+    }
 
-    // todo error checking
-    decision_pair.id = subtree.get("<xmlattr>.id", 0);
-    decision_pair.off = subtree.get("instruct_pat.pat_block.<xmlattr>.off", 0);
-    decision_pair.nonzero = subtree.get("instruct_pat.pat_block.<xmlattr>.nonzero", 0);
-    string mask = subtree.get("instruct_pat.pat_block.mask_word.<xmlattr>.mask", "");
-    string val = subtree.get("instruct_pat.pat_block.mask_word.<xmlattr>.val", "");
+    return NULL;
+}
 
-    decision_pair.mask = stol(mask, NULL, 0x10);
-    decision_pair.val = stol(val, NULL, 0x10);
+// returns the value of an attribute or default_value if the tag doesn't
+// have it
+static string getSlaXmlAttribute(const SLA_XML_TAG& tag,
+                                 const char* name,
+                                 const char* default_value)
+{
+    const string* value = getSlaXmlAttribute(tag, name);
 
-    m_decision_pairs[decision_pair.id] = decision_pair;
+    if(value == NULL)
+    {
+        return default_value;
+    }
 
-    return 0;
+    return *value;
+}
+
+// returns the decimal value of an attribute or default_value if the tag
+// doesn't have it or it isn't a number
+static unsigned int getSlaXmlAttributeUInt(const SLA_XML_TAG& tag,
+                                           const char* name,
+                                           unsigned int default_value)
+{
+    const string* value = getSlaXmlAttribute(tag, name);
+    unsigned long result = 0;
+    char* end = NULL;
+
+    if(value == NULL || value->size() == 0)
+    {
+        return default_value;
+    }
+
+    result = strtoul(value->c_str(), &end, 10);
+    while(end != NULL && isSlaXmlSpace(*end))
+    {
+        end++;
+    }
+
+    if(end == NULL || *end != '\0')
+    {
+        return default_value;
+    }
+
+    return result;
+}
+
+// reads a tokenfield tag
+static void getSlaXmlTokenField(const SLA_XML_TAG& tag, TOKENFIELD& bitfield)
+{
+    bitfield.bigendian = (getSlaXmlAttribute(tag, "bigendian", "") == "true");
+    bitfield.signbit = (getSlaXmlAttribute(tag, "signbit", "") == "true");
+    bitfield.startbit = getSlaXmlAttributeUInt(tag, "startbit", 0);
+    bitfield.endbit = getSlaXmlAttributeUInt(tag, "endbit", 0);
+    bitfield.startbyte = getSlaXmlAttributeUInt(tag, "startbyte", 0);
+    bitfield.endbyte = getSlaXmlAttributeUInt(tag, "endbyte", 0);
+    bitfield.shift = getSlaXmlAttributeUInt(tag, "shift", 0);
+}
+
+// read the variables from the processor module
+int Slautil::parseVars(const SLA_XML_DATA& sla_xml)
+{
+    for(auto& var_head: sla_xml.var_heads)
+    {
+        m_vars.emplace(var_head.first, var_head.second);
+    }
+
+    return SLA_SUCCESS;
+}
+
+// read the subtable sym heads from the processor module
+int Slautil::parseSubtableSymHeads(const SLA_XML_DATA& sla_xml)
+{
+    for(auto& subtable_head: sla_xml.subtable_heads)
+    {
+        m_vars.emplace(subtable_head.first, subtable_head.second);
+    }
+
+    return SLA_SUCCESS;
+}
+
+// read the operand syms from the processor module
+int Slautil::parseOperandSyms(const SLA_XML_DATA& sla_xml)
+{
+    for(auto& subsym: sla_xml.subsyms)
+    {
+        m_subsyms[subsym.first] = subsym.second;
+    }
+
+    for(auto& operand_sym: sla_xml.operand_syms)
+    {
+        m_operand_syms[operand_sym.id] = operand_sym;
+    }
+
+    return SLA_SUCCESS;
+}
+
+// read the instruction constructors from the processor module
+// the opprint pieces are resolved to the operand symbol they print
+int Slautil::parseConstructors(SLA_XML_DATA& sla_xml)
+{
+    m_constructor_count = sla_xml.constructor_count;
+    m_constructors.reserve(sla_xml.constructors.size());
+
+    for(auto& sla_xml_constructor: sla_xml.constructors)
+    {
+        for(auto& constructor_piece: sla_xml_constructor.constructor.constructor_pieces)
+        {
+            unsigned int id = 0;
+
+            if(constructor_piece.type != "opprint")
+            {
+                continue;
+            }
+
+            if(constructor_piece.id >= sla_xml_constructor.operand_ids.size())
+            {
+                cout << "Invalid opprint id: " << constructor_piece.id << endl;
+                return -2;
+            }
+
+            id = sla_xml_constructor.operand_ids[constructor_piece.id];
+
+            checkSubsym(id);
+
+            constructor_piece.id = id;
+            constructor_piece.part = m_vars[id];
+        }
+
+        m_constructors.push_back(std::move(sla_xml_constructor.constructor));
+    }
+
+    if(m_constructor_count != m_constructors.size())
+    {
+        cout << "Invalid constructors: " << m_constructor_count << " " << m_constructors.size() << endl;
+        return -2;
+    }
+
+    return SLA_SUCCESS;
+}
+
+// parse the decision pairs from the processor module
+// decision pairs are used to differentiate instructions via their opcode
+int Slautil::parseDecisionPairs(const SLA_XML_DATA& sla_xml)
+{
+    m_decision_pairs.resize(m_constructor_count);
+
+    for(auto& decision_pair: sla_xml.decision_pairs)
+    {
+        if(decision_pair.id >= m_decision_pairs.size())
+        {
+            cout << "Invalid decision pair id: " << decision_pair.id << endl;
+            return -1;
+        }
+
+        m_decision_pairs[decision_pair.id] = decision_pair;
+    }
+
+    return SLA_SUCCESS;
 }
 
 // convert the decision pairs into opcode bit patterns
@@ -343,71 +1108,22 @@ int Slautil::convertDecisionPairsToBitPatterns(void)
 }
 
 // read the varlist syms from the processor module
-int Slautil::parseVarlistSym(void)
+int Slautil::parseVarlistSym(SLA_XML_DATA& sla_xml)
 {
-    for(auto &varlist_sym_node : m_tree.get_child("sleigh.symbol_table"))
+    for(auto& curr_varlist_sym: sla_xml.varlist_syms)
     {
-        varlist_sym curr_varlist_sym;
-
-        if(varlist_sym_node.first != "varlist_sym")
-        {
-            continue;
-        }
-
-        //cout << varlist_sym_node.first  << endl;
-
-        std::string id_str = varlist_sym_node.second.get("<xmlattr>.id", "");
-        curr_varlist_sym.id = stoi(id_str, 0, 0x10);
-
-        curr_varlist_sym.bitfield.startbit = varlist_sym_node.second.get("tokenfield.<xmlattr>.startbit", 0);
-        curr_varlist_sym.bitfield.endbit = varlist_sym_node.second.get("tokenfield.<xmlattr>.endbit", 0);
-        curr_varlist_sym.bitfield.startbyte = varlist_sym_node.second.get("tokenfield.<xmlattr>.startbyte", 0);
-        curr_varlist_sym.bitfield.endbyte = varlist_sym_node.second.get("tokenfield.<xmlattr>.endbyte", 0);
-        curr_varlist_sym.bitfield.shift = varlist_sym_node.second.get("tokenfield.<xmlattr>.shift", 0);
-
-        //cout << curr_varlist_sym.bitfield.startbit  << " " <<  curr_varlist_sym.bitfield.endbit << endl;
-
-        for(auto &var_node : varlist_sym_node.second)
-        {
-            if(var_node.first != "var")
-            {
-                continue;
-            }
-
-            std::string var_id_str = var_node.second.get("<xmlattr>.id", "");
-            unsigned int var_id = stoi(var_id_str, 0, 0x10);
-            curr_varlist_sym.register_ids.push_back(var_id);
-
-        }
-
-        m_varlist_syms[curr_varlist_sym.id] = curr_varlist_sym;
+        unsigned int id = curr_varlist_sym.id;
+        m_varlist_syms[id] = std::move(curr_varlist_sym);
     }
 
     return SLA_SUCCESS;
 }
 
 // read the registers from the processor module
-int Slautil::parseRegisters(void)
+int Slautil::parseRegisters(const SLA_XML_DATA& sla_xml)
 {
-    for(auto &v : m_tree.get_child("sleigh.symbol_table"))
+    for(auto id: sla_xml.register_ids)
     {
-        if(v.first != "varnode_sym")
-        {
-            continue;
-        }
-
-        // TODO: throws if missing
-        std::string space = v.second.get_child("<xmlattr>.space").data();
-        if(space != "register")
-        {
-            continue;
-        }
-        //cout << space << endl;
-
-        std::string id_str = v.second.get_child("<xmlattr>.id").data();
-
-        unsigned int id = stoi(id_str, 0, 0x10);
-
         boost::unordered_map<unsigned int, std::string> ::iterator itr;
 
         itr = m_vars.find(id);
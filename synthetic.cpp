@@ -0,0 +1,680 @@
+//-----------------------------------------------------------------------------
+// File: synthetic.cpp
+//
+// Generates synthetic but realistic disassembly text files for scale testing.
+// The output is in the same "0x<opcode> <instruction>" format the generator
+// parses.
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <boost/program_options.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/timer/timer.hpp>
+#include <boost/unordered_map.hpp>
+#include "parser.h"
+using namespace std;
+
+// size of the output buffer before it is flushed to disk
+#define SYNTHETIC_BUFFER_SIZE (4 * 1024 * 1024)
+
+// the generator only supports up to this many operands per instruction to
+// stay well below MAX_TOKENS
+#define SYNTHETIC_MAX_OPERANDS 4
+
+enum SYNTHETIC_FIELD_TYPE
+{
+    FIELD_REGISTER = 0,  // register field. Ex: r0-r15
+    FIELD_IMMEDIATE = 1, // immediate field, optionally signed
+    FIELD_SUBOP = 2,     // selects between the mnemonics of a template
+    FIELD_IGNORED = 3,   // bits that don't change the disassembly
+};
+
+enum SYNTHETIC_OPERAND_STYLE
+{
+    STYLE_PLAIN = 0,   // mnem a, b, c
+    STYLE_MEMORY = 1,  // mnem a, @(b, c)
+    STYLE_BRACKET = 2, // mnem a, [b+c]
+    STYLE_MAX = 3,
+};
+
+// a bit field within an instruction template
+typedef struct _SYNTHETIC_FIELD
+{
+    SYNTHETIC_FIELD_TYPE type;
+    unsigned int start; // lowest bit of the field
+    unsigned int width; // number of bits in the field
+    bool isSigned;      // only used for immediates
+} SYNTHETIC_FIELD, *PSYNTHETIC_FIELD;
+
+// describes how to disassemble every opcode sharing the same major opcode
+typedef struct _SYNTHETIC_TEMPLATE
+{
+    // one mnemonic for every value of the subop bits
+    vector<string> mnemonics;
+
+    // all fields of the opcode below the major opcode bits
+    vector<SYNTHETIC_FIELD> fields;
+
+    // register and immediate fields in the order they are printed
+    vector<unsigned int> operands;
+
+    // register class prefix. Ex: "r" for r0-r31
+    string registerPrefix;
+
+    // if not empty a fixed register printed before the other operands. When
+    // a register field holds the same register this creates duplicated
+    // register operands. Ex: mov r0,@(r0,r0)
+    string fixedRegister;
+
+    SYNTHETIC_OPERAND_STYLE style;
+    bool immediatePrefix; // print immediates as #0x10
+} SYNTHETIC_TEMPLATE, *PSYNTHETIC_TEMPLATE;
+
+// options controlling the shape of the synthetic ISA
+typedef struct _SYNTHETIC_OPTIONS
+{
+    string outputFilename;
+    unsigned long long seed;
+    unsigned int opcodeBits;   // widest opcode size, 8, 16, 24 or 32
+    bool variableLength;       // mix 8 bit up to opcodeBits instructions
+    unsigned int majorBits;    // 0 means default for each width
+    unsigned int registerBits; // width of register fields
+    unsigned int maxImmediateBits;
+    double signedRate;         // chance an immediate field is signed
+    double duplicateRegisterRate; // chance a template has a fixed register
+    double ignoredRate;        // chance a template has ignored bits
+    double noiseRate;          // chance a line is an irregular instruction
+    double holeRate;           // chance an opcode is left out as invalid
+    unsigned int shardCount;   // split the opcode space into this many shards
+    unsigned int shardIndex;   // and only write this one
+} SYNTHETIC_OPTIONS, *PSYNTHETIC_OPTIONS;
+
+// register classes present in registers.h with at least 32 registers each
+static const char* g_registerPrefixes[] = {"r", "a", "d", "f", "v"};
+
+// mnemonic suffixes used for the subop bits. Max 3 subop bits per template
+static const char* g_mnemonicSuffixes[] = {"b", "w", "l", "q", "s", "d", "x", "h"};
+
+static const char g_consonants[] = "bcdfghjklmnprstvwz";
+static const char g_vowels[] = "aeiou";
+
+// templates are created on demand and keyed by opcode width and major opcode
+static boost::unordered_map<unsigned long long, SYNTHETIC_TEMPLATE> g_templates;
+
+static int generateSynthetic(SYNTHETIC_OPTIONS& options);
+static unsigned long long splitMix64(unsigned long long x);
+static double toUnitInterval(unsigned long long x);
+static unsigned int getMajorBits(SYNTHETIC_OPTIONS& options, unsigned int opcodeBits);
+static unsigned int getOpcodeBitsFromTopByte(SYNTHETIC_OPTIONS& options, unsigned int topByte);
+static string generateMnemonic(unsigned long long& state, unsigned int syllables);
+static SYNTHETIC_TEMPLATE& getTemplate(SYNTHETIC_OPTIONS& options,
+                                       unsigned int opcodeBits,
+                                       unsigned int major);
+static void createTemplate(SYNTHETIC_OPTIONS& options,
+                           unsigned int opcodeBits,
+                           unsigned int major,
+                           SYNTHETIC_TEMPLATE& newTemplate);
+static void appendOpcode(string& buffer, unsigned int opcodeBits, unsigned long long opcode);
+static void appendImmediate(string& buffer, unsigned long long value, unsigned int width, bool isSigned, bool prefix);
+static void appendInstruction(SYNTHETIC_OPTIONS& options,
+                              string& buffer,
+                              unsigned int opcodeBits,
+                              unsigned long long opcode);
+
+int main(int argc, char *argv[])
+{
+    boost::program_options::options_description desc{"Ghidra Processor Module Generator Synthetic ISA"};
+    boost::program_options::variables_map args;
+    SYNTHETIC_OPTIONS options;
+    int result = 0;
+
+    cout << "Ghidra Processor Module Generator Synthetic ISA" << endl;
+
+    try
+    {
+        desc.add_options()
+            ("output-file,o", boost::program_options::value<string>(&options.outputFilename), "Path of the disassembly text file to create. Required.")
+            ("opcode-bits,w", boost::program_options::value<unsigned int>(&options.opcodeBits)->default_value(16), "Opcode width in bits. Must be 8, 16, 24 or 32. Defaults to 16")
+            ("variable-length", boost::program_options::bool_switch(&options.variableLength), "Mix instructions from 8 bits up to --opcode-bits wide. The first byte selects the length. False by default")
+            ("seed", boost::program_options::value<unsigned long long>(&options.seed)->default_value(1), "Random seed. The same seed and options always create the same file. Defaults to 1")
+            ("major-bits", boost::program_options::value<unsigned int>(&options.majorBits)->default_value(0), "Number of major opcode bits selecting the instruction format. Defaults to 3, 4, 6 or 8 depending on the opcode width")
+            ("register-bits", boost::program_options::value<unsigned int>(&options.registerBits)->default_value(4), "Width of register fields, 1-5 bits. Defaults to 4")
+            ("max-immediate-bits", boost::program_options::value<unsigned int>(&options.maxImmediateBits)->default_value(12), "Maximum width of immediate fields, 2-31 bits. Defaults to 12")
+            ("signed-rate", boost::program_options::value<double>(&options.signedRate)->default_value(0.3), "Fraction of immediate fields that are signed. Defaults to 0.3")
+            ("duplicate-register-rate", boost::program_options::value<double>(&options.duplicateRegisterRate)->default_value(0.1), "Fraction of instruction formats with a fixed register that can duplicate a register operand. Defaults to 0.1")
+            ("ignored-rate", boost::program_options::value<double>(&options.ignoredRate)->default_value(0.05), "Fraction of instruction formats with bits that don't change the disassembly. Defaults to 0.05")
+            ("noise-rate", boost::program_options::value<double>(&options.noiseRate)->default_value(0.001), "Fraction of opcodes replaced with an irregular instruction that can't be combined. Defaults to 0.001")
+            ("hole-rate", boost::program_options::value<double>(&options.holeRate)->default_value(0.01), "Fraction of opcodes left out as invalid. Defaults to 0.01")
+            ("shard-count", boost::program_options::value<unsigned int>(&options.shardCount)->default_value(1), "Split the opcode space by its top bits into this many shards. Must be a power of 2. Defaults to 1")
+            ("shard-index", boost::program_options::value<unsigned int>(&options.shardIndex)->default_value(0), "Which shard to write. Defaults to 0")
+            ("help,h", "Help screen");
+
+        store(parse_command_line(argc, argv, desc), args);
+        notify(args);
+
+        if(args.count("help") || argc == 1)
+        {
+            cout << desc << endl;
+            return 0;
+        }
+
+        if(args.count("output-file") == 0)
+        {
+            cout << "Output file name is required!!" << endl;
+            return -1;
+        }
+
+        if(options.opcodeBits != 8 && options.opcodeBits != 16 &&
+           options.opcodeBits != 24 && options.opcodeBits != 32)
+        {
+            cout << "Opcode bits must be 8, 16, 24 or 32" << endl;
+            return -1;
+        }
+
+        if(options.majorBits > 8 || options.majorBits >= options.opcodeBits)
+        {
+            cout << "Major bits must be at most 8 and less than the opcode bits" << endl;
+            return -1;
+        }
+
+        if(options.registerBits < 1 || options.registerBits > 5)
+        {
+            cout << "Register bits must be between 1 and 5" << endl;
+            return -1;
+        }
+
+        if(options.maxImmediateBits < 2 || options.maxImmediateBits > 31)
+        {
+            cout << "Max immediate bits must be between 2 and 31" << endl;
+            return -1;
+        }
+
+        if(options.shardCount == 0 ||
+           (options.shardCount & (options.shardCount - 1)) != 0)
+        {
+            cout << "Shard count must be a power of 2" << endl;
+            return -1;
+        }
+
+        // variable length ISAs are sharded on the first byte
+        if((options.variableLength && options.shardCount > 256) ||
+           (options.shardCount > (1ULL << (options.opcodeBits - 1))))
+        {
+            cout << "Too many shards for the opcode width" << endl;
+            return -1;
+        }
+
+        if(options.shardIndex >= options.shardCount)
+        {
+            cout << "Shard index must be less than the shard count" << endl;
+            return -1;
+        }
+    }
+    catch (const boost::program_options::error &ex)
+    {
+        cout << "[-] Error parsing command line: " << ex.what() << endl;
+        return -1;
+    }
+
+    // needed to keep generated mnemonics from colliding with registers
+    initRegisters();
+
+    result = generateSynthetic(options);
+    if(result != 0)
+    {
+        return result;
+    }
+
+    return 0;
+}
+
+// splitmix64 finalizer. Used both as a cheap PRNG and to derive per opcode
+// random values so any shard can be generated independently of the others
+static unsigned long long splitMix64(unsigned long long x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// converts a random 64-bit value to [0, 1)
+static double toUnitInterval(unsigned long long x)
+{
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// number of major opcode bits for an opcode width
+static unsigned int getMajorBits(SYNTHETIC_OPTIONS& options, unsigned int opcodeBits)
+{
+    if(options.majorBits != 0 && options.majorBits < opcodeBits)
+    {
+        return options.majorBits;
+    }
+
+    switch(opcodeBits)
+    {
+        case 8:
+            return 3;
+        case 16:
+            return 4;
+        case 24:
+            return 6;
+        default:
+            return 8;
+    }
+}
+
+// For variable length ISAs the first byte selects the length. The first byte
+// range is split evenly between all lengths. Fixed length ISAs always return
+// opcodeBits
+static unsigned int getOpcodeBitsFromTopByte(SYNTHETIC_OPTIONS& options, unsigned int topByte)
+{
+    unsigned int numLengths = options.opcodeBits / 8;
+
+    if(options.variableLength == false)
+    {
+        return options.opcodeBits;
+    }
+
+    return ((topByte * numLengths) / 256 + 1) * 8;
+}
+
+// creates a pronounceable mnemonic that is not a known register
+static string generateMnemonic(unsigned long long& state, unsigned int syllables)
+{
+    string mnemonic;
+
+    do
+    {
+        mnemonic.clear();
+        for(unsigned int i = 0; i < syllables; i++)
+        {
+            state = splitMix64(state);
+            mnemonic.push_back(g_consonants[state % (sizeof(g_consonants) - 1)]);
+            mnemonic.push_back(g_vowels[(state >> 16) % (sizeof(g_vowels) - 1)]);
+        }
+
+        // add a trailing consonant half the time. Ex: "mov" vs "mo"
+        if(state & (1ULL << 40))
+        {
+            mnemonic.push_back(g_consonants[(state >> 32) % (sizeof(g_consonants) - 1)]);
+        }
+    } while(isRegister(mnemonic));
+
+    return mnemonic;
+}
+
+// returns the template for the major opcode, creating it if needed
+static SYNTHETIC_TEMPLATE& getTemplate(SYNTHETIC_OPTIONS& options,
+                                       unsigned int opcodeBits,
+                                       unsigned int major)
+{
+    unsigned long long key = ((unsigned long long)opcodeBits << 32) | major;
+
+    auto itr = g_templates.find(key);
+    if(itr != g_templates.end())
+    {
+        return itr->second;
+    }
+
+    SYNTHETIC_TEMPLATE& newTemplate = g_templates[key];
+    createTemplate(options, opcodeBits, major, newTemplate);
+    return newTemplate;
+}
+
+// Carves the bits below the major opcode into register, immediate, subop and
+// ignored fields. Only depends on the seed, width and major opcode so every
+// shard sees the same template
+static void createTemplate(SYNTHETIC_OPTIONS& options,
+                           unsigned int opcodeBits,
+                           unsigned int major,
+                           SYNTHETIC_TEMPLATE& newTemplate)
+{
+    unsigned long long state = splitMix64(options.seed ^ ((unsigned long long)opcodeBits << 48) ^ major);
+    unsigned int remaining = opcodeBits - getMajorBits(options, opcodeBits);
+    unsigned int numOperands = 0;
+    unsigned int subopBits = 0;
+    bool hasIgnored = false;
+    string mnemonic;
+
+    state = splitMix64(state);
+    hasIgnored = toUnitInterval(state) < options.ignoredRate;
+
+    // walk from the most significant free bit down to bit 0
+    while(remaining > 0)
+    {
+        SYNTHETIC_FIELD field = {FIELD_SUBOP, 0, 1, false};
+        unsigned int choice = 0;
+
+        state = splitMix64(state);
+        choice = state % 100;
+
+        if(hasIgnored && choice < 10)
+        {
+            field.type = FIELD_IGNORED;
+            field.width = 1 + (state >> 8) % 2;
+        }
+        else if(numOperands < SYNTHETIC_MAX_OPERANDS &&
+                choice < 55 &&
+                remaining >= options.registerBits)
+        {
+            field.type = FIELD_REGISTER;
+            field.width = options.registerBits;
+        }
+        else if(numOperands < SYNTHETIC_MAX_OPERANDS &&
+                choice < 85 &&
+                remaining >= 2)
+        {
+            unsigned int maxWidth = min(remaining, options.maxImmediateBits);
+
+            field.type = FIELD_IMMEDIATE;
+            field.width = 2 + (state >> 8) % (maxWidth - 1);
+            field.isSigned = toUnitInterval(splitMix64(state)) < options.signedRate;
+        }
+        else if(subopBits < 3)
+        {
+            field.type = FIELD_SUBOP;
+            field.width = 1;
+        }
+        else if(numOperands < SYNTHETIC_MAX_OPERANDS)
+        {
+            // out of subop bits, soak up the rest as an immediate
+            field.type = FIELD_IMMEDIATE;
+            field.width = min(remaining, options.maxImmediateBits);
+            field.isSigned = false;
+        }
+        else
+        {
+            field.type = FIELD_IGNORED;
+            field.width = 1;
+        }
+
+        if(field.width > remaining)
+        {
+            field.width = remaining;
+        }
+
+        remaining -= field.width;
+        field.start = remaining;
+
+        if(field.type == FIELD_REGISTER || field.type == FIELD_IMMEDIATE)
+        {
+            newTemplate.operands.push_back(newTemplate.fields.size());
+            numOperands++;
+        }
+        else if(field.type == FIELD_SUBOP)
+        {
+            subopBits += field.width;
+        }
+
+        newTemplate.fields.push_back(field);
+    }
+
+    // one mnemonic per subop value, sharing a base name. Ex: mov.b mov.w
+    state = splitMix64(state);
+    mnemonic = generateMnemonic(state, 1 + state % 3);
+    for(unsigned int i = 0; i < (1U << subopBits); i++)
+    {
+        if(subopBits == 0)
+        {
+            newTemplate.mnemonics.push_back(mnemonic);
+        }
+        else
+        {
+            newTemplate.mnemonics.push_back(mnemonic + "." + g_mnemonicSuffixes[i]);
+        }
+    }
+
+    // the operands are not always printed in bit order
+    state = splitMix64(state);
+    if(newTemplate.operands.size() > 1 && (state & 1))
+    {
+        std::reverse(newTemplate.operands.begin(), newTemplate.operands.end());
+    }
+
+    state = splitMix64(state);
+    newTemplate.registerPrefix = g_registerPrefixes[state % (sizeof(g_registerPrefixes)/sizeof(g_registerPrefixes[0]))];
+
+    state = splitMix64(state);
+    if(toUnitInterval(state) < options.duplicateRegisterRate)
+    {
+        newTemplate.fixedRegister = newTemplate.registerPrefix + "0";
+    }
+
+    state = splitMix64(state);
+    newTemplate.style = (SYNTHETIC_OPERAND_STYLE)(state % STYLE_MAX);
+
+    state = splitMix64(state);
+    newTemplate.immediatePrefix = (state & 1);
+}
+
+// appends "0x<opcode>" zero padded to the opcode width
+static void appendOpcode(string& buffer, unsigned int opcodeBits, unsigned long long opcode)
+{
+    static const char hexDigits[] = "0123456789ABCDEF";
+
+    buffer += "0x";
+    for(int i = opcodeBits - 4; i >= 0; i -= 4)
+    {
+        buffer.push_back(hexDigits[(opcode >> i) & 0xf]);
+    }
+}
+
+// appends an immediate value. Signed immediates are printed as -0x10
+static void appendImmediate(string& buffer, unsigned long long value, unsigned int width, bool isSigned, bool prefix)
+{
+    char temp[32] = {0};
+
+    if(prefix)
+    {
+        buffer += "#";
+    }
+
+    if(isSigned && (value & (1ULL << (width - 1))))
+    {
+        value = (1ULL << width) - value;
+        buffer += "-";
+    }
+
+    snprintf(temp, sizeof(temp) - 1, "0x%llx", value);
+    buffer += temp;
+}
+
+// appends one line of disassembly for opcode
+static void appendInstruction(SYNTHETIC_OPTIONS& options,
+                              string& buffer,
+                              unsigned int opcodeBits,
+                              unsigned long long opcode)
+{
+    unsigned long long lineRandom = splitMix64(options.seed ^ splitMix64(((unsigned long long)opcodeBits << 56) ^ opcode));
+    unsigned int majorBits = getMajorBits(options, opcodeBits);
+    unsigned int subop = 0;
+    vector<string> operands;
+
+    // leave holes in the opcode space for invalid instructions
+    if(toUnitInterval(lineRandom) < options.holeRate)
+    {
+        return;
+    }
+
+    appendOpcode(buffer, opcodeBits, opcode);
+    buffer += " ";
+
+    // irregular instruction that won't combine with its neighbors
+    lineRandom = splitMix64(lineRandom);
+    if(toUnitInterval(lineRandom) < options.noiseRate)
+    {
+        buffer += generateMnemonic(lineRandom, 4) + " ";
+        appendImmediate(buffer, opcode, opcodeBits, false, false);
+        buffer += "\n";
+        return;
+    }
+
+    SYNTHETIC_TEMPLATE& currTemplate = getTemplate(options,
+                                                   opcodeBits,
+                                                   opcode >> (opcodeBits - majorBits));
+
+    for(auto& field: currTemplate.fields)
+    {
+        if(field.type == FIELD_SUBOP)
+        {
+            subop = (subop << field.width) | ((opcode >> field.start) & ((1ULL << field.width) - 1));
+        }
+    }
+
+    for(auto operand: currTemplate.operands)
+    {
+        PSYNTHETIC_FIELD field = &currTemplate.fields[operand];
+        unsigned long long value = (opcode >> field->start) & ((1ULL << field->width) - 1);
+        string text;
+
+        if(field->type == FIELD_REGISTER)
+        {
+            text = currTemplate.registerPrefix + to_string(value);
+        }
+        else
+        {
+            appendImmediate(text, value, field->width, field->isSigned, currTemplate.immediatePrefix);
+        }
+
+        operands.push_back(text);
+    }
+
+    if(currTemplate.fixedRegister.length() > 0)
+    {
+        operands.insert(operands.begin(), currTemplate.fixedRegister);
+    }
+
+    buffer += currTemplate.mnemonics[subop];
+
+    for(unsigned int i = 0; i < operands.size(); i++)
+    {
+        // the last two operands form the memory operand if the style has one
+        bool isMemoryBase = (currTemplate.style != STYLE_PLAIN &&
+                             operands.size() >= 2 &&
+                             i == operands.size() - 2);
+        bool isMemoryOffset = (currTemplate.style != STYLE_PLAIN &&
+                               operands.size() >= 2 &&
+                               i == operands.size() - 1);
+
+        if(i == 0)
+        {
+            buffer += " ";
+        }
+        else if(isMemoryOffset && currTemplate.style == STYLE_BRACKET)
+        {
+            buffer += "+";
+        }
+        else
+        {
+            buffer += ",";
+        }
+
+        if(isMemoryBase)
+        {
+            buffer += (currTemplate.style == STYLE_MEMORY) ? "@(" : "[";
+        }
+
+        buffer += operands[i];
+
+        if(isMemoryOffset)
+        {
+            buffer += (currTemplate.style == STYLE_MEMORY) ? ")" : "]";
+        }
+    }
+
+    buffer += "\n";
+}
+
+// Writes every opcode of the selected shard to the output file. Lines are
+// built in a large buffer and streamed to disk so memory use stays flat no
+// matter how big the ISA is
+static int generateSynthetic(SYNTHETIC_OPTIONS& options)
+{
+    boost::timer::auto_cpu_timer t;
+    unsigned long long numLines = 0;
+    unsigned int shardBits = 0;
+    string buffer;
+
+    boost::filesystem::path outfile{options.outputFilename};
+    boost::filesystem::ofstream ofs{outfile, std::ios::binary};
+
+    if(!ofs)
+    {
+        cout << "[-] Failed to open output file!!" << endl;
+        return -1;
+    }
+
+    while((1U << shardBits) < options.shardCount)
+    {
+        shardBits++;
+    }
+
+    cout << "[*] Writing " << options.opcodeBits << "-bit";
+    cout << (options.variableLength ? " variable length" : "");
+    cout << " ISA shard " << options.shardIndex << "/" << options.shardCount;
+    cout << " to " << options.outputFilename << endl;
+
+    buffer.reserve(SYNTHETIC_BUFFER_SIZE + 256);
+
+    if(options.variableLength == false)
+    {
+        unsigned long long shardSize = (1ULL << (options.opcodeBits - shardBits));
+        unsigned long long start = options.shardIndex * shardSize;
+        unsigned long long end = start + shardSize;
+
+        for(unsigned long long opcode = start; opcode < end; opcode++)
+        {
+            appendInstruction(options, buffer, options.opcodeBits, opcode);
+            numLines++;
+
+            if(buffer.size() >= SYNTHETIC_BUFFER_SIZE)
+            {
+                ofs.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+    }
+    else
+    {
+        // the first byte decides the length, shard on the first byte
+        unsigned int shardSize = 256 >> shardBits;
+        unsigned int start = options.shardIndex * shardSize;
+        unsigned int end = start + shardSize;
+
+        for(unsigned int topByte = start; topByte < end; topByte++)
+        {
+            unsigned int opcodeBits = getOpcodeBitsFromTopByte(options, topByte);
+            unsigned long long count = (1ULL << (opcodeBits - 8));
+
+            for(unsigned long long i = 0; i < count; i++)
+            {
+                unsigned long long opcode = ((unsigned long long)topByte << (opcodeBits - 8)) | i;
+
+                appendInstruction(options, buffer, opcodeBits, opcode);
+                numLines++;
+
+                if(buffer.size() >= SYNTHETIC_BUFFER_SIZE)
+                {
+                    ofs.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+        }
+    }
+
+    ofs.write(buffer.data(), buffer.size());
+    ofs.close();
+
+    if(!ofs)
+    {
+        cout << "[-] Failed to write output file!!" << endl;
+        return -1;
+    }
+
+    cout << "[*] Enumerated " << numLines << " opcodes (" << g_templates.size() << " instruction formats)" << endl;
+    return 0;
+}
@@ -0,0 +1,157 @@
+//-----------------------------------------------------------------------------
+// File: token_fields.cpp
+//
+// Registry of the fields of the "define token" sections of the .slaspec
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#include <algorithm>
+#include "token_fields.h"
+
+using namespace std;
+
+// name of an opcode or immediate field. Ex: "opcode_12_15_16b"
+string getTokenFieldName(TokenFieldKind kind,
+                         unsigned int start,
+                         unsigned int end,
+                         unsigned int width)
+{
+    char nameBuf[32] = {0};
+
+    snprintf(nameBuf,
+             sizeof(nameBuf) - 1,
+             "%s_%02u_%02u_%ub",
+             kind == TOKEN_FIELD_IMMEDIATE ? "imm" : "opcode",
+             start,
+             end,
+             width);
+
+    return nameBuf;
+}
+
+// default constructor
+TokenFields::TokenFields(void)
+{
+}
+
+// packs a field into a key:
+// - bits 56-63 width
+// - bits 48-55 kind
+// - bits 40-47 start
+// - bits 32-39 end
+// - bits 0-31 name id
+unsigned long long TokenFields::getKey(TokenFieldKind kind,
+                                       unsigned int start,
+                                       unsigned int end,
+                                       unsigned int width,
+                                       unsigned int name_id)
+{
+    return ((unsigned long long)(width & 0xff) << 56) |
+           ((unsigned long long)(kind & 0xff) << 48) |
+           ((unsigned long long)(start & 0xff) << 40) |
+           ((unsigned long long)(end & 0xff) << 32) |
+           name_id;
+}
+
+TOKEN_FIELD TokenFields::getField(unsigned long long key)
+{
+    TOKEN_FIELD field;
+
+    field.width = (key >> 56) & 0xff;
+    field.kind = (TokenFieldKind)((key >> 48) & 0xff);
+    field.start = (key >> 40) & 0xff;
+    field.end = (key >> 32) & 0xff;
+    field.nameId = key & 0xffffffff;
+
+    // we can't tell the difference between an unsigned immediate and a
+    // positive signed immediate, so immediates are defined both ways
+    field.hasSigned = (field.kind == TOKEN_FIELD_IMMEDIATE);
+
+    return field;
+}
+
+void TokenFields::add(const TOKEN_FIELD_KEYS& keys)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_keys.insert(keys.begin(), keys.end());
+}
+
+// attach variable names are unique, so each is added once
+void TokenFields::addRegister(const string& name,
+                              unsigned int start,
+                              unsigned int end,
+                              unsigned int width)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_keys.insert(getKey(TOKEN_FIELD_REGISTER, start, end, width, m_register_names.size()));
+    m_register_names.push_back(name);
+}
+
+bool TokenFields::hasWidth(unsigned int width)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    auto itr = m_keys.lower_bound(getKey(TOKEN_FIELD_OPCODE, 0, 0, width, 0));
+
+    return itr != m_keys.end() && getField(*itr).width == width;
+}
+
+string TokenFields::render(unsigned int width)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    vector<pair<string, TOKEN_FIELD>> fields;
+    string output;
+
+    for(auto itr = m_keys.lower_bound(getKey(TOKEN_FIELD_OPCODE, 0, 0, width, 0));
+        itr != m_keys.end();
+        itr++)
+    {
+        TOKEN_FIELD field = getField(*itr);
+        if(field.width != width)
+        {
+            break;
+        }
+
+        if(field.kind == TOKEN_FIELD_REGISTER)
+        {
+            fields.push_back({m_register_names[field.nameId], field});
+        }
+        else
+        {
+            fields.push_back({getTokenFieldName(field.kind, field.start, field.end, field.width), field});
+        }
+    }
+
+    sort(fields.begin(),
+         fields.end(),
+         [](const pair<string, TOKEN_FIELD>& left, const pair<string, TOKEN_FIELD>& right)
+         {
+             return left.first < right.first;
+         });
+
+    for(auto& field: fields)
+    {
+        string bits = " = (" + to_string(field.second.start) + ", " + to_string(field.second.end) + ")";
+
+        output += "\t" + field.first + bits + "\n";
+
+        if(field.second.hasSigned)
+        {
+            output += "\ts" + field.first + bits + " signed\n";
+        }
+    }
+
+    return output;
+}
+
+// removes all fields
+void TokenFields::clear(void)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_keys.clear();
+    m_register_names.clear();
+}
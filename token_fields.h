@@ -0,0 +1,92 @@
+//-----------------------------------------------------------------------------
+// File: token_fields.h
+//
+// Registry of the fields of the "define token" sections of the .slaspec
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_set.hpp>
+
+using namespace std;
+
+// kinds of token fields. The fields are rendered sorted by name, so the order
+// here doesn't matter
+enum TokenFieldKind
+{
+    TOKEN_FIELD_OPCODE = 0, // fixed opcode bits. Ex: "opcode_12_15_16b"
+    TOKEN_FIELD_IMMEDIATE, // also defined signed. Ex: "imm_00_07_16b", "simm_00_07_16b"
+    TOKEN_FIELD_REGISTER, // named after its attach variable. Ex: "regA_08_11_16b"
+};
+
+// a field of an opcode, bit 0 is the last bit of the opcode
+typedef struct _TOKEN_FIELD
+{
+    TokenFieldKind kind;
+    unsigned int start;
+    unsigned int end;
+    unsigned int width; // opcode length in bits
+    bool hasSigned; // defined as a signed field as well
+    unsigned int nameId; // registers only, id of the attach variable name
+} TOKEN_FIELD, *PTOKEN_FIELD;
+
+// keys of token fields, see TokenFields::getKey()
+typedef boost::unordered_set<unsigned long long> TOKEN_FIELD_KEYS;
+
+string getTokenFieldName(TokenFieldKind kind,
+                         unsigned int start,
+                         unsigned int end,
+                         unsigned int width);
+
+// The token fields of all combined instructions. Fields are stored by an
+// integer key packing the kind, bits and width of the field, the workers
+// collect keys on their own and add them at once
+class TokenFields
+{
+    public:
+        TokenFields();
+
+        static unsigned long long getKey(TokenFieldKind kind,
+                                         unsigned int start,
+                                         unsigned int end,
+                                         unsigned int width,
+                                         unsigned int name_id);
+        static TOKEN_FIELD getField(unsigned long long key);
+
+        // adds the keys of a worker. Thread safe
+        void add(const TOKEN_FIELD_KEYS& keys);
+
+        // adds the field of a named attach variable
+        void addRegister(const string& name,
+                         unsigned int start,
+                         unsigned int end,
+                         unsigned int width);
+
+        bool hasWidth(unsigned int width);
+
+        // the fields of the "define token" section of an opcode width, one
+        // per line and sorted by name. Ex:
+        //	imm_00_03_16b = (0, 3)
+        //	simm_00_03_16b = (0, 3) signed
+        //	opcode_04_07_16b = (4, 7)
+        //	regA_08_11_16b = (8, 11)
+        //	regA_12_15_16b_2 = (12, 15)
+        string render(unsigned int width);
+
+        void clear(void);
+
+    private:
+        boost::mutex m_mutex;
+
+        // sorted by width first so a width's fields are next to each other
+        set<unsigned long long> m_keys;
+
+        // attach variable names by name id
+        vector<string> m_register_names;
+};
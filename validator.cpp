@@ -8,26 +8,22 @@
 //-----------------------------------------------------------------------------
 
 #include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
-#include <loadimage.hh>
-#include <sleigh.hh>
+#include <boost/range/iterator_range.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/thread.hpp>
+#include "parser.h"
+#include "validator.h"
 using namespace std;
 
-// This is a tiny LoadImage class which feeds the executable bytes to the translator
-// Taken straight from sleighexample.cc
-class MyLoadImage : public LoadImage {
-  uintb baseaddr;
-  int4 length;
-  uint1 *data;
-public:
-  MyLoadImage(uintb ad,uint1 *ptr,int4 sz) : LoadImage("nofile") { baseaddr = ad; data = ptr; length = sz; }
-  virtual void loadFill(uint1 *ptr,int4 size,const Address &addr);
-  virtual string getArchType(void) const { return "myload"; }
-  virtual void adjustVma(long adjust) { }
-};
-
 // This is the only important method for the LoadImage. It returns bytes from the static array
 // depending on the address range requested
 void MyLoadImage::loadFill(uint1 *ptr,int4 size,const Address &addr)
@@ -37,7 +33,7 @@ void MyLoadImage::loadFill(uint1 *ptr,int4 size,const Address &addr)
   uintb max = baseaddr + (length-1);
   for(int4 i=0;i<size;++i) {	// For every byte requestes
     uintb curoff = start + i; // Calculate offset of byte
-    if ((curoff < baseaddr)||(curoff>max)) {	// If byte does not fall in window
+    if ((length == 0)||(curoff < baseaddr)||(curoff>max)) {	// If byte does not fall in window
       ptr[i] = 0;		// return 0
       continue;
     }
@@ -46,32 +42,30 @@ void MyLoadImage::loadFill(uint1 *ptr,int4 size,const Address &addr)
   }
 }
 
-// Here is a simple class for emitting assembly.  In this case, we send the strings straight
-// to standard out.
-class AssemblyRaw : public AssemblyEmit {
-public:
-  virtual void dump(const Address &addr,const string &mnem,const string &body) {
-        disassembly = mnem + " " + body;
-        boost::trim(disassembly);
-  }
-  string disassembly;
-};
+void AssemblyRaw::dump(const Address &addr,const string &mnem,const string &body)
+
+{
+  disassembly = mnem + " " + body;
+  boost::trim(disassembly);
+}
 
 // converts unsigned char to two byte hex value
 #define CHAR2HEX( x ) setw(2) << setfill('0') << uppercase << hex << (unsigned int)x
 
-int parseInputAndDisassemble(string& inputFilename, string& outputFilename, string& slaFilename);
-int convertOpcodeToBinary(string& opcode, vector<unsigned char>& opcodeBytes);
-int convertHexNibbletoInteger(unsigned char x);
-int sleighDisassemble(string& slaFilename, vector<unsigned char>& opcodeBytes, string& disassembly);
-
 int main(int argc, char *argv[])
 {
     boost::program_options::options_description desc{"Ghidra Processor Module Generator Validator"};
     boost::program_options::variables_map args;
     string inputFilename;
     string outputFilename;
-    string slaFilename;
+    string jsonFilename;
+    string scanFilename;
+    string slaPath;
+    unsigned long long scanSamples = VALIDATOR_SCAN_DEFAULT_SAMPLES;
+    unsigned long long sampleSize = 0;
+    unsigned int sampleTopBits = VALIDATOR_SAMPLE_DEFAULT_TOP_BITS;
+    vector<string> additionalRegisters;
+    unsigned int numThreads = 0;
     int result = 0;
 
     cout << "Ghidra Processor Module Generator Validator" << endl;
@@ -84,8 +78,15 @@ int main(int argc, char *argv[])
     {
         desc.add_options()
             ("input-file,i", boost::program_options::value<string>(&inputFilename), "Path to a newline delimited text file containing all opcodes and instructions for the processor module. Required.")
-            ("output-file,o",boost::program_options::value<string>(&outputFilename)->default_value("output.txt"), "Output file. Defaults to output.txt if not specified.")
-            ("sla-file,s",boost::program_options::value<string>(&slaFilename), "Path to the compiled processor .sla.")
+            ("output-file,o",boost::program_options::value<string>(&outputFilename)->default_value("mismatches.txt"), "Mismatch report. Lists the instructions SLEIGH disassembles differently than the input file grouped by .slaspec constructor. Defaults to mismatches.txt if not specified.")
+            ("json-file,j",boost::program_options::value<string>(&jsonFilename), "Also write the mismatch report as JSON to this file. Optional.")
+            ("sla-file,s",boost::program_options::value<string>(&slaPath), "Path to the compiled processor .sla. For a module with one .sla per input file, the path to its .ldefs or to a directory of .sla files. Each opcode is disassembled with the .sla files that have a constructor for its leading bits.")
+            ("num-threads,t", boost::program_options::value<unsigned int>(&numThreads), "Number of worker threads to use. Threads using the same .sla at the same time each load their own copy of it. Optional. Defaults to number of physical CPUs if not specified")
+            ("scan-file",boost::program_options::value<string>(&scanFilename), "Scan the whole opcode space for opcodes the .sla decodes that aren't in the input file and write them to this file. The counts per constructor are added to the mismatch report. Optional.")
+            ("scan-samples",boost::program_options::value<unsigned long long>(&scanSamples), "Number of random opcodes scanned when the opcodes are wider than 24 bits. Defaults to 16777216 if not specified.")
+            ("sample",boost::program_options::value<unsigned long long>(&sampleSize), "Only validate a stratified random sample of about this many input lines and estimate the mismatch rate of every stratum. Strata are input lines with the same top opcode bits and mnemonic. Optional.")
+            ("sample-top-bits",boost::program_options::value<unsigned int>(&sampleTopBits), "Number of top opcode bits used to stratify the sample. Defaults to 8 if not specified.")
+            ("additional-registers,ar", boost::program_options::value<vector<string>>(&additionalRegisters)->multitoken(), "List of additional registers. Use the same registers passed to the generator so instructions are normalized the same way")
             ("help,h", "Help screen");
 
         store(parse_command_line(argc, argv, desc), args);
@@ -108,6 +109,48 @@ int main(int argc, char *argv[])
             cout << "Sla file name is required!!" << endl;
             return -1;
         }
+
+        if(args.count("num-threads") == 0)
+        {
+            // user didn't specify number of threads
+            // default to number of physical cpus
+            numThreads = boost::thread::physical_concurrency();
+            if(numThreads == 0)
+            {
+                cout << "Unable to determine number of CPUs. Please specify thread count with --num-threads at the command line." << endl;
+                return -1;
+            }
+        }
+
+        if(numThreads == 0)
+        {
+            cout << "Invalid number of threads specified" << endl;
+            return -1;
+        }
+
+        if(scanSamples == 0)
+        {
+            cout << "Invalid number of scan samples specified" << endl;
+            return -1;
+        }
+
+        if(args.count("sample") && sampleSize == 0)
+        {
+            cout << "Invalid sample size specified" << endl;
+            return -1;
+        }
+
+        if(sampleTopBits == 0 || sampleTopBits > VALIDATOR_SAMPLE_MAX_TOP_BITS)
+        {
+            cout << "Invalid number of sample top bits specified" << endl;
+            return -1;
+        }
+
+        if(args.count("sample") && args.count("scan-file"))
+        {
+            cout << "--scan-file needs every input opcode, it can't be used with --sample" << endl;
+            return -1;
+        }
     }
     catch (const boost::program_options::error &ex)
     {
@@ -116,32 +159,88 @@ int main(int argc, char *argv[])
     }
 
     cout << "[*] Input file: " << inputFilename << endl;
-    cout << "[*] Compiled SLA file: " << slaFilename << endl;
+    cout << "[*] Compiled SLA file: " << slaPath << endl;
     cout << "[*] Outputting (might take a while) to: " << outputFilename << endl;
+    if(jsonFilename.length() > 0)
+    {
+        cout << "[*] JSON report: " << jsonFilename << endl;
+    }
+    if(scanFilename.length() > 0)
+    {
+        cout << "[*] Unlisted opcodes file: " << scanFilename << endl;
+    }
+    if(sampleSize > 0)
+    {
+        cout << "[*] Sampling about " << sampleSize << " lines by top " << sampleTopBits << " opcode bits and mnemonic" << endl;
+    }
+    cout << "[*] Using " << numThreads << " worker thread(s)" << endl;
+
+    // the input instructions are tokenized like the generator does, so it
+    // needs to know the same registers
+    initRegisters();
+    addRegisters(additionalRegisters);
 
-    result = parseInputAndDisassemble(inputFilename, outputFilename, slaFilename);
+    result = parseInputAndDisassemble(inputFilename,
+                                      outputFilename,
+                                      jsonFilename,
+                                      scanFilename,
+                                      slaPath,
+                                      numThreads,
+                                      scanSamples,
+                                      sampleSize,
+                                      sampleTopBits);
     if(result != 0)
     {
         return result;
     }
 
-    cout << "[*] Successfully created output disassembly file. Diff input and output files to find errors in the SLA." << endl;
+    cout << "[*] Successfully created mismatch report. Fix the listed constructors in the .slaspec." << endl;
     return 0;
 }
 
-// Parses the input file for addresses and passes it to the SLEIGH disassembler for output
-int parseInputAndDisassemble(string& inputFilename, string& outputFilename, string& slaFilename)
+// Parses the input file for addresses and passes it to the SLEIGH disassembler
+// for comparison with the input disassembly
+// The input is split into chunks by byte range that are disassembled on
+// numThreads threads, each with its own translator. The mismatches of the
+// chunks are merged in input order and only those are written out
+// If scanFilename is set the opcode space is scanned afterwards for opcodes
+// the .sla decodes that aren't in the input
+// If sampleSize is set only a stratified sample of about sampleSize lines is
+// disassembled. A first pass over the input counts the lines of every stratum
+// slaPath is a .sla, an .ldefs or a directory of .sla files, see
+// getSlaFilenames()
+int parseInputAndDisassemble(string& inputFilename,
+                             string& outputFilename,
+                             string& jsonFilename,
+                             string& scanFilename,
+                             string& slaPath,
+                             unsigned int numThreads,
+                             unsigned long long scanSamples,
+                             unsigned long long sampleSize,
+                             unsigned int sampleTopBits)
 {
-    unsigned int lineNum = 0;
+    VALIDATOR_DATA validatorData;
+    vector<string> slaFilenames;
+    unsigned long long fileSize = 0;
+    unsigned long long start = 0;
     int result = 0;
-    std::string line;
 
     // open the input file for parsing
     boost::filesystem::path infile{inputFilename};
-    boost::filesystem::ifstream ifs{infile};
+    boost::filesystem::ifstream ifs{infile, std::ios::ate};
 
-    boost::filesystem::path outfile{outputFilename};
-    boost::filesystem::ofstream ofs{outfile};
+    validatorData.lines = 0;
+    validatorData.mismatchCount = 0;
+    validatorData.scan = scanFilename.length() > 0;
+    validatorData.scanSampled = false;
+    validatorData.scanBits = 0;
+    validatorData.scanSamples = scanSamples;
+    validatorData.maxOpcodeBytes = 0;
+    validatorData.scanned = 0;
+    validatorData.unlistedCount = 0;
+    validatorData.sample = sampleSize > 0;
+    validatorData.sampleSize = sampleSize;
+    validatorData.sampleTopBits = sampleTopBits;
 
     if(!ifs)
     {
@@ -149,207 +248,1637 @@ int parseInputAndDisassemble(string& inputFilename, string& outputFilename, stri
         return -1;
     }
 
-    if(!ofs)
+    result = getSlaFilenames(slaPath, slaFilenames);
+    if(result != 0)
     {
-        cout << "[-] Failed to open output file!!" << endl;
-        return -1;
+        return result;
+    }
+
+    result = loadLanguages(validatorData, slaFilenames, numThreads);
+    if(result != 0)
+    {
+        goto ERROR_CLEANUP;
     }
 
+    // read the whole input
+    fileSize = ifs.tellg();
+    ifs.seekg(0, std::ios::beg);
+
+    validatorData.input.resize(fileSize);
+    ifs.read(validatorData.input.data(), fileSize);
+    ifs.close();
+
     //
-    // parse the input file line by line
+    // split the input into chunks, each ending at the end of a line
     //
-    while (std::getline(ifs, line))
+    while(start < fileSize)
     {
-        vector<string> lineSplit;
-        vector<unsigned char> opcodeBytes;
-        string disassembly;
+        VALIDATOR_CHUNK chunk;
 
-        lineNum++;
+        chunk.start = start;
+        chunk.end = fileSize - 1;
 
-        // split the line into components
-        boost::split(lineSplit, line, boost::algorithm::is_space(), boost::token_compress_on);
-
-        if(lineSplit.size() < 1)
+        for(unsigned long long j = start + VALIDATOR_CHUNK_SIZE; j < fileSize; j++)
         {
-            continue;
+            if(validatorData.input[j] == '\n')
+            {
+                chunk.end = j;
+                break;
+            }
         }
 
-        result = convertOpcodeToBinary(lineSplit[0], opcodeBytes);
-        if(result != 0)
-        {
-            cout << "Failed to covert opcode!!" << endl;
-            goto exit;
-        }
+        validatorData.chunks.push_back(chunk);
+        start = chunk.end + 1;
+    }
 
-        result = sleighDisassemble(slaFilename, opcodeBytes, disassembly);
+    if(validatorData.sample)
+    {
+        unsigned long long lines = 0;
+        unsigned long long mismatchCount = 0;
+
+        result = runChunkWorkers(validatorData,
+                                 numThreads,
+                                 countStrataWorker,
+                                 lines,
+                                 mismatchCount,
+                                 validatorData.mismatches,
+                                 validatorData.strata,
+                                 NULL);
         if(result != 0)
         {
-            goto exit;
+            goto ERROR_CLEANUP;
         }
 
-        ofs << "0x";
-        for (auto& x: opcodeBytes)
+        allocateSample(validatorData);
+    }
+
+    result = runChunkWorkers(validatorData,
+                             numThreads,
+                             disassembleChunkWorker,
+                             validatorData.lines,
+                             validatorData.mismatchCount,
+                             validatorData.mismatches,
+                             validatorData.sampledStrata,
+                             NULL);
+    if(result != 0)
+    {
+        goto ERROR_CLEANUP;
+    }
+
+    if(validatorData.sample)
+    {
+        for(auto& sampled: validatorData.sampledStrata)
         {
-            ofs << CHAR2HEX(x);
+            PVALIDATOR_STRATUM stratum = &validatorData.strata[sampled.first];
+
+            stratum->sampled = sampled.second.sampled;
+            stratum->mismatches = sampled.second.mismatches;
         }
-        ofs << " " << disassembly;
-        ofs << endl;
+
+        estimateMismatchRates(validatorData);
+
+        cout << "[*] Estimated mismatch rate: " << fixed << setprecision(4) << validatorData.estimate.rate * 100 << "% ";
+        cout << "(95% CI " << validatorData.estimate.low * 100 << "% - " << validatorData.estimate.high * 100 << "%)" << endl;
+        cout.unsetf(ios::fixed);
     }
 
-    result = 0;
+    cout << "[*] " << validatorData.mismatchCount << " of " << validatorData.lines << " instructions mismatched in ";
+    cout << validatorData.mismatches.size() << " constructor(s)" << endl;
 
-exit:
-    ifs.close();
-    ofs.close();
-    return result;
-}
+    if(validatorData.scan)
+    {
+        // the input isn't needed anymore, only its opcodes
+        vector<char>().swap(validatorData.input);
 
-// disassembles opcode bytes using the passed in SLA file
-int sleighDisassemble(string& slaFilename, vector<unsigned char>& opcodeBytes, string& disassembly)
-{
-    unsigned char buffer[4096] = {0};
+        result = scanOpcodeSpace(validatorData, scanFilename, numThreads);
+        if(result != 0)
+        {
+            goto ERROR_CLEANUP;
+        }
+    }
 
-    // initialize instruction to disassemble
-    for(unsigned int i = 0; i < opcodeBytes.size(); i++)
+    result = writeMismatchReport(validatorData, outputFilename);
+    if(result != 0)
     {
-        buffer[i] = opcodeBytes[i];
+        goto ERROR_CLEANUP;
     }
 
-    // instantiate sleigh
-    try
+    if(jsonFilename.length() > 0)
     {
-        MyLoadImage loader(0, (uint1*)buffer, sizeof(buffer));
+        result = writeMismatchJson(validatorData, jsonFilename);
+    }
 
-        // Set up the context object
-        ContextInternal context;
+ERROR_CLEANUP:
+    for(auto& language: validatorData.languages)
+    {
+        for(auto disassembler: language.disassemblers)
+        {
+            delete disassembler;
+        }
+    }
 
-        // Set up the disassembler
-        Sleigh trans(&loader, &context);
+    return result;
+}
 
-        // Read sleigh file into DOM
-        DocumentStorage docstorage;
-        Element *sleighroot = docstorage.openDocument(slaFilename)->getRoot();
-        docstorage.registerTag(sleighroot);
-        trans.initialize(docstorage); // Initialize the translator
+// Lists the .sla files of slaPath. A directory is every .sla in it sorted by
+// name, an .ldefs is the slafile of each of its languages in order, anything
+// else a single .sla
+int getSlaFilenames(const string& slaPath, vector<string>& slaFilenames)
+{
+    boost::filesystem::path p{slaPath};
 
-        AssemblyRaw assememit;	// Set up the disassembly dumper
-        Address addr(trans.getDefaultCodeSpace(), 0); // First disassembly address
+    if(boost::filesystem::is_directory(p))
+    {
+        for(auto& dir_entry: boost::make_iterator_range(boost::filesystem::directory_iterator(p), {}))
+        {
+            if(dir_entry.path().extension() == ".sla")
+            {
+                slaFilenames.push_back(dir_entry.path().string());
+            }
+        }
 
-        // dump the disassembly now
-        trans.printAssembly(assememit, addr);
-        disassembly = assememit.disassembly;
+        sort(slaFilenames.begin(), slaFilenames.end());
     }
-    catch(XmlError e)
+    else if(p.extension() == ".ldefs")
     {
-        cout << "Failed to instantiate SLEIGH. Is processor SLA invalid?" << endl;
-        return -1;
+        boost::filesystem::ifstream ifs{p};
+        boost::regex slafileRegex("slafile=\"([^\"]+)\"");
+        stringstream ldefs;
+
+        if(!ifs)
+        {
+            cout << "[-] Failed to open .ldefs file!!" << endl;
+            return -1;
+        }
+
+        ldefs << ifs.rdbuf();
+        string ldefsText = ldefs.str();
+
+        // the .sla files are next to the .ldefs, see createLdefs()
+        for(boost::sregex_iterator itr(ldefsText.begin(), ldefsText.end(), slafileRegex), end; itr != end; ++itr)
+        {
+            slaFilenames.push_back((p.parent_path() / (*itr)[1].str()).string());
+        }
     }
-    catch(BadDataError e)
+    else
     {
-        // disassembly error, just report it as a success so it appears in the output
-        disassembly = "Error";
-        return 0;
+        slaFilenames.push_back(slaPath);
     }
-    catch(...)
+
+    if(slaFilenames.size() == 0)
     {
-        cout << "Unknown error during disassembly!!\n";
-        return -3;
+        cout << "[-] No .sla files found in " << slaPath << "!!" << endl;
+        return -1;
     }
 
     return 0;
 }
 
-// converts an opcode in the of 0xaabb... or 0b0011... to a an array of raw bytes
-int convertOpcodeToBinary(string& opcode, vector<unsigned char>& opcodeBytes)
+// Loads every .sla once. With more than one .sla their constructors are also
+// parsed on numThreads threads and indexed by leading opcode bits, so each
+// opcode is only disassembled with the .sla files that can decode it
+int loadLanguages(VALIDATOR_DATA& validatorData, vector<string>& slaFilenames, unsigned int numThreads)
 {
-    int opcodeLength = 0;
+    int result = 0;
 
-    // opcode must begin with 0x or 0b
-    if(opcode[0] != '0')
+    validatorData.languages.resize(slaFilenames.size());
+
+    for(unsigned int i = 0; i < slaFilenames.size(); i++)
     {
-        cout << "Opcode must begin with 0x or 0b!!" << endl;
-        return -1;
+        validatorData.languages[i].slaFilename = slaFilenames[i];
+        validatorData.allLanguages.push_back(i);
     }
 
-    if(opcode[1] == 'x' || opcode[1] == 'X')
+    if(slaFilenames.size() > 1)
     {
-        opcodeLength = opcode.length() - 2;
-        if((opcodeLength % 2) != 0)
+        vector<Slautil> slas(slaFilenames.size());
+        vector<int> results(slaFilenames.size(), 0);
+        boost::asio::thread_pool threadPool(numThreads);
+
+        cout << "[*] Indexing " << slaFilenames.size() << " .sla files" << endl;
+
+        for(unsigned int i = 0; i < slaFilenames.size(); i++)
         {
-            cout << "Hex opcode length must be divisble by 2!!" << endl;
-            return -2;
+            boost::asio::post(threadPool,
+                              boost::bind(loadSlaIndexWorker,
+                                          boost::cref(slaFilenames[i]),
+                                          boost::ref(slas[i]),
+                                          boost::ref(results[i])));
         }
 
-         // loop through the hex string, converting each byte
-        for(unsigned int i = 2; i < opcode.length(); i += 2)
+        threadPool.join();
+
+        // ids are added in order, the index returns candidates in load order
+        for(unsigned int i = 0; i < slaFilenames.size(); i++)
         {
-            unsigned char value;
-            unsigned char high;
-            unsigned char low;
+            if(results[i] == SLA_SUCCESS)
+            {
+                results[i] = validatorData.slaIndex.addSla(slas[i], i);
+            }
 
-            // convert the hex string to a byte
-            high = convertHexNibbletoInteger(opcode[i]);
-            low = convertHexNibbletoInteger(opcode[i+1]);
+            if(results[i] != SLA_SUCCESS)
+            {
+                cout << "[-] Failed to index " << slaFilenames[i] << "!!" << endl;
+                return -1;
+            }
+        }
+    }
 
-            value = (high << 4) | low;
+    // the first translator of every language is created up front so an
+    // invalid .sla fails before any work is done
+    for(auto& language: validatorData.languages)
+    {
+        SleighDisassembler* disassembler = new SleighDisassembler();
 
-            opcodeBytes.push_back(value);
+        language.disassemblers.push_back(disassembler);
+
+        result = disassembler->initialize(language.slaFilename);
+        if(result != 0)
+        {
+            cout << "[-] Failed to load " << language.slaFilename << "!!" << endl;
+            return result;
         }
 
-        return 0;
+        language.freeDisassemblers.push_back(disassembler);
     }
-    else if(opcode[1] == 'b' || opcode[1] == 'B')
+
+    return 0;
+}
+
+// thread pool worker for loadLanguages()
+void loadSlaIndexWorker(const string& slaFilename, Slautil& sla, int& result)
+{
+    result = sla.loadSla(slaFilename);
+}
+
+// Returns the worker's translator for language. The first time the worker
+// needs the language it takes a free translator, or creates a new one if
+// every translator of the language is held by another worker. NULL if the
+// translator couldn't be created
+SleighDisassembler* getDisassembler(VALIDATOR_DATA& validatorData,
+                                    VALIDATOR_HELD_DISASSEMBLERS& held,
+                                    unsigned int language)
+{
+    PVALIDATOR_LANGUAGE curr = &validatorData.languages[language];
+    SleighDisassembler* disassembler = held[language];
+    int result = 0;
+
+    if(disassembler != NULL)
     {
-        opcodeLength = opcode.length() - 2;
-        if((opcodeLength % 8) != 0)
+        return disassembler;
+    }
+
+    validatorData.mutex.lock();
+    if(curr->freeDisassemblers.size() > 0)
+    {
+        disassembler = curr->freeDisassemblers.back();
+        curr->freeDisassemblers.pop_back();
+    }
+    validatorData.mutex.unlock();
+
+    if(disassembler == NULL)
+    {
+        disassembler = new SleighDisassembler();
+
+        validatorData.initializeMutex.lock();
+        result = disassembler->initialize(curr->slaFilename);
+        validatorData.initializeMutex.unlock();
+
+        if(result != 0)
         {
-            cout << "Binary opcode length must be divisble by 8!!" << endl;
-            return -2;
+            delete disassembler;
+            return NULL;
         }
 
-        // loop through the bit string, converting each byte
-        for(unsigned int i = 2; i < opcode.length(); i += 8)
-        {
-            unsigned char value = 0;
+        validatorData.mutex.lock();
+        curr->disassemblers.push_back(disassembler);
+        validatorData.mutex.unlock();
+    }
 
-            for(unsigned int j = 0; j < 8; j++)
-            {
-                value = value << 1;
-                if(opcode[i + j] == '1')
-                {
-                    value = value | 1;
-                }
-            }
-            opcodeBytes.push_back(value);
+    held[language] = disassembler;
+    return disassembler;
+}
+
+// gives the translators held by a worker back to their languages
+void releaseDisassemblers(VALIDATOR_DATA& validatorData, VALIDATOR_HELD_DISASSEMBLERS& held)
+{
+    validatorData.mutex.lock();
+    for(unsigned int language = 0; language < held.size(); language++)
+    {
+        if(held[language] != NULL)
+        {
+            validatorData.languages[language].freeDisassemblers.push_back(held[language]);
+            held[language] = NULL;
         }
+    }
+    validatorData.mutex.unlock();
+}
 
-        return 0;
+// Returns the languages with a constructor that can match the opcode, in
+// load order. The index only looks at the length and the leading bits
+const vector<unsigned int>& getCandidateLanguages(VALIDATOR_DATA& validatorData,
+                                                  const unsigned char* opcodeBytes,
+                                                  unsigned int length)
+{
+    string bitPattern;
+
+    if(validatorData.languages.size() == 1)
+    {
+        return validatorData.allLanguages;
     }
-    else
+
+    bitPattern.reserve(length * 8);
+    for(unsigned int i = 0; i < length; i++)
     {
-        cout << "Opcode must begin with 0x or 0b!!" << endl;
-        return -1;
+        for(int bit = 7; bit >= 0; bit--)
+        {
+            bitPattern.push_back(((opcodeBytes[i] >> bit) & 1) ? '1' : '0');
+        }
     }
 
-    return 0;
+    return validatorData.slaIndex.getCandidateSlas(bitPattern);
 }
 
-// simple utility to convert an ascii hex char to decimal
-int convertHexNibbletoInteger(unsigned char x)
+// runs worker on every chunk in validatorData.chunks on numThreads threads and
+// merges the chunks in order into lines, mismatchCount, mismatches and
+// strata. The output of each chunk is written to output if set. Only a
+// limited number of chunks are queued ahead of the one being merged
+int runChunkWorkers(VALIDATOR_DATA& validatorData,
+                    unsigned int numThreads,
+                    void (*worker)(VALIDATOR_DATA&, unsigned int),
+                    unsigned long long& lines,
+                    unsigned long long& mismatchCount,
+                    map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& mismatches,
+                    VALIDATOR_STRATA& strata,
+                    ostream* output)
 {
-    if(x >= '0' && x <= '9')
+    boost::asio::thread_pool threadPool(numThreads);
+    unsigned int chunksInFlight = numThreads * VALIDATOR_CHUNKS_PER_THREAD;
+    unsigned int nextChunk = 0;
+    int result = 0;
+
+    for(auto& chunk: validatorData.chunks)
     {
-        return x - '0';
+        chunk.lines = 0;
+        chunk.mismatchCount = 0;
+        chunk.maxOpcodeBytes = 0;
+        chunk.result = 0;
+        chunk.done = false;
     }
 
-    if(x >= 'A' && x <= 'F')
+    for(; nextChunk < validatorData.chunks.size() && nextChunk < chunksInFlight; nextChunk++)
     {
-        return x - 'A' + 0xa;
+        boost::asio::post(threadPool,
+                          boost::bind(worker,
+                                      boost::ref(validatorData),
+                                      nextChunk));
     }
 
-    if(x >= 'a' && x <= 'f')
+    for(unsigned int i = 0; i < validatorData.chunks.size(); i++)
     {
-        return x - 'a' + 0xa;
+        PVALIDATOR_CHUNK chunk = &validatorData.chunks[i];
+
+        {
+            boost::unique_lock<boost::mutex> lock(validatorData.mutex);
+
+            while(chunk->done == false)
+            {
+                validatorData.chunkDone.wait(lock);
+            }
+        }
+
+        if(chunk->result != 0)
+        {
+            result = chunk->result;
+            break;
+        }
+
+        lines += chunk->lines;
+        mismatchCount += chunk->mismatchCount;
+        mergeMismatches(mismatches, chunk->mismatches);
+
+        validatorData.inputOpcodes.insert(chunk->opcodes.begin(), chunk->opcodes.end());
+        vector<unsigned long long>().swap(chunk->opcodes);
+        validatorData.maxOpcodeBytes = max(validatorData.maxOpcodeBytes, chunk->maxOpcodeBytes);
+
+        for(auto& chunkStratum: chunk->strata)
+        {
+            // operator[] value initializes the counts to 0
+            PVALIDATOR_STRATUM stratum = &strata[chunkStratum.first];
+
+            stratum->lines += chunkStratum.second.lines;
+            stratum->sampled += chunkStratum.second.sampled;
+            stratum->mismatches += chunkStratum.second.mismatches;
+        }
+        chunk->strata.clear();
+
+        if(output != NULL)
+        {
+            *output << chunk->output;
+            string().swap(chunk->output);
+        }
+
+        if(nextChunk < validatorData.chunks.size())
+        {
+            boost::asio::post(threadPool,
+                              boost::bind(worker,
+                                          boost::ref(validatorData),
+                                          nextChunk));
+            nextChunk++;
+        }
+    }
+
+    // wait for the queued chunks even on failure, they use validatorData
+    threadPool.join();
+
+    return result;
+}
+
+// splitmix64 finalizer, same as synthetic.cpp. Derives the sampled opcodes
+// from the sample number and whether a line is sampled from its offset
+static unsigned long long splitMix64(unsigned long long x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// converts a random 64-bit value to [0, 1)
+static double toUnitInterval(unsigned long long x)
+{
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// thread pool worker, disassembles and compares every line of a chunk with a
+// translator no other worker is using. When sampling only the sampled lines
+// are disassembled
+void disassembleChunkWorker(VALIDATOR_DATA& validatorData, unsigned int chunkId)
+{
+    PVALIDATOR_CHUNK chunk = &validatorData.chunks[chunkId];
+    VALIDATOR_HELD_DISASSEMBLERS held(validatorData.languages.size(), NULL);
+    unsigned long long lineStart = chunk->start;
+    int result = 0;
+
+    //
+    // parse the chunk line by line
+    //
+    while(lineStart <= chunk->end)
+    {
+        unsigned long long lineEnd = lineStart;
+
+        while(lineEnd <= chunk->end && validatorData.input[lineEnd] != '\n')
+        {
+            lineEnd++;
+        }
+
+        string line(&validatorData.input[lineStart], lineEnd - lineStart);
+
+        if(validatorData.sample)
+        {
+            VALIDATOR_STRATUM_KEY key;
+            PVALIDATOR_STRATUM stratum = NULL;
+            unsigned long long mismatchCount = chunk->mismatchCount;
+
+            result = getLineStratum(validatorData, line, key);
+            if(result < 0)
+            {
+                break;
+            }
+
+            if(result > 0)
+            {
+                // empty line
+                result = 0;
+                lineStart = lineEnd + 1;
+                continue;
+            }
+
+            // strata only change between passes, no lock needed
+            if(toUnitInterval(splitMix64(VALIDATOR_SAMPLE_SEED ^ lineStart)) >= validatorData.strata.at(key).probability)
+            {
+                lineStart = lineEnd + 1;
+                continue;
+            }
+
+            result = disassembleLine(validatorData, held, line, *chunk, false);
+            if(result != 0)
+            {
+                break;
+            }
+
+            stratum = &chunk->strata[key];
+            stratum->sampled++;
+            if(chunk->mismatchCount != mismatchCount)
+            {
+                stratum->mismatches++;
+            }
+        }
+        else
+        {
+            result = disassembleLine(validatorData, held, line, *chunk, validatorData.scan);
+            if(result != 0)
+            {
+                break;
+            }
+        }
+
+        lineStart = lineEnd + 1;
+    }
+
+    releaseDisassemblers(validatorData, held);
+
+    validatorData.mutex.lock();
+    chunk->result = result;
+    chunk->done = true;
+    validatorData.mutex.unlock();
+
+    validatorData.chunkDone.notify_all();
+}
+
+// thread pool worker, counts the lines of every stratum in a chunk
+void countStrataWorker(VALIDATOR_DATA& validatorData, unsigned int chunkId)
+{
+    PVALIDATOR_CHUNK chunk = &validatorData.chunks[chunkId];
+    unsigned long long lineStart = chunk->start;
+    int result = 0;
+
+    while(lineStart <= chunk->end)
+    {
+        unsigned long long lineEnd = lineStart;
+        VALIDATOR_STRATUM_KEY key;
+
+        while(lineEnd <= chunk->end && validatorData.input[lineEnd] != '\n')
+        {
+            lineEnd++;
+        }
+
+        result = getLineStratum(validatorData,
+                                string(&validatorData.input[lineStart], lineEnd - lineStart),
+                                key);
+        if(result < 0)
+        {
+            break;
+        }
+
+        if(result == 0)
+        {
+            chunk->strata[key].lines++;
+        }
+
+        result = 0;
+        lineStart = lineEnd + 1;
+    }
+
+    validatorData.mutex.lock();
+    chunk->result = result;
+    chunk->done = true;
+    validatorData.mutex.unlock();
+
+    validatorData.chunkDone.notify_all();
+}
+
+// returns the stratum of an input line: its top opcode bits and the first
+// instruction component. Returns 1 for empty lines
+int getLineStratum(VALIDATOR_DATA& validatorData, const string& line, VALIDATOR_STRATUM_KEY& key)
+{
+    vector<string> lineSplit;
+    vector<unsigned char> opcodeBytes;
+    unsigned int topBits = 0;
+    int result = 0;
+
+    splitDisassemblyLine(lineSplit, line);
+
+    if(lineSplit.size() < 1)
+    {
+        return 1;
+    }
+
+    result = convertOpcodeToBinary(lineSplit[0], opcodeBytes);
+    if(result != 0)
+    {
+        cout << "Failed to covert opcode!!" << endl;
+        return result;
+    }
+
+    // opcodes shorter than sampleTopBits are padded with 0
+    for(unsigned int bit = 0; bit < validatorData.sampleTopBits; bit++)
+    {
+        unsigned int value = 0;
+
+        if(bit / 8 < opcodeBytes.size())
+        {
+            value = (opcodeBytes[bit / 8] >> (7 - (bit % 8))) & 1;
+        }
+
+        topBits = (topBits << 1) | value;
+    }
+
+    key.first = topBits;
+    key.second = lineSplit.size() > 1 ? lineSplit[1] : "";
+
+    return 0;
+}
+
+// decides the chance of sampling a line of each stratum. Strata get their
+// share of sampleSize, but at least VALIDATOR_SAMPLE_MIN_PER_STRATUM lines
+void allocateSample(VALIDATOR_DATA& validatorData)
+{
+    unsigned long long lines = 0;
+    double expected = 0;
+
+    for(auto& stratum: validatorData.strata)
+    {
+        lines += stratum.second.lines;
+    }
+
+    for(auto& stratum: validatorData.strata)
+    {
+        double share = (double)validatorData.sampleSize * stratum.second.lines / lines;
+
+        share = max(share, (double)VALIDATOR_SAMPLE_MIN_PER_STRATUM);
+        stratum.second.probability = min(1.0, share / stratum.second.lines);
+        stratum.second.sampled = 0;
+        stratum.second.mismatches = 0;
+
+        expected += stratum.second.probability * stratum.second.lines;
+    }
+
+    cout << "[*] " << lines << " lines in " << validatorData.strata.size() << " strata, sampling about ";
+    cout << (unsigned long long)expected << " of them" << endl;
+}
+
+// estimates the mismatch rates of all lines, of each top opcode bits and of
+// each mnemonic from the sampled strata. Groups with the most estimated
+// mismatches are first
+void estimateMismatchRates(VALIDATOR_DATA& validatorData)
+{
+    vector<PVALIDATOR_STRATUM> all;
+    map<unsigned int, vector<PVALIDATOR_STRATUM>> byTopBits;
+    map<string, vector<PVALIDATOR_STRATUM>> byMnemonic;
+    auto mostMismatches = [](const VALIDATOR_ESTIMATE& a, const VALIDATOR_ESTIMATE& b)
+                          {
+                              return a.rate * a.lines > b.rate * b.lines;
+                          };
+
+    for(auto& stratum: validatorData.strata)
+    {
+        all.push_back(&stratum.second);
+        byTopBits[stratum.first.first].push_back(&stratum.second);
+        byMnemonic[stratum.first.second].push_back(&stratum.second);
+    }
+
+    validatorData.estimate.name = "all";
+    estimateMismatchRate(all, validatorData.estimate);
+
+    validatorData.topBitsEstimates.clear();
+    for(auto& group: byTopBits)
+    {
+        VALIDATOR_ESTIMATE estimate;
+        ostringstream name;
+
+        name << "0x" << hex << group.first;
+        estimate.name = name.str();
+        estimateMismatchRate(group.second, estimate);
+        validatorData.topBitsEstimates.push_back(estimate);
+    }
+
+    validatorData.mnemonicEstimates.clear();
+    for(auto& group: byMnemonic)
+    {
+        VALIDATOR_ESTIMATE estimate;
+
+        estimate.name = group.first;
+        estimateMismatchRate(group.second, estimate);
+        validatorData.mnemonicEstimates.push_back(estimate);
+    }
+
+    std::stable_sort(validatorData.topBitsEstimates.begin(), validatorData.topBitsEstimates.end(), mostMismatches);
+    std::stable_sort(validatorData.mnemonicEstimates.begin(), validatorData.mnemonicEstimates.end(), mostMismatches);
+}
+
+// disassembles the opcode of a single input line and records it in the
+// chunk if SLEIGH's disassembly doesn't match the input. The opcode is
+// disassembled with the first of its candidate languages that decodes it.
+// collectOpcodes adds the opcode to the chunk for the opcode space scan
+int disassembleLine(VALIDATOR_DATA& validatorData,
+                    VALIDATOR_HELD_DISASSEMBLERS& held,
+                    const string& line,
+                    VALIDATOR_CHUNK& chunk,
+                    bool collectOpcodes)
+{
+    vector<string> lineSplit;
+    vector<string> disassemblySplit;
+    vector<unsigned char> opcodeBytes;
+    string opcode;
+    string disassembly;
+    string expected;
+    VALIDATOR_CONSTRUCTOR_KEY constructor(VALIDATOR_NO_LANGUAGE, VALIDATOR_NO_CONSTRUCTOR);
+    int result = 0;
+
+    // split the line into components the same way the generator does
+    splitDisassemblyLine(lineSplit, line);
+
+    if(lineSplit.size() < 1)
+    {
+        return 0;
+    }
+
+    opcode = lineSplit[0];
+    result = convertOpcodeToBinary(opcode, opcodeBytes);
+    if(result != 0)
+    {
+        cout << "Failed to covert opcode!!" << endl;
+        return result;
+    }
+
+    // same as SLEIGH's result when no language can decode the opcode
+    disassembly = "Error";
+
+    for(auto language: getCandidateLanguages(validatorData, opcodeBytes.data(), opcodeBytes.size()))
+    {
+        SleighDisassembler* disassembler = getDisassembler(validatorData, held, language);
+        int constructorLine = VALIDATOR_NO_CONSTRUCTOR;
+
+        if(disassembler == NULL)
+        {
+            cout << "[-] Failed to load " << validatorData.languages[language].slaFilename << "!!" << endl;
+            return -1;
+        }
+
+        result = disassembler->disassemble(opcodeBytes, disassembly, constructorLine);
+        if(result != 0)
+        {
+            return result;
+        }
+
+        if(constructorLine != VALIDATOR_NO_CONSTRUCTOR)
+        {
+            constructor = {(int)language, constructorLine};
+            break;
+        }
+    }
+
+    chunk.lines++;
+
+    if(collectOpcodes)
+    {
+        chunk.maxOpcodeBytes = max(chunk.maxOpcodeBytes, (unsigned int)opcodeBytes.size());
+
+        // wider opcodes can't be scanned, scanOpcodeSpace() fails on them
+        if(opcodeBytes.size() * 8 <= VALIDATOR_SCAN_MAX_BITS)
+        {
+            chunk.opcodes.push_back(makeOpcodeKey(opcodeBytes.data(), opcodeBytes.size()));
+        }
+    }
+
+    // spacing differences aren't errors, compare both like the generator
+    // prints them
+    splitDisassemblyLine(disassemblySplit, disassembly);
+    expected = normalizeDisassembly(lineSplit, 1);
+    disassembly = normalizeDisassembly(disassemblySplit, 0);
+
+    if(expected != disassembly)
+    {
+        // operator[] value initializes count to 0
+        PVALIDATOR_MISMATCHES mismatches = &chunk.mismatches[constructor];
+
+        mismatches->count++;
+        if(mismatches->samples.size() < VALIDATOR_MISMATCH_SAMPLES)
+        {
+            mismatches->samples.push_back({opcode, expected, disassembly});
+        }
+
+        chunk.mismatchCount++;
+    }
+
+    return 0;
+}
+
+// Disassembles every opcode of the opcode space, or scanSamples random ones
+// if it's wider than VALIDATOR_SCAN_MAX_EXHAUSTIVE_BITS, and reports those
+// the .sla decodes that aren't in the input. The opcode space is as wide as
+// the longest input opcode. Every unlisted opcode is written to scanFilename
+// in input file format
+int scanOpcodeSpace(VALIDATOR_DATA& validatorData, string& scanFilename, unsigned int numThreads)
+{
+    unsigned long long numOpcodes = 0;
+    int result = 0;
+
+    boost::filesystem::path scanfile{scanFilename};
+    boost::filesystem::ofstream ofs{scanfile};
+
+    if(!ofs)
+    {
+        cout << "[-] Failed to open scan file!!" << endl;
+        return -1;
+    }
+
+    validatorData.scanBits = validatorData.maxOpcodeBytes * 8;
+    if(validatorData.scanBits == 0)
+    {
+        cout << "[-] No opcodes to scan!!" << endl;
+        return -1;
+    }
+
+    if(validatorData.scanBits > VALIDATOR_SCAN_MAX_BITS)
+    {
+        cout << "[-] Opcode space scan supports opcodes up to " << VALIDATOR_SCAN_MAX_BITS << " bits!!" << endl;
+        return -1;
+    }
+
+    if(validatorData.scanBits <= VALIDATOR_SCAN_MAX_EXHAUSTIVE_BITS)
+    {
+        numOpcodes = 1ULL << validatorData.scanBits;
+    }
+    else
+    {
+        validatorData.scanSampled = true;
+        numOpcodes = validatorData.scanSamples;
+    }
+
+    cout << "[*] Scanning " << numOpcodes << (validatorData.scanSampled ? " sampled" : "");
+    cout << " opcodes of the " << validatorData.scanBits << "-bit opcode space" << endl;
+
+    //
+    // split the opcode space into batches
+    //
+    validatorData.chunks.clear();
+
+    for(unsigned long long first = 0; first < numOpcodes; first += VALIDATOR_SCAN_BATCH_SIZE)
+    {
+        VALIDATOR_CHUNK batch;
+
+        batch.start = first;
+        batch.end = min(first + VALIDATOR_SCAN_BATCH_SIZE, numOpcodes) - 1;
+
+        validatorData.chunks.push_back(batch);
+    }
+
+    result = runChunkWorkers(validatorData,
+                             numThreads,
+                             scanBatchWorker,
+                             validatorData.scanned,
+                             validatorData.unlistedCount,
+                             validatorData.unlisted,
+                             validatorData.strata,
+                             &ofs);
+
+    ofs.close();
+
+    if(result != 0)
+    {
+        return result;
+    }
+
+    cout << "[*] " << validatorData.unlistedCount << " decoded opcode(s) not in the input in ";
+    cout << validatorData.unlisted.size() << " constructor(s)" << endl;
+
+    return 0;
+}
+
+// thread pool worker, disassembles a batch of the opcode space and records
+// the decoded opcodes that aren't in the input
+void scanBatchWorker(VALIDATOR_DATA& validatorData, unsigned int batchId)
+{
+    PVALIDATOR_CHUNK batch = &validatorData.chunks[batchId];
+    VALIDATOR_HELD_DISASSEMBLERS held(validatorData.languages.size(), NULL);
+    unsigned int opcodeSize = validatorData.scanBits / 8;
+    unsigned long long mask = (1ULL << validatorData.scanBits) - 1;
+    unsigned long long count = batch->end - batch->start + 1;
+    vector<unsigned char> opcodes(count * opcodeSize);
+    vector<VALIDATOR_DECODED> decoded(count);
+    vector<const vector<unsigned int>*> candidates(count);
+    ostringstream output;
+    int result = 0;
+
+    //
+    // opcode bytes of the batch, most significant byte first like in the
+    // input file
+    //
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        unsigned long long value = batch->start + i;
+
+        if(validatorData.scanSampled)
+        {
+            value = splitMix64(VALIDATOR_SCAN_SEED ^ value) & mask;
+        }
+
+        for(unsigned int j = 0; j < opcodeSize; j++)
+        {
+            opcodes[i * opcodeSize + j] = (value >> (8 * (opcodeSize - j - 1))) & 0xff;
+        }
+    }
+
+    for(unsigned long long i = 0; i < count; i++)
+    {
+        decoded[i].constructorLine = VALIDATOR_NO_CONSTRUCTOR;
+        decoded[i].length = 0;
+        decoded[i].language = VALIDATOR_NO_LANGUAGE;
+        candidates[i] = &getCandidateLanguages(validatorData, &opcodes[i * opcodeSize], opcodeSize);
+    }
+
+    //
+    // Each opcode is disassembled with its candidate languages in order
+    // until one decodes it. Round n disassembles the opcodes still undecoded
+    // with their n-th candidate, batched by language
+    //
+    for(unsigned int round = 0; result == 0; round++)
+    {
+        map<unsigned int, vector<unsigned long long>> pending; // key = language, opcode indexes
+
+        for(unsigned long long i = 0; i < count; i++)
+        {
+            if(decoded[i].disassembly.length() == 0 && candidates[i]->size() > round)
+            {
+                pending[(*candidates[i])[round]].push_back(i);
+            }
+        }
+
+        if(pending.size() == 0)
+        {
+            break;
+        }
+
+        for(auto& languageOpcodes: pending)
+        {
+            SleighDisassembler* disassembler = getDisassembler(validatorData, held, languageOpcodes.first);
+            vector<unsigned char> languageBatch;
+            vector<VALIDATOR_DECODED> languageDecoded;
+
+            if(disassembler == NULL)
+            {
+                cout << "[-] Failed to load " << validatorData.languages[languageOpcodes.first].slaFilename << "!!" << endl;
+                result = -1;
+                break;
+            }
+
+            languageBatch.reserve(languageOpcodes.second.size() * opcodeSize);
+            for(auto i: languageOpcodes.second)
+            {
+                languageBatch.insert(languageBatch.end(), &opcodes[i * opcodeSize], &opcodes[i * opcodeSize] + opcodeSize);
+            }
+
+            result = disassembler->disassembleBatch(languageBatch, opcodeSize, languageDecoded);
+            if(result != 0)
+            {
+                break;
+            }
+
+            for(unsigned long long j = 0; j < languageOpcodes.second.size(); j++)
+            {
+                if(languageDecoded[j].disassembly.length() > 0)
+                {
+                    decoded[languageOpcodes.second[j]] = std::move(languageDecoded[j]);
+                    decoded[languageOpcodes.second[j]].language = (int)languageOpcodes.first;
+                }
+            }
+        }
+    }
+
+    for(unsigned long long i = 0; result == 0 && i < count; i++)
+    {
+        unsigned char* opcode = &opcodes[i * opcodeSize];
+        unsigned int length = opcodeSize;
+        bool duplicate = false;
+        PVALIDATOR_MISMATCHES unlisted = NULL;
+        ostringstream opcodeString;
+
+        batch->lines++;
+
+        if(decoded[i].disassembly.length() == 0)
+        {
+            continue;
+        }
+
+        // a shorter instruction only depends on its own bytes. When
+        // enumerating, it's only reported for the opcode where the bytes
+        // after it are 0
+        if(decoded[i].length > 0 && (unsigned int)decoded[i].length < opcodeSize)
+        {
+            length = decoded[i].length;
+
+            for(unsigned int j = length; j < opcodeSize; j++)
+            {
+                if(opcode[j] != 0)
+                {
+                    duplicate = true;
+                }
+            }
+        }
+
+        if(duplicate && !validatorData.scanSampled)
+        {
+            continue;
+        }
+
+        // input opcodes are only read here, no lock needed
+        if(validatorData.inputOpcodes.count(makeOpcodeKey(opcode, length)) != 0)
+        {
+            continue;
+        }
+
+        opcodeString << "0x";
+        for(unsigned int j = 0; j < length; j++)
+        {
+            opcodeString << CHAR2HEX(opcode[j]);
+        }
+
+        output << opcodeString.str() << " " << decoded[i].disassembly << endl;
+
+        // operator[] value initializes count to 0
+        unlisted = &batch->mismatches[{decoded[i].language, decoded[i].constructorLine}];
+
+        unlisted->count++;
+        if(unlisted->samples.size() < VALIDATOR_MISMATCH_SAMPLES)
+        {
+            unlisted->samples.push_back({opcodeString.str(), "", decoded[i].disassembly});
+        }
+
+        batch->mismatchCount++;
+    }
+
+    releaseDisassemblers(validatorData, held);
+
+    validatorData.mutex.lock();
+    batch->output = output.str();
+    batch->result = result;
+    batch->done = true;
+    validatorData.mutex.unlock();
+
+    validatorData.chunkDone.notify_all();
+}
+
+// key of an opcode in VALIDATOR_DATA::inputOpcodes. The length is part of
+// the key so 0x00 and 0x0000 differ
+unsigned long long makeOpcodeKey(const unsigned char* opcodeBytes, unsigned int length)
+{
+    unsigned long long value = 0;
+
+    for(unsigned int i = 0; i < length; i++)
+    {
+        value = (value << 8) | opcodeBytes[i];
+    }
+
+    return (value << 4) | length;
+}
+
+// converts tokenized disassembly, starting at lineSplit[start], back to text
+// with the same tokenization and getInstructionOutputString() as the generator
+string normalizeDisassembly(const vector<string>& lineSplit, unsigned int start)
+{
+    Instruction instruction;
+
+    for(unsigned int i = start; i < lineSplit.size(); i++)
+    {
+        InstructionComponentType currType;
+
+        if(isRegister(lineSplit[i]))
+        {
+            currType = TYPE_REGISTER;
+        }
+        else if(isImmediate(lineSplit[i]))
+        {
+            currType = TYPE_IMMEDIATE;
+        }
+        else
+        {
+            currType = TYPE_INSTRUCTION;
+        }
+
+        instruction.addComponent(currType, lineSplit[i]);
+    }
+
+    return instruction.getInstructionOutputString(false, false);
+}
+
+// adds the mismatches of a later chunk to dest, keeping dest's samples first
+void mergeMismatches(map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& dest,
+                     map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& src)
+{
+    for(auto& srcMismatches: src)
+    {
+        PVALIDATOR_MISMATCHES destMismatches = &dest[srcMismatches.first];
+
+        destMismatches->count += srcMismatches.second.count;
+
+        for(auto& sample: srcMismatches.second.samples)
+        {
+            if(destMismatches->samples.size() >= VALIDATOR_MISMATCH_SAMPLES)
+            {
+                break;
+            }
+
+            destMismatches->samples.push_back(std::move(sample));
+        }
+    }
+
+    src.clear();
+}
+
+// returns the constructors with mismatches, most mismatches first
+static vector<pair<VALIDATOR_CONSTRUCTOR_KEY, PVALIDATOR_MISMATCHES>> sortMismatches(map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& mismatchMap)
+{
+    vector<pair<VALIDATOR_CONSTRUCTOR_KEY, PVALIDATOR_MISMATCHES>> sorted;
+
+    for(auto& mismatches: mismatchMap)
+    {
+        sorted.push_back({mismatches.first, &mismatches.second});
+    }
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const pair<VALIDATOR_CONSTRUCTOR_KEY, PVALIDATOR_MISMATCHES>& a, const pair<VALIDATOR_CONSTRUCTOR_KEY, PVALIDATOR_MISMATCHES>& b)
+                     {
+                         return a.second->count > b.second->count;
+                     });
+
+    return sorted;
+}
+
+// file name of the .sla of a language, without the directory
+static string getLanguageName(VALIDATOR_DATA& validatorData, int language)
+{
+    boost::filesystem::path p{validatorData.languages[language].slaFilename};
+
+    return p.filename().string();
+}
+
+// writes the mismatch groups of the text report. Unlisted opcodes have no
+// expected disassembly. The .sla is only named if there is more than one
+static void writeMismatchGroups(ostream& ofs,
+                                VALIDATOR_DATA& validatorData,
+                                map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& mismatchMap,
+                                bool unlisted)
+{
+    for(auto& mismatches: sortMismatches(mismatchMap))
+    {
+        ofs << endl;
+
+        if(mismatches.first.second == VALIDATOR_NO_CONSTRUCTOR)
+        {
+            ofs << "No matching constructor";
+        }
+        else
+        {
+            ofs << ".slaspec line " << mismatches.first.second;
+            if(validatorData.languages.size() > 1)
+            {
+                ofs << " (" << getLanguageName(validatorData, mismatches.first.first) << ")";
+            }
+        }
+        ofs << ": " << mismatches.second->count << (unlisted ? " unlisted opcode(s)" : " mismatch(es)") << endl;
+
+        for(auto& sample: mismatches.second->samples)
+        {
+            if(unlisted)
+            {
+                ofs << "  " << sample.opcode << " " << sample.disassembly << endl;
+                continue;
+            }
+
+            ofs << "  " << sample.opcode << endl;
+            ofs << "    expected: " << sample.expected << endl;
+            ofs << "    got:      " << sample.disassembly << endl;
+        }
+    }
+}
+
+// writes a line of the sample estimates of the text report
+static void writeEstimate(ostream& ofs, VALIDATOR_ESTIMATE& estimate)
+{
+    ofs << estimate.lines << " lines, " << estimate.sampled << " sampled, " << estimate.mismatches << " mismatch(es), ";
+    ofs << fixed << setprecision(4) << "estimated rate " << estimate.rate * 100 << "% ";
+    ofs << "(95% CI " << estimate.low * 100 << "% - " << estimate.high * 100 << "%)" << endl;
+    ofs.unsetf(ios::fixed);
+}
+
+// writes the mismatches grouped by constructor as text
+int writeMismatchReport(VALIDATOR_DATA& validatorData, string& outputFilename)
+{
+    boost::filesystem::path outfile{outputFilename};
+    boost::filesystem::ofstream ofs{outfile};
+
+    if(!ofs)
+    {
+        cout << "[-] Failed to open output file!!" << endl;
+        return -1;
+    }
+
+    ofs << "Instructions: " << validatorData.lines << endl;
+    ofs << "Mismatches: " << validatorData.mismatchCount << endl;
+    ofs << "Constructors with mismatches: " << validatorData.mismatches.size() << endl;
+
+    if(validatorData.sample)
+    {
+        ofs << endl;
+        ofs << "Sample of " << validatorData.strata.size() << " strata: ";
+        writeEstimate(ofs, validatorData.estimate);
+
+        ofs << endl << "By top " << validatorData.sampleTopBits << " opcode bits:" << endl;
+        for(auto& estimate: validatorData.topBitsEstimates)
+        {
+            ofs << "  " << estimate.name << ": ";
+            writeEstimate(ofs, estimate);
+        }
+
+        ofs << endl << "By mnemonic:" << endl;
+        for(auto& estimate: validatorData.mnemonicEstimates)
+        {
+            ofs << "  " << estimate.name << ": ";
+            writeEstimate(ofs, estimate);
+        }
+    }
+
+    writeMismatchGroups(ofs, validatorData, validatorData.mismatches, false);
+
+    if(validatorData.scan)
+    {
+        ofs << endl;
+        ofs << "Scanned opcodes: " << validatorData.scanned << " of the " << validatorData.scanBits << "-bit opcode space";
+        ofs << (validatorData.scanSampled ? " (sampled)" : "") << endl;
+        ofs << "Decoded opcodes not in the input: " << validatorData.unlistedCount << endl;
+        ofs << "Constructors with unlisted opcodes: " << validatorData.unlisted.size() << endl;
+
+        writeMismatchGroups(ofs, validatorData, validatorData.unlisted, true);
+    }
+
+    ofs.close();
+    return 0;
+}
+
+// escapes a string for a JSON string literal
+static string escapeJson(const string& str)
+{
+    ostringstream escaped;
+
+    for(auto c: str)
+    {
+        if(c == '"' || c == '\\')
+        {
+            escaped << '\\' << c;
+        }
+        else if((unsigned char)c < 0x20)
+        {
+            escaped << "\\u" << setw(4) << setfill('0') << hex << (unsigned int)c;
+        }
+        else
+        {
+            escaped << c;
+        }
+    }
+
+    return escaped.str();
+}
+
+// writes the mismatch groups of the JSON report as an array. The .sla and
+// line of undecodable opcodes are null
+static void writeMismatchGroupsJson(ostream& ofs,
+                                    VALIDATOR_DATA& validatorData,
+                                    map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& mismatchMap,
+                                    bool unlisted,
+                                    const string& indent)
+{
+    bool firstConstructor = true;
+
+    ofs << "[";
+
+    for(auto& mismatches: sortMismatches(mismatchMap))
+    {
+        bool firstSample = true;
+
+        ofs << (firstConstructor ? "" : ",") << endl;
+        firstConstructor = false;
+
+        ofs << indent << "  {\"sla\": ";
+        if(mismatches.first.second == VALIDATOR_NO_CONSTRUCTOR)
+        {
+            ofs << "null, \"line\": null";
+        }
+        else
+        {
+            ofs << "\"" << escapeJson(getLanguageName(validatorData, mismatches.first.first)) << "\", ";
+            ofs << "\"line\": " << mismatches.first.second;
+        }
+        ofs << ", \"count\": " << mismatches.second->count << ", \"samples\": [";
+
+        for(auto& sample: mismatches.second->samples)
+        {
+            ofs << (firstSample ? "" : ", ");
+            firstSample = false;
+
+            ofs << "{\"opcode\": \"" << escapeJson(sample.opcode) << "\", ";
+            if(!unlisted)
+            {
+                ofs << "\"expected\": \"" << escapeJson(sample.expected) << "\", ";
+            }
+            ofs << "\"disassembly\": \"" << escapeJson(sample.disassembly) << "\"}";
+        }
+
+        ofs << "]}";
+    }
+
+    ofs << endl << indent << "]";
+}
+
+// writes a sample estimate of the JSON report as an object
+static void writeEstimateJson(ostream& ofs, VALIDATOR_ESTIMATE& estimate)
+{
+    ofs << "{\"name\": \"" << escapeJson(estimate.name) << "\", ";
+    ofs << "\"lines\": " << estimate.lines << ", ";
+    ofs << "\"sampled\": " << estimate.sampled << ", ";
+    ofs << "\"mismatches\": " << estimate.mismatches << ", ";
+    ofs << "\"rate\": " << estimate.rate << ", ";
+    ofs << "\"low\": " << estimate.low << ", ";
+    ofs << "\"high\": " << estimate.high << "}";
+}
+
+// writes the mismatches grouped by constructor as JSON
+int writeMismatchJson(VALIDATOR_DATA& validatorData, string& jsonFilename)
+{
+    boost::filesystem::path outfile{jsonFilename};
+    boost::filesystem::ofstream ofs{outfile};
+
+    if(!ofs)
+    {
+        cout << "[-] Failed to open JSON file!!" << endl;
+        return -1;
+    }
+
+    ofs << "{" << endl;
+    ofs << "  \"instructions\": " << validatorData.lines << "," << endl;
+    ofs << "  \"mismatches\": " << validatorData.mismatchCount << "," << endl;
+    ofs << "  \"constructors\": ";
+    writeMismatchGroupsJson(ofs, validatorData, validatorData.mismatches, false, "  ");
+
+    if(validatorData.sample)
+    {
+        ofs << "," << endl;
+        ofs << "  \"sample\": {" << endl;
+        ofs << "    \"strata\": " << validatorData.strata.size() << "," << endl;
+        ofs << "    \"top_bits\": " << validatorData.sampleTopBits << "," << endl;
+        ofs << "    \"estimate\": ";
+        writeEstimateJson(ofs, validatorData.estimate);
+        ofs << "," << endl;
+
+        ofs << "    \"by_top_bits\": [";
+        for(unsigned int i = 0; i < validatorData.topBitsEstimates.size(); i++)
+        {
+            ofs << (i == 0 ? "" : ",") << endl << "      ";
+            writeEstimateJson(ofs, validatorData.topBitsEstimates[i]);
+        }
+        ofs << endl << "    ]," << endl;
+
+        ofs << "    \"by_mnemonic\": [";
+        for(unsigned int i = 0; i < validatorData.mnemonicEstimates.size(); i++)
+        {
+            ofs << (i == 0 ? "" : ",") << endl << "      ";
+            writeEstimateJson(ofs, validatorData.mnemonicEstimates[i]);
+        }
+        ofs << endl << "    ]" << endl;
+        ofs << "  }";
+    }
+
+    if(validatorData.scan)
+    {
+        ofs << "," << endl;
+        ofs << "  \"scan\": {" << endl;
+        ofs << "    \"bits\": " << validatorData.scanBits << "," << endl;
+        ofs << "    \"sampled\": " << (validatorData.scanSampled ? "true" : "false") << "," << endl;
+        ofs << "    \"scanned\": " << validatorData.scanned << "," << endl;
+        ofs << "    \"unlisted\": " << validatorData.unlistedCount << "," << endl;
+        ofs << "    \"constructors\": ";
+        writeMismatchGroupsJson(ofs, validatorData, validatorData.unlisted, true, "    ");
+        ofs << endl << "  }";
+    }
+
+    ofs << endl << "}" << endl;
+
+    ofs.close();
+    return 0;
+}
+
+// Reads the .sla and initializes the translator. Only called once per
+// translator, it is reused for every opcode
+int SleighDisassembler::initialize(const string& slaFilename)
+{
+    try
+    {
+        // Read sleigh file into DOM
+        Element *sleighroot = docstorage.openDocument(slaFilename)->getRoot();
+        docstorage.registerTag(sleighroot);
+        trans.initialize(docstorage); // Initialize the translator
+    }
+    catch(XmlError e)
+    {
+        cout << "Failed to instantiate SLEIGH. Is processor SLA invalid?" << endl;
+        return -1;
+    }
+    catch(...)
+    {
+        cout << "Unknown error while instantiating SLEIGH!!\n";
+        return -3;
+    }
+
+    return 0;
+}
+
+// disassembles opcode bytes with the initialized translator. constructorLine
+// is the .slaspec line of the instruction's root constructor
+int SleighDisassembler::disassemble(const vector<unsigned char>& opcodeBytes, string& disassembly, int& constructorLine)
+{
+    try
+    {
+        AssemblyRaw assememit;	// Set up the disassembly dumper
+
+        // point the load image at the opcode, everything past it reads as 0
+        loader.setWindow(0, (uint1*)opcodeBytes.data(), opcodeBytes.size());
+
+        // The translator caches decoded instructions by address and every
+        // opcode is at address 0. reset() drops the caches of the previous
+        // opcode but keeps the parsed .sla, so initialize() doesn't read the
+        // .sla again
+        trans.reset(&loader, &context);
+        trans.initialize(docstorage);
+
+        Address addr(trans.getDefaultCodeSpace(), 0); // First disassembly address
+
+        // dump the disassembly now
+        trans.printAssembly(assememit, addr);
+        disassembly = assememit.disassembly;
+        constructorLine = trans.getConstructorLine(addr);
+    }
+    catch(BadDataError e)
+    {
+        // disassembly error, just report it as a success so it appears in the report
+        disassembly = "Error";
+        constructorLine = VALIDATOR_NO_CONSTRUCTOR;
+        return 0;
+    }
+    catch(...)
+    {
+        cout << "Unknown error during disassembly!!\n";
+        return -3;
+    }
+
+    return 0;
+}
+
+// disassembles opcodes, a list of opcodeSize byte opcodes, into decoded
+// Instead of resetting the translator for every opcode like disassemble(), a
+// window of opcodes is loaded at once with each opcode at its own address.
+// Opcodes are 2 * opcodeSize bytes apart and the gap is 0, so each one reads
+// the same bytes as when disassembled alone
+int SleighDisassembler::disassembleBatch(const vector<unsigned char>& opcodes,
+                                         unsigned int opcodeSize,
+                                         vector<VALIDATOR_DECODED>& decoded)
+{
+    unsigned int stride = opcodeSize * 2;
+    unsigned int opcodesPerWindow = VALIDATOR_SCAN_WINDOW_SIZE / stride;
+    unsigned long long count = opcodes.size() / opcodeSize;
+    vector<unsigned char> window(opcodesPerWindow * stride);
+
+    decoded.resize(count);
+
+    for(unsigned long long first = 0; first < count; first += opcodesPerWindow)
+    {
+        unsigned long long windowCount = min((unsigned long long)opcodesPerWindow, count - first);
+
+        std::fill(window.begin(), window.end(), 0);
+        for(unsigned long long i = 0; i < windowCount; i++)
+        {
+            std::copy(&opcodes[(first + i) * opcodeSize],
+                      &opcodes[(first + i) * opcodeSize] + opcodeSize,
+                      &window[i * stride]);
+        }
+
+        try
+        {
+            loader.setWindow(0, window.data(), windowCount * stride);
+
+            // drop the instructions cached for the previous window
+            trans.reset(&loader, &context);
+            trans.initialize(docstorage);
+        }
+        catch(...)
+        {
+            cout << "Unknown error during disassembly!!\n";
+            return -3;
+        }
+
+        for(unsigned long long i = 0; i < windowCount; i++)
+        {
+            PVALIDATOR_DECODED curr = &decoded[first + i];
+
+            try
+            {
+                AssemblyRaw assememit;
+                Address addr(trans.getDefaultCodeSpace(), i * stride);
+
+                curr->length = trans.printAssembly(assememit, addr);
+                curr->disassembly = assememit.disassembly;
+                curr->constructorLine = trans.getConstructorLine(addr);
+            }
+            catch(BadDataError e)
+            {
+                // not a valid opcode
+                curr->disassembly.clear();
+                curr->constructorLine = VALIDATOR_NO_CONSTRUCTOR;
+                curr->length = 0;
+            }
+            catch(...)
+            {
+                cout << "Unknown error during disassembly!!\n";
+                return -3;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// returns the .slaspec line of the constructor that matched the instruction
+// at addr. printAssembly() already parsed it so this comes from the
+// translator's cache
+int4 ValidatorSleigh::getConstructorLine(const Address &addr) const
+
+{
+  ParserContext *pos = obtainContext(addr, ParserContext::disassembly);
+  ParserWalker walker(pos);
+  walker.baseState();
+  return walker.getConstructor()->getLineno();
+}
+
+// converts an opcode in the of 0xaabb... or 0b0011... to a an array of raw bytes
+int convertOpcodeToBinary(string& opcode, vector<unsigned char>& opcodeBytes)
+{
+    int opcodeLength = 0;
+
+    // opcode must begin with 0x or 0b
+    if(opcode[0] != '0')
+    {
+        cout << "Opcode must begin with 0x or 0b!!" << endl;
+        return -1;
+    }
+
+    if(opcode[1] == 'x' || opcode[1] == 'X')
+    {
+        opcodeLength = opcode.length() - 2;
+        if((opcodeLength % 2) != 0)
+        {
+            cout << "Hex opcode length must be divisble by 2!!" << endl;
+            return -2;
+        }
+
+         // loop through the hex string, converting each byte
+        for(unsigned int i = 2; i < opcode.length(); i += 2)
+        {
+            unsigned char value;
+            unsigned char high;
+            unsigned char low;
+
+            // convert the hex string to a byte
+            high = convertHexNibbletoInteger(opcode[i]);
+            low = convertHexNibbletoInteger(opcode[i+1]);
+
+            value = (high << 4) | low;
+
+            opcodeBytes.push_back(value);
+        }
+
+        return 0;
+    }
+    else if(opcode[1] == 'b' || opcode[1] == 'B')
+    {
+        opcodeLength = opcode.length() - 2;
+        if((opcodeLength % 8) != 0)
+        {
+            cout << "Binary opcode length must be divisble by 8!!" << endl;
+            return -2;
+        }
+
+        // loop through the bit string, converting each byte
+        for(unsigned int i = 2; i < opcode.length(); i += 8)
+        {
+            unsigned char value = 0;
+
+            for(unsigned int j = 0; j < 8; j++)
+            {
+                value = value << 1;
+                if(opcode[i + j] == '1')
+                {
+                    value = value | 1;
+                }
+            }
+            opcodeBytes.push_back(value);
+        }
+
+        return 0;
+    }
+    else
+    {
+        cout << "Opcode must begin with 0x or 0b!!" << endl;
+        return -1;
     }
 
     return 0;
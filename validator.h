@@ -0,0 +1,303 @@
+//-----------------------------------------------------------------------------
+// File: validator.h
+//
+// Disassembling the input opcodes with the compiled processor module
+//
+// Copyright (c) Oberoi Security Solutions. All rights reserved.
+// Licensed under the Apache 2.0 License.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <loadimage.hh>
+#include <sleigh.hh>
+#include "estimate.h"
+#include "slautil/slaindex.h"
+using namespace std;
+
+// This is a tiny LoadImage class which feeds the executable bytes to the translator
+// Taken straight from sleighexample.cc
+class MyLoadImage : public LoadImage {
+  uintb baseaddr;
+  int4 length;
+  uint1 *data;
+public:
+  MyLoadImage(uintb ad,uint1 *ptr,int4 sz) : LoadImage("nofile") { baseaddr = ad; data = ptr; length = sz; }
+  void setWindow(uintb ad,uint1 *ptr,int4 sz) { baseaddr = ad; data = ptr; length = sz; }
+  virtual void loadFill(uint1 *ptr,int4 size,const Address &addr);
+  virtual string getArchType(void) const { return "myload"; }
+  virtual void adjustVma(long adjust) { }
+};
+
+// Here is a simple class for emitting assembly.  In this case, we send the strings straight
+// to standard out.
+class AssemblyRaw : public AssemblyEmit {
+public:
+  virtual void dump(const Address &addr,const string &mnem,const string &body);
+  string disassembly;
+};
+
+// Sleigh with access to the constructor that matched the last disassembled
+// instruction
+class ValidatorSleigh : public Sleigh {
+public:
+  ValidatorSleigh(LoadImage *ld,ContextDatabase *c_db) : Sleigh(ld,c_db) {}
+  int4 getConstructorLine(const Address &addr) const;
+};
+
+// constructor line reported when SLEIGH couldn't decode the opcode
+#define VALIDATOR_NO_CONSTRUCTOR (-1)
+
+// language reported when none of the .sla files could decode the opcode
+#define VALIDATOR_NO_LANGUAGE (-1)
+
+// a .slaspec constructor: the language (index into VALIDATOR_DATA::languages)
+// and the line of the constructor in its .slaspec. Undecodable opcodes are
+// {VALIDATOR_NO_LANGUAGE, VALIDATOR_NO_CONSTRUCTOR}
+typedef pair<int, int> VALIDATOR_CONSTRUCTOR_KEY;
+
+// one opcode of a batch disassembled by SleighDisassembler::disassembleBatch()
+typedef struct _VALIDATOR_DECODED
+{
+    string disassembly; // empty if SLEIGH couldn't decode the opcode
+    int constructorLine;
+    int length; // instruction length in bytes
+    int language; // set by the scan, the language that decoded it
+} VALIDATOR_DECODED, *PVALIDATOR_DECODED;
+
+// SLEIGH translator for a single .sla. The .sla is only parsed once by
+// initialize(), every opcode is then disassembled at address 0 of the load
+// image window
+class SleighDisassembler {
+  MyLoadImage loader;
+  ContextInternal context;
+  ValidatorSleigh trans;
+  DocumentStorage docstorage;
+public:
+  SleighDisassembler(void) : loader(0, NULL, 0), trans(&loader, &context) {}
+  int initialize(const string& slaFilename);
+  int disassemble(const vector<unsigned char>& opcodeBytes, string& disassembly, int& constructorLine);
+  int disassembleBatch(const vector<unsigned char>& opcodes,
+                       unsigned int opcodeSize,
+                       vector<VALIDATOR_DECODED>& decoded);
+};
+
+// A compiled .sla of the processor module. Sharded modules have one per
+// input file, listed in the .ldefs. A language gets its first translator
+// when it's loaded, further ones are only created when several workers need
+// it at the same time
+typedef struct _VALIDATOR_LANGUAGE
+{
+    string slaFilename;
+    vector<SleighDisassembler*> disassemblers; // every translator created
+    vector<SleighDisassembler*> freeDisassemblers; // those not used by a worker right now
+} VALIDATOR_LANGUAGE, *PVALIDATOR_LANGUAGE;
+
+// translators a worker holds, by language. NULL until the worker needs the
+// language
+typedef vector<SleighDisassembler*> VALIDATOR_HELD_DISASSEMBLERS;
+
+// The input is split into chunks of about this many bytes, cut at the end of
+// a line. Chunks are disassembled in parallel and written in input order
+#define VALIDATOR_CHUNK_SIZE (1024 * 1024)
+
+// number of chunks per thread that may be disassembled ahead of the chunk
+// being written. Bounds the memory held by finished but unwritten chunks
+#define VALIDATOR_CHUNKS_PER_THREAD 4
+
+// widest opcode space the scan enumerates completely. Wider opcodes are
+// sampled
+#define VALIDATOR_SCAN_MAX_EXHAUSTIVE_BITS 24
+
+// the scan only supports opcodes up to 4 bytes
+#define VALIDATOR_SCAN_MAX_BITS 32
+
+// number of opcodes scanned by one worker at a time
+#define VALIDATOR_SCAN_BATCH_SIZE (64 * 1024)
+
+// size of the load image window a batch is disassembled in. Every opcode of
+// the batch gets its own address in the window so the translator is only
+// reset once per window instead of once per opcode. Small enough to fit in
+// the code space of 8-bit processors
+#define VALIDATOR_SCAN_WINDOW_SIZE 1024
+
+// default number of opcodes sampled when the opcode space is too large to
+// enumerate
+#define VALIDATOR_SCAN_DEFAULT_SAMPLES (1 << VALIDATOR_SCAN_MAX_EXHAUSTIVE_BITS)
+
+// sampled opcodes are derived from this and the sample number, so the scan
+// is the same for any number of threads
+#define VALIDATOR_SCAN_SEED 0x5eed
+
+// --sample splits the input into strata by this many top opcode bits and
+// the mnemonic, unless --sample-top-bits says otherwise
+#define VALIDATOR_SAMPLE_DEFAULT_TOP_BITS 8
+#define VALIDATOR_SAMPLE_MAX_TOP_BITS 32
+
+// every stratum is expected to get at least this many sampled lines, even if
+// that's more than its share of the sample
+#define VALIDATOR_SAMPLE_MIN_PER_STRATUM 4
+
+// whether a line is sampled is decided from this and the line's offset in
+// the input, so the sample is the same for any number of threads
+#define VALIDATOR_SAMPLE_SEED 0x5a3b1e
+
+// number of mismatching lines kept as samples for each constructor
+#define VALIDATOR_MISMATCH_SAMPLES 3
+
+// an input line SLEIGH disassembled differently. Both disassemblies are
+// normalized with getInstructionOutputString()
+typedef struct _VALIDATOR_SAMPLE
+{
+    string opcode;
+    string expected; // from the input file
+    string disassembly; // from SLEIGH
+} VALIDATOR_SAMPLE, *PVALIDATOR_SAMPLE;
+
+// all mismatches of a single .slaspec constructor
+typedef struct _VALIDATOR_MISMATCHES
+{
+    unsigned long long count;
+    vector<VALIDATOR_SAMPLE> samples; // the first mismatches in input order
+} VALIDATOR_MISMATCHES, *PVALIDATOR_MISMATCHES;
+
+// a range of lines of the input and their mismatches. When scanning the
+// opcode space it's a batch of opcodes instead
+typedef struct _VALIDATOR_CHUNK
+{
+    // offsets of the first and last character in the input. For a scan
+    // batch the first and last opcode or sample number
+    unsigned long long start;
+    unsigned long long end;
+    unsigned long long lines; // number of instructions compared or scanned
+    unsigned long long mismatchCount;
+    unsigned int maxOpcodeBytes;
+
+    // keyed by constructor, merged after all earlier chunks so samples stay
+    // in input order
+    map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES> mismatches;
+
+    // scan only: opcodes found in the input and the lines written to the
+    // scan file for the unlisted ones
+    vector<unsigned long long> opcodes;
+    string output;
+
+    // sample only: lines, sampled lines and mismatches per stratum
+    VALIDATOR_STRATA strata;
+    int result;
+    bool done;
+} VALIDATOR_CHUNK, *PVALIDATOR_CHUNK;
+
+// state shared by the validator workers
+typedef struct _VALIDATOR_DATA
+{
+    // whole input file
+    vector<char> input;
+
+    vector<VALIDATOR_CHUNK> chunks;
+
+    vector<VALIDATOR_LANGUAGE> languages;
+
+    // routes an opcode to the languages with a constructor that can match
+    // it. Only built for more than one language
+    SlaIndex slaIndex;
+    vector<unsigned int> allLanguages;
+
+    // synchronize access to chunks and the free translators
+    boost::mutex mutex;
+
+    // SLEIGH's XML parser isn't thread safe, translators are initialized one
+    // after another
+    boost::mutex initializeMutex;
+
+    // signaled whenever a chunk is done
+    boost::condition_variable chunkDone;
+
+    // totals of the chunks merged so far
+    unsigned long long lines;
+    unsigned long long mismatchCount;
+    map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES> mismatches;
+
+    //
+    // scan for opcodes the .sla decodes that aren't in the input
+    //
+    bool scan;
+    bool scanSampled; // too many opcodes to enumerate, only samples were scanned
+    unsigned int scanBits;
+    unsigned long long scanSamples;
+
+    // input opcodes up to VALIDATOR_SCAN_MAX_BITS, see makeOpcodeKey()
+    boost::unordered_set<unsigned long long> inputOpcodes;
+    unsigned int maxOpcodeBytes;
+
+    unsigned long long scanned;
+    unsigned long long unlistedCount;
+    map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES> unlisted;
+
+    //
+    // stratified sample of the input lines instead of all of them
+    //
+    bool sample;
+    unsigned long long sampleSize;
+    unsigned int sampleTopBits;
+    VALIDATOR_STRATA strata; // all lines of the input
+    VALIDATOR_STRATA sampledStrata; // only the sampled lines, merged into strata
+
+    // estimates for all lines and for each top opcode bits and mnemonic
+    VALIDATOR_ESTIMATE estimate;
+    vector<VALIDATOR_ESTIMATE> topBitsEstimates;
+    vector<VALIDATOR_ESTIMATE> mnemonicEstimates;
+} VALIDATOR_DATA, *PVALIDATOR_DATA;
+
+int parseInputAndDisassemble(string& inputFilename,
+                             string& outputFilename,
+                             string& jsonFilename,
+                             string& scanFilename,
+                             string& slaPath,
+                             unsigned int numThreads,
+                             unsigned long long scanSamples,
+                             unsigned long long sampleSize,
+                             unsigned int sampleTopBits);
+int getSlaFilenames(const string& slaPath, vector<string>& slaFilenames);
+int loadLanguages(VALIDATOR_DATA& validatorData, vector<string>& slaFilenames, unsigned int numThreads);
+void loadSlaIndexWorker(const string& slaFilename, Slautil& sla, int& result);
+SleighDisassembler* getDisassembler(VALIDATOR_DATA& validatorData,
+                                    VALIDATOR_HELD_DISASSEMBLERS& held,
+                                    unsigned int language);
+void releaseDisassemblers(VALIDATOR_DATA& validatorData, VALIDATOR_HELD_DISASSEMBLERS& held);
+const vector<unsigned int>& getCandidateLanguages(VALIDATOR_DATA& validatorData,
+                                                  const unsigned char* opcodeBytes,
+                                                  unsigned int length);
+int runChunkWorkers(VALIDATOR_DATA& validatorData,
+                    unsigned int numThreads,
+                    void (*worker)(VALIDATOR_DATA&, unsigned int),
+                    unsigned long long& lines,
+                    unsigned long long& mismatchCount,
+                    map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& mismatches,
+                    VALIDATOR_STRATA& strata,
+                    ostream* output);
+void disassembleChunkWorker(VALIDATOR_DATA& validatorData, unsigned int chunkId);
+void countStrataWorker(VALIDATOR_DATA& validatorData, unsigned int chunkId);
+int getLineStratum(VALIDATOR_DATA& validatorData, const string& line, VALIDATOR_STRATUM_KEY& key);
+void allocateSample(VALIDATOR_DATA& validatorData);
+void estimateMismatchRates(VALIDATOR_DATA& validatorData);
+int scanOpcodeSpace(VALIDATOR_DATA& validatorData, string& scanFilename, unsigned int numThreads);
+void scanBatchWorker(VALIDATOR_DATA& validatorData, unsigned int batchId);
+unsigned long long makeOpcodeKey(const unsigned char* opcodeBytes, unsigned int length);
+int disassembleLine(VALIDATOR_DATA& validatorData,
+                    VALIDATOR_HELD_DISASSEMBLERS& held,
+                    const string& line,
+                    VALIDATOR_CHUNK& chunk,
+                    bool collectOpcodes);
+string normalizeDisassembly(const vector<string>& lineSplit, unsigned int start);
+void mergeMismatches(map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& dest,
+                     map<VALIDATOR_CONSTRUCTOR_KEY, VALIDATOR_MISMATCHES>& src);
+int writeMismatchReport(VALIDATOR_DATA& validatorData, string& outputFilename);
+int writeMismatchJson(VALIDATOR_DATA& validatorData, string& jsonFilename);
+int convertOpcodeToBinary(string& opcode, vector<unsigned char>& opcodeBytes);